@@ -1,9 +1,38 @@
+#include "Profiler.hpp"
 #include "WallBreaker.hpp"
 
-int main()
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// usage: WallBreaker [--seed SEED] [--record PATH] [--checkpoint PATH] [--profile PREFIX]
+int main(int argc, char **argv)
 {
   WallBreaker wallBreaker;
+  std::string profilePrefix;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (std::strcmp(argv[i], "--seed") == 0)
+      wallBreaker.SetRandomSeed(static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10)));
+    else if (std::strcmp(argv[i], "--record") == 0 && !wallBreaker.StartRecording(argv[i + 1]))
+      std::cerr << "Can't record to " << argv[i + 1] << std::endl;
+    else if (std::strcmp(argv[i], "--checkpoint") == 0 && !wallBreaker.ResumeFromCheckpoint(argv[i + 1]))
+      std::cerr << "Can't resume from " << argv[i + 1] << std::endl;
+    else if (std::strcmp(argv[i], "--profile") == 0)
+      profilePrefix = argv[i + 1];
+  }
+
+  if (!profilePrefix.empty() && !Profiler::Enabled)
+    std::cerr << "Built without the profiler, configure with WALLBREAKER_ENABLE_PROFILER=ON" << std::endl;
+
   wallBreaker.Run();
 
+  // Trace and summary of the whole session, written once every thread stopped recording
+  if (!profilePrefix.empty() && Profiler::Enabled &&
+      !(Profiler::WriteChromeTrace(profilePrefix + ".json") && Profiler::WriteSummaryCsv(profilePrefix + ".csv")))
+    std::cerr << "Can't write the profile to " << profilePrefix << std::endl;
+
   return 0;
 }
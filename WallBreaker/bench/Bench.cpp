@@ -0,0 +1,1158 @@
+#include "BulletManager.hpp"
+#include "CollisionKernels.hpp"
+#include "FrameWriter.hpp"
+#include "Profiler.hpp"
+#include "ReplayLog.hpp"
+#include "SimdKernels.hpp"
+#include "SoftwareRenderer.hpp"
+#include "Spawner.hpp"
+#include "ThreadManager.hpp"
+#include "Math.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Headless benchmark driver: runs scripted scenarios on the simulation core without any window
+// and prints one JSON object per run. Runs are deterministic, the final state hash is the same
+// for any amount of threads and for a replay of a recorded run.
+//
+// usage: wallbreaker_bench [--walls RATIO] [--bullets N] [--seconds T] [--rate HZ] [--substeps N] [--threads 1,2,4]
+//                          [--width W] [--height H] [--lifetime SECONDS] [--seed SEED] [--no-collisions]
+//                          [--resting FRACTION] [--no-sleep] [--record PATH] [--isa scalar|sse2|avx2] [--profile PREFIX]
+//                          [--checkpoint PATH] [--save-checkpoint PATH] [--stream-walls] [--spawn-radius R]
+//                          [--render] [--capture TARGET] [--capture-scale S] [--broad-phase hash|sap|brute]
+//                          [--fire-rate BULLETS_PER_SECOND]
+//        wallbreaker_bench --replay PATH [--threads 1,2,4] [--isa scalar|sse2|avx2] [--profile PREFIX]
+//                          [--render] [--capture TARGET] [--capture-scale S] [--broad-phase hash|sap|brute]
+//        wallbreaker_bench --check-kernels [--seed SEED]
+//        wallbreaker_bench --check-task-graph
+//        wallbreaker_bench --check-wall-bounces
+
+namespace
+{
+// Every heap allocation of the process, counted to check that steady state steps don't allocate
+std::atomic<uint64_t> HeapAllocations{ 0 };
+// Bytes currently allocated and the most allocated at once since the last ResetPeakHeapBytes, so every run measures
+// its own peak even though all of them share the process
+std::atomic<size_t> LiveHeapBytes{ 0 };
+std::atomic<size_t> PeakHeapBytes{ 0 };
+
+// Stored right below every address handed out, so deletes know the size and the block to free
+struct AllocationHeader
+{
+  void *block;
+  size_t size;
+};
+
+void *Allocate(size_t size, size_t alignment)
+{
+  alignment = std::max(alignment, alignof(std::max_align_t));
+  void *block = std::malloc(size + sizeof(AllocationHeader) + alignment);
+  if (!block)
+    throw std::bad_alloc();
+
+  const uintptr_t address = (reinterpret_cast<uintptr_t>(block) + sizeof(AllocationHeader) + alignment - 1) &
+    ~static_cast<uintptr_t>(alignment - 1);
+  auto *header = reinterpret_cast<AllocationHeader *>(address) - 1;
+  header->block = block;
+  header->size = size;
+
+  HeapAllocations.fetch_add(1, std::memory_order_relaxed);
+  const size_t live = LiveHeapBytes.fetch_add(size, std::memory_order_relaxed) + size;
+  size_t peak = PeakHeapBytes.load(std::memory_order_relaxed);
+  while (live > peak && !PeakHeapBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+  {
+  }
+  return reinterpret_cast<void *>(address);
+}
+
+void Free(void *memory)
+{
+  if (!memory)
+    return;
+  const auto *header = static_cast<AllocationHeader *>(memory) - 1;
+  LiveHeapBytes.fetch_sub(header->size, std::memory_order_relaxed);
+  std::free(header->block);
+}
+}// namespace
+
+void *operator new(size_t size)
+{
+  return Allocate(size, alignof(std::max_align_t));
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+  return Allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *memory) noexcept
+{
+  Free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+  Free(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept
+{
+  Free(memory);
+}
+
+void operator delete(void *memory, size_t, std::align_val_t) noexcept
+{
+  Free(memory);
+}
+
+namespace
+{
+struct Scenario
+{
+  unsigned int wallsRatio = 32;
+  size_t bullets = 1000;
+  float seconds = 10.0f;
+  float rate = 60.0f;
+  uint32_t substeps = 1;
+  float width = 1920.0f;
+  float height = 1080.0f;
+  float lifetime = -1.0f;
+  uint32_t seed = 1;
+  bool collisions = true;
+  // Fraction of the bullets fired without any speed, they fall asleep right away
+  float resting = 0.0f;
+  bool sleeping = true;
+  // Finds the bullet pairs, the state hash doesn't depend on it
+  BroadPhaseType broadPhase = BroadPhaseType::SpatialHash;
+  // Walls are generated per chunk around awake bullets, the walls ratio is per chunk then
+  bool streamWalls = false;
+  // Bullets are fired within this distance from the centre of the world, anywhere when zero
+  float spawnRadius = 0.0f;
+  // Bullets per second fired all over the world during the run by a spawner, on top of the initial ones
+  double fireRate = 0.0;
+  std::vector<size_t> threads;
+  // The first run is recorded when set
+  std::string recordPath;
+  // Replaces the scripted scenario with a recorded log
+  std::string replayPath;
+  // Every run starts from this state instead of firing the scripted bullets
+  std::string checkpointPath;
+  // The state at the end of the first run is saved when set
+  std::string saveCheckpointPath;
+  // Compares every supported SIMD kernel with the scalar reference instead of benchmarking
+  bool checkKernels = false;
+  bool checkTaskGraph = false;
+  bool checkWallBounces = false;
+  // Every run writes PREFIX-<threads>t.json (Chrome trace) and PREFIX-<threads>t.csv (per-phase summary)
+  std::string profilePrefix;
+  // Every step is rasterized on the CPU, timed apart from the simulation
+  bool render = false;
+  // Frames of the first run are written there, see FrameWriter::Open for the targets
+  std::string capturePath;
+  // Pixels per world unit of the rendered frames
+  float captureScale = 1.0f;
+};
+
+struct RunResult
+{
+  size_t steps = 0;
+  double seconds = 0.0;
+  double bulletSteps = 0.0;
+  size_t finalBullets = 0;
+  size_t finalWalls = 0;
+  size_t finalSleeping = 0;
+  size_t finalLoadedChunks = 0;
+  size_t walls = 0;
+  uint64_t stateHash = 0;
+  // Time to fire and spawn the initial bullets
+  double spawnSeconds = 0.0;
+  // Time to generate the initial walls
+  double wallsSeconds = 0.0;
+  double checkpointLoadSeconds = 0.0;
+  double checkpointSaveSeconds = 0.0;
+  // Spawner updates during the run, not included in seconds
+  double fireSeconds = 0.0;
+  uint64_t fired = 0;
+  // Software rendering and frame writing, not included in seconds
+  double renderSeconds = 0.0;
+  size_t framesRendered = 0;
+  size_t framesWritten = 0;
+  // Heap allocations per step over the second half of the run, once scratch memory has grown
+  double steadyAllocationsPerStep = 0.0;
+  FrameArenaStats arenaStats;
+  // Most heap bytes the run had allocated at once, on top of what was allocated before it started
+  size_t peakHeapBytes = 0;
+};
+
+// Peak heap of the run between the constructor and Get
+class PeakHeapCounter
+{
+public:
+  PeakHeapCounter() : m_base{ LiveHeapBytes.load(std::memory_order_relaxed) }
+  {
+    PeakHeapBytes.store(m_base, std::memory_order_relaxed);
+  }
+
+  size_t Get() const { return PeakHeapBytes.load(std::memory_order_relaxed) - m_base; }
+
+private:
+  size_t m_base;
+};
+
+// Counts allocations of the steps in the second half of a run
+class SteadyAllocationsCounter
+{
+public:
+  explicit SteadyAllocationsCounter(size_t steps) : m_firstStep{ steps / 2 } {}
+
+  void BeforeStep(size_t step)
+  {
+    if (step == m_firstStep)
+      m_begin = HeapAllocations.load(std::memory_order_relaxed);
+  }
+
+  double GetPerStep(size_t steps) const
+  {
+    if (steps <= m_firstStep)
+      return 0.0;
+    const uint64_t allocations = HeapAllocations.load(std::memory_order_relaxed) - m_begin;
+    return static_cast<double>(allocations) / (steps - m_firstStep);
+  }
+
+private:
+  size_t m_firstStep;
+  uint64_t m_begin = 0;
+};
+
+// Larger frames are refused, the scale of the capture has to be lowered for huge worlds
+constexpr float MaxFrameSize = 16384.0f;
+
+// Rasterizes the state after every step with the software renderer and writes the frames out when asked to
+class FrameCapture
+{
+public:
+  bool Open(const Scenario &scenario, float worldWidth, float worldHeight, ThreadManager *threadManager, bool write)
+  {
+    const float width = std::ceil(worldWidth * scenario.captureScale);
+    const float height = std::ceil(worldHeight * scenario.captureScale);
+    if (!(width >= 1.0f && height >= 1.0f && width <= MaxFrameSize && height <= MaxFrameSize))
+    {
+      std::fprintf(stderr, "a %gx%g frame can't be rendered, change --capture-scale\n", width, height);
+      return false;
+    }
+
+    m_renderer =
+      std::make_unique<SoftwareRenderer>(static_cast<unsigned int>(width), static_cast<unsigned int>(height));
+    m_renderer->SetThreadManager(threadManager);
+    m_renderer->SetView({ 0.0f, 0.0f }, scenario.captureScale);
+
+    if (write && !m_writer.Open(scenario.capturePath))
+    {
+      std::fprintf(stderr, "can't write frames to %s\n", scenario.capturePath.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  bool IsOpen() const { return m_renderer != nullptr; }
+
+  void Capture(const BulletManager &bulletManager, RunResult &result)
+  {
+    const auto begin = std::chrono::steady_clock::now();
+    bulletManager.WriteRenderSnapshot(m_snapshot);
+    m_renderer->Render(m_snapshot);
+    ++result.framesRendered;
+
+    if (m_writer.IsOpen())
+    {
+      if (m_writer.Write(m_renderer->GetPixels(), m_renderer->GetWidth(), m_renderer->GetHeight()))
+        ++result.framesWritten;
+      else
+      {
+        std::fprintf(stderr, "can't write frame %zu, capture stopped\n", m_writer.GetNumberOfFrames());
+        m_writer.Close();
+      }
+    }
+    result.renderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  }
+
+private:
+  std::unique_ptr<SoftwareRenderer> m_renderer;
+  RenderSnapshot m_snapshot;
+  FrameWriter m_writer;
+};
+
+void PrintUsage()
+{
+  std::fprintf(stderr,
+    "usage: wallbreaker_bench [--walls RATIO] [--bullets N] [--seconds T] [--rate HZ] [--substeps N] [--threads 1,2,4]\n"
+    "                         [--width W] [--height H] [--lifetime SECONDS] [--seed SEED] [--no-collisions]\n"
+    "                         [--resting FRACTION] [--no-sleep] [--record PATH] [--isa scalar|sse2|avx2] [--profile PREFIX]\n"
+    "                         [--checkpoint PATH] [--save-checkpoint PATH] [--stream-walls] [--spawn-radius R]\n"
+    "                         [--render] [--capture TARGET] [--capture-scale S] [--broad-phase hash|sap|brute]\n"
+    "                         [--fire-rate BULLETS_PER_SECOND]\n"
+    "       wallbreaker_bench --replay PATH [--threads 1,2,4] [--isa scalar|sse2|avx2] [--profile PREFIX]\n"
+    "                         [--render] [--capture TARGET] [--capture-scale S] [--broad-phase hash|sap|brute]\n"
+    "       wallbreaker_bench --check-kernels [--seed SEED]\n"
+    "       wallbreaker_bench --check-task-graph\n"
+    "       wallbreaker_bench --check-wall-bounces\n");
+}
+
+std::vector<size_t> ParseList(const char *str)
+{
+  std::vector<size_t> values;
+  while (*str)
+  {
+    char *end = nullptr;
+    const unsigned long value = std::strtoul(str, &end, 10);
+    if (end == str)
+      break;
+    if (value > 0)
+      values.push_back(value);
+    str = *end == ',' ? end + 1 : end;
+  }
+  return values;
+}
+
+bool ParseInstructionSet(const char *name)
+{
+  for (const auto instructionSet : { Simd::InstructionSet::Scalar, Simd::InstructionSet::Sse2, Simd::InstructionSet::Avx2 })
+  {
+    if (std::strcmp(name, Simd::GetInstructionSetName(instructionSet)) != 0)
+      continue;
+    if (!Simd::IsSupported(instructionSet))
+    {
+      std::fprintf(stderr, "%s is not supported on this machine\n", name);
+      return false;
+    }
+    Simd::SetInstructionSet(instructionSet);
+    return true;
+  }
+  return false;
+}
+
+bool ParseArguments(int argc, char **argv, Scenario &scenario)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const char *arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+
+    if (std::strcmp(arg, "--no-collisions") == 0)
+      scenario.collisions = false;
+    else if (std::strcmp(arg, "--no-sleep") == 0)
+      scenario.sleeping = false;
+    else if (std::strcmp(arg, "--stream-walls") == 0)
+      scenario.streamWalls = true;
+    else if (std::strcmp(arg, "--render") == 0)
+      scenario.render = true;
+    else if (std::strcmp(arg, "--check-kernels") == 0)
+      scenario.checkKernels = true;
+    else if (std::strcmp(arg, "--check-task-graph") == 0)
+      scenario.checkTaskGraph = true;
+    else if (std::strcmp(arg, "--check-wall-bounces") == 0)
+      scenario.checkWallBounces = true;
+    else if (std::strcmp(arg, "--isa") == 0 && hasValue)
+    {
+      if (!ParseInstructionSet(argv[++i]))
+        return false;
+    }
+    else if (std::strcmp(arg, "--broad-phase") == 0 && hasValue)
+    {
+      if (!ParseBroadPhase(argv[++i], scenario.broadPhase))
+        return false;
+    }
+    else if (std::strcmp(arg, "--walls") == 0 && hasValue)
+      scenario.wallsRatio = std::atoi(argv[++i]);
+    else if (std::strcmp(arg, "--bullets") == 0 && hasValue)
+      scenario.bullets = std::strtoull(argv[++i], nullptr, 10);
+    else if (std::strcmp(arg, "--seconds") == 0 && hasValue)
+      scenario.seconds = std::strtof(argv[++i], nullptr);
+    else if (std::strcmp(arg, "--rate") == 0 && hasValue)
+      scenario.rate = std::strtof(argv[++i], nullptr);
+    else if (std::strcmp(arg, "--substeps") == 0 && hasValue)
+      scenario.substeps = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    else if (std::strcmp(arg, "--width") == 0 && hasValue)
+      scenario.width = std::strtof(argv[++i], nullptr);
+    else if (std::strcmp(arg, "--height") == 0 && hasValue)
+      scenario.height = std::strtof(argv[++i], nullptr);
+    else if (std::strcmp(arg, "--lifetime") == 0 && hasValue)
+      scenario.lifetime = std::strtof(argv[++i], nullptr);
+    else if (std::strcmp(arg, "--fire-rate") == 0 && hasValue)
+      scenario.fireRate = std::strtod(argv[++i], nullptr);
+    else if (std::strcmp(arg, "--spawn-radius") == 0 && hasValue)
+      scenario.spawnRadius = std::strtof(argv[++i], nullptr);
+    else if (std::strcmp(arg, "--resting") == 0 && hasValue)
+      scenario.resting = std::strtof(argv[++i], nullptr);
+    else if (std::strcmp(arg, "--seed") == 0 && hasValue)
+      scenario.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    else if (std::strcmp(arg, "--threads") == 0 && hasValue)
+      scenario.threads = ParseList(argv[++i]);
+    else if (std::strcmp(arg, "--record") == 0 && hasValue)
+      scenario.recordPath = argv[++i];
+    else if (std::strcmp(arg, "--replay") == 0 && hasValue)
+      scenario.replayPath = argv[++i];
+    else if (std::strcmp(arg, "--checkpoint") == 0 && hasValue)
+      scenario.checkpointPath = argv[++i];
+    else if (std::strcmp(arg, "--save-checkpoint") == 0 && hasValue)
+      scenario.saveCheckpointPath = argv[++i];
+    else if (std::strcmp(arg, "--profile") == 0 && hasValue)
+      scenario.profilePrefix = argv[++i];
+    else if (std::strcmp(arg, "--capture") == 0 && hasValue)
+      scenario.capturePath = argv[++i];
+    else if (std::strcmp(arg, "--capture-scale") == 0 && hasValue)
+      scenario.captureScale = std::strtof(argv[++i], nullptr);
+    else
+      return false;
+  }
+
+  if (scenario.rate <= 0.0f || scenario.seconds < 0.0f || scenario.substeps == 0 || scenario.resting < 0.0f
+      || scenario.resting > 1.0f || !(scenario.captureScale > 0.0f) || !(scenario.fireRate >= 0.0))
+    return false;
+
+  if (!scenario.capturePath.empty())
+    scenario.render = true;
+
+  // A log recorded from a checkpoint couldn't be replayed, replays always start from an empty scene
+  if (!scenario.checkpointPath.empty() && !scenario.recordPath.empty())
+  {
+    std::fprintf(stderr, "a run started from a checkpoint can't be recorded\n");
+    return false;
+  }
+
+  if (!scenario.profilePrefix.empty() && !Profiler::Enabled)
+  {
+    std::fprintf(stderr, "built without the profiler, configure with WALLBREAKER_ENABLE_PROFILER=ON\n");
+    return false;
+  }
+
+  // Bullets live through the whole run unless asked otherwise, so the load stays constant
+  if (scenario.lifetime < 0.0f)
+    scenario.lifetime = scenario.seconds + 1.0f;
+
+  if (scenario.threads.empty())
+  {
+    scenario.threads.push_back(1);
+    const size_t hardwareThreads = std::thread::hardware_concurrency();
+    if (hardwareThreads > 1)
+      scenario.threads.push_back(hardwareThreads);
+  }
+  return true;
+}
+
+// Process wide high-water mark, it covers every run made so far rather than the last one
+size_t GetProcessPeakMemoryKb()
+{
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters{};
+  GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+  return counters.PeakWorkingSetSize / 1024;
+#else
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+}
+
+void FireBullets(BulletManager &bulletManager, const Scenario &scenario, RunResult &result)
+{
+  std::mt19937 randGenerator(scenario.seed);
+  std::uniform_real_distribution<float> distributeX(0.0f, scenario.width);
+  std::uniform_real_distribution<float> distributeY(0.0f, scenario.height);
+  std::uniform_real_distribution<float> distributeAngle(0.0f, 6.2831853f);
+  std::uniform_real_distribution<float> distributeUnit(0.0f, 1.0f);
+
+  const size_t restingCount = static_cast<size_t>(scenario.bullets * scenario.resting);
+
+  std::vector<BulletSpawn> spawns(scenario.bullets);
+  for (size_t i = 0; i < spawns.size(); ++i)
+  {
+    BulletSpawn &spawn = spawns[i];
+    if (scenario.spawnRadius > 0.0f)
+    {
+      // Uniform over the disc, the square root keeps the density flat
+      const float distance = scenario.spawnRadius * std::sqrt(distributeUnit(randGenerator));
+      const float around = distributeAngle(randGenerator);
+      spawn.position = glm::vec2(scenario.width, scenario.height) * 0.5f
+                       + distance * glm::vec2(std::cos(around), std::sin(around));
+    }
+    else
+      spawn.position = glm::vec2(distributeX(randGenerator), distributeY(randGenerator));
+    const float angle = distributeAngle(randGenerator);
+    spawn.direction = glm::vec2(std::cos(angle), std::sin(angle));
+    spawn.lifetime = scenario.lifetime;
+    if (i < restingCount)
+      spawn.speed = 0.0f;
+  }
+
+  // One batch, spawned at once without stepping
+  const auto begin = std::chrono::steady_clock::now();
+  bulletManager.FireBatch(spawns);
+  bulletManager.SpawnQueuedBullets();
+  result.spawnSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void WriteProfile(const Scenario &scenario, size_t threadsCount)
+{
+  if (scenario.profilePrefix.empty())
+    return;
+
+  const std::string path = scenario.profilePrefix + "-" + std::to_string(threadsCount) + "t";
+  if (!Profiler::WriteChromeTrace(path + ".json") || !Profiler::WriteSummaryCsv(path + ".csv"))
+    std::fprintf(stderr, "can't write the profile to %s\n", path.c_str());
+}
+
+std::unique_ptr<ThreadManager> CreateThreadManager(size_t threadsCount)
+{
+  // A single thread runs without the pool at all
+  if (threadsCount <= 1)
+    return nullptr;
+  return std::make_unique<ThreadManager>(threadsCount - 1);
+}
+
+bool Run(const Scenario &scenario, size_t threadsCount, ReplayRecorder *recorder, bool saveCheckpoint,
+  bool captureFrames, RunResult &result)
+{
+  std::unique_ptr<ThreadManager> threadManager = CreateThreadManager(threadsCount);
+
+  BulletManager bulletManager(scenario.width, scenario.height);
+  bulletManager.SetThreadManager(threadManager.get());
+  bulletManager.SetFixedDeltaTime(1.0f / scenario.rate);
+  bulletManager.SetSubsteps(scenario.substeps);
+  bulletManager.SetRandomSeed(scenario.seed);
+  if (!scenario.collisions)
+    bulletManager.ToggleProcessBulletsCollision();
+  bulletManager.SetSleepingEnabled(scenario.sleeping);
+  bulletManager.SetWallStreaming(scenario.streamWalls);
+  bulletManager.SetBroadPhase(scenario.broadPhase);
+
+  if (recorder)
+  {
+    ReplayHeader header;
+    header.worldWidth = scenario.width;
+    header.worldHeight = scenario.height;
+    header.fixedDeltaTime = bulletManager.GetFixedDeltaTime();
+    header.substeps = bulletManager.GetSubsteps();
+    header.processBulletsCollision = bulletManager.IsProcessingBulletsCollision();
+    header.sleeping = bulletManager.IsSleepingEnabled();
+    header.wallStreaming = bulletManager.IsStreamingWalls();
+    if (recorder->Open(scenario.recordPath, header))
+      bulletManager.SetRecorder(recorder);
+    else
+      std::fprintf(stderr, "can't record to %s\n", scenario.recordPath.c_str());
+  }
+
+  if (!scenario.checkpointPath.empty())
+  {
+    // Settings come from the checkpoint as well
+    const auto begin = std::chrono::steady_clock::now();
+    if (!bulletManager.LoadCheckpoint(scenario.checkpointPath))
+    {
+      std::fprintf(stderr, "can't load the checkpoint %s\n", scenario.checkpointPath.c_str());
+      return false;
+    }
+    result.checkpointLoadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    result.walls = bulletManager.GetNumberOfWalls();
+  }
+  else
+  {
+    const auto begin = std::chrono::steady_clock::now();
+    if (scenario.wallsRatio > 0)
+      bulletManager.GenerateNewWalls(scenario.wallsRatio);
+    result.wallsSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    result.walls = bulletManager.GetNumberOfWalls();
+
+    FireBullets(bulletManager, scenario, result);
+  }
+
+  // The checkpoint decides of the world size
+  FrameCapture capture;
+  if (scenario.render
+      && !capture.Open(scenario, bulletManager.GetViewportWidth(), bulletManager.GetViewportHeight(),
+        threadManager.get(), captureFrames))
+    return false;
+
+  // Fires over the world the checkpoint decided of, with its own streams of the seed
+  Spawner spawner;
+  spawner.SetThreadManager(threadManager.get());
+  spawner.SetRandomSeed(scenario.seed);
+  if (scenario.fireRate > 0.0)
+  {
+    EmitterConfig emitter;
+    emitter.rate = scenario.fireRate;
+    emitter.areaMax = glm::vec2(bulletManager.GetViewportWidth(), bulletManager.GetViewportHeight());
+    emitter.minLifetime = scenario.lifetime;
+    emitter.maxLifetime = scenario.lifetime;
+    spawner.AddEmitter(emitter);
+  }
+
+  result.steps = static_cast<size_t>(scenario.seconds * scenario.rate);
+
+  SteadyAllocationsCounter allocations(result.steps);
+  const auto begin = std::chrono::steady_clock::now();
+  for (size_t step = 0; step < result.steps; ++step)
+  {
+    allocations.BeforeStep(step);
+    if (spawner.GetNumberOfEmitters() > 0)
+    {
+      const auto fireBegin = std::chrono::steady_clock::now();
+      spawner.Update(bulletManager.GetFixedDeltaTime(), bulletManager);
+      result.fireSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - fireBegin).count();
+    }
+    result.bulletSteps += static_cast<double>(bulletManager.GetNumberOfBullets());
+    bulletManager.Step();
+    if (capture.IsOpen())
+      capture.Capture(bulletManager, result);
+  }
+  const auto end = std::chrono::steady_clock::now();
+  result.steadyAllocationsPerStep = allocations.GetPerStep(result.steps);
+
+  if (recorder && recorder->IsOpen())
+  {
+    bulletManager.SetRecorder(nullptr);
+    recorder->Close(bulletManager.GetTick());
+  }
+
+  result.seconds = std::chrono::duration<double>(end - begin).count() - result.renderSeconds - result.fireSeconds;
+  result.fired = spawner.GetNumberOfFired();
+  result.finalBullets = bulletManager.GetNumberOfBullets();
+  result.finalWalls = bulletManager.GetNumberOfWalls();
+  result.finalSleeping = bulletManager.GetNumberOfSleepingBullets();
+  result.finalLoadedChunks = bulletManager.GetNumberOfLoadedChunks();
+  result.stateHash = bulletManager.ComputeStateHash();
+  result.arenaStats = bulletManager.GetCollisionArenaStats();
+
+  if (saveCheckpoint)
+  {
+    const auto begin = std::chrono::steady_clock::now();
+    if (!bulletManager.SaveCheckpoint(scenario.saveCheckpointPath))
+      std::fprintf(stderr, "can't save the checkpoint to %s\n", scenario.saveCheckpointPath.c_str());
+    result.checkpointSaveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  }
+  return true;
+}
+
+bool Replay(const Scenario &scenario, size_t threadsCount, bool captureFrames, RunResult &result)
+{
+  ReplayReader reader;
+  if (!reader.Open(scenario.replayPath))
+    return false;
+
+  std::unique_ptr<ThreadManager> threadManager = CreateThreadManager(threadsCount);
+
+  const ReplayHeader &header = reader.GetHeader();
+  BulletManager bulletManager(header.worldWidth, header.worldHeight);
+  bulletManager.SetThreadManager(threadManager.get());
+  reader.Configure(bulletManager);
+  bulletManager.SetBroadPhase(scenario.broadPhase);
+
+  FrameCapture capture;
+  if (scenario.render
+      && !capture.Open(scenario, header.worldWidth, header.worldHeight, threadManager.get(), captureFrames))
+    return false;
+
+  // Events are applied outside of the measured time, they are a part of the input and not of the simulation
+  std::chrono::steady_clock::duration elapsed{};
+  while (reader.ApplyEvents(bulletManager))
+  {
+    if (result.steps == 0)
+      result.walls = bulletManager.GetNumberOfWalls();
+
+    result.bulletSteps += static_cast<double>(bulletManager.GetNumberOfBullets());
+    const auto begin = std::chrono::steady_clock::now();
+    bulletManager.Step();
+    elapsed += std::chrono::steady_clock::now() - begin;
+    ++result.steps;
+
+    if (capture.IsOpen())
+      capture.Capture(bulletManager, result);
+  }
+
+  result.seconds = std::chrono::duration<double>(elapsed).count();
+  result.finalBullets = bulletManager.GetNumberOfBullets();
+  result.finalWalls = bulletManager.GetNumberOfWalls();
+  result.finalSleeping = bulletManager.GetNumberOfSleepingBullets();
+  result.stateHash = bulletManager.ComputeStateHash();
+  return true;
+}
+
+double GetRenderMsPerFrame(const RunResult &result)
+{
+  return result.framesRendered > 0 ? result.renderSeconds * 1e3 / result.framesRendered : 0.0;
+}
+
+void PrintResult(const Scenario &scenario, size_t threadsCount, const RunResult &result)
+{
+  const double stepsPerSecond = result.seconds > 0.0 ? result.steps / result.seconds : 0.0;
+  const double nsPerBulletStep = result.bulletSteps > 0.0 ? result.seconds * 1e9 / result.bulletSteps : 0.0;
+
+  std::printf("{\"walls_ratio\":%u,\"walls\":%zu,\"bullets\":%zu,\"seconds\":%g,\"rate\":%g,\"threads\":%zu,"
+              "\"isa\":\"%s\",\"collisions\":%s,\"broad_phase\":\"%s\",\"steps\":%zu,\"elapsed_s\":%.6f,\"steps_per_second\":%.3f,"
+              "\"ns_per_bullet_step\":%.3f,\"spawn_ms\":%.3f,\"walls_ms\":%.3f,"
+              "\"checkpoint_load_ms\":%.3f,\"checkpoint_save_ms\":%.3f,"
+              "\"final_bullets\":%zu,\"final_walls\":%zu,\"final_sleeping\":%zu,"
+              "\"loaded_chunks\":%zu,\"state_hash\":\"%016" PRIx64 "\","
+              "\"steady_allocations_per_step\":%.2f,\"arena_heap_allocations\":%" PRIu64 ",\"arena_kb\":%zu,"
+              "\"render_ms_per_frame\":%.3f,\"frames_written\":%zu,\"fire_rate\":%g,\"fired\":%" PRIu64 ","
+              "\"fire_ms\":%.3f,\"peak_heap_kb\":%zu,\"process_peak_rss_kb\":%zu}\n",
+    scenario.wallsRatio,
+    result.walls,
+    scenario.bullets,
+    scenario.seconds,
+    scenario.rate,
+    threadsCount,
+    Simd::GetInstructionSetName(Simd::GetInstructionSet()),
+    scenario.collisions ? "true" : "false",
+    GetBroadPhaseName(scenario.broadPhase),
+    result.steps,
+    result.seconds,
+    stepsPerSecond,
+    nsPerBulletStep,
+    result.spawnSeconds * 1e3,
+    result.wallsSeconds * 1e3,
+    result.checkpointLoadSeconds * 1e3,
+    result.checkpointSaveSeconds * 1e3,
+    result.finalBullets,
+    result.finalWalls,
+    result.finalSleeping,
+    result.finalLoadedChunks,
+    result.stateHash,
+    result.steadyAllocationsPerStep,
+    result.arenaStats.heapAllocations,
+    result.arenaStats.capacity / 1024,
+    GetRenderMsPerFrame(result),
+    result.framesWritten,
+    scenario.fireRate,
+    result.fired,
+    result.fireSeconds * 1e3,
+    result.peakHeapBytes / 1024,
+    GetProcessPeakMemoryKb());
+  std::fflush(stdout);
+}
+
+void PrintReplayResult(const Scenario &scenario, size_t threadsCount, const RunResult &result)
+{
+  const double stepsPerSecond = result.seconds > 0.0 ? result.steps / result.seconds : 0.0;
+  const double nsPerBulletStep = result.bulletSteps > 0.0 ? result.seconds * 1e9 / result.bulletSteps : 0.0;
+
+  std::printf("{\"replay\":\"%s\",\"walls\":%zu,\"threads\":%zu,\"isa\":\"%s\",\"broad_phase\":\"%s\",\"steps\":%zu,"
+              "\"elapsed_s\":%.6f,\"steps_per_second\":%.3f,\"ns_per_bullet_step\":%.3f,\"final_bullets\":%zu,\"final_walls\":%zu,"
+              "\"final_sleeping\":%zu,\"state_hash\":\"%016" PRIx64 "\",\"render_ms_per_frame\":%.3f,"
+              "\"frames_written\":%zu,\"peak_heap_kb\":%zu,\"process_peak_rss_kb\":%zu}\n",
+    scenario.replayPath.c_str(),
+    result.walls,
+    threadsCount,
+    Simd::GetInstructionSetName(Simd::GetInstructionSet()),
+    GetBroadPhaseName(scenario.broadPhase),
+    result.steps,
+    result.seconds,
+    stepsPerSecond,
+    nsPerBulletStep,
+    result.finalBullets,
+    result.finalWalls,
+    result.finalSleeping,
+    result.stateHash,
+    GetRenderMsPerFrame(result),
+    result.framesWritten,
+    result.peakHeapBytes / 1024,
+    GetProcessPeakMemoryKb());
+  std::fflush(stdout);
+}
+
+// Reference integration on glm vectors, the same code the simulation used before the kernels
+void ReferenceIntegrateAndWrap(std::vector<float> &posX, std::vector<float> &posY, std::vector<float> &velX,
+  std::vector<float> &velY, float deltaTime, float width, float height)
+{
+  for (size_t i = 0; i < posX.size(); ++i)
+  {
+    glm::vec2 position(posX[i], posY[i]);
+    glm::vec2 velocity(velX[i], velY[i]);
+    position += velocity * deltaTime;
+
+    if (position.x < 0)
+      position.x += width;
+    if (position.x >= width)
+      position.x -= width;
+    if (position.y < 0)
+      position.y += height;
+    if (position.y >= height)
+      position.y -= height;
+
+    if (Math::dot(velocity, velocity) < 0.01f)
+      velocity = glm::vec2(0.0f, 0.0f);
+
+    posX[i] = position.x;
+    posY[i] = position.y;
+    velX[i] = velocity.x;
+    velY[i] = velocity.y;
+  }
+}
+
+// Reference circle vs segment test on glm vectors and Math:: functions
+bool ReferenceSegmentVsCircle(const Segment &edge, glm::vec2 position, float radius)
+{
+  const glm::vec2 v0 = edge.p1 - edge.p0;
+  const glm::vec2 v1 = position - edge.p0;
+  const float len = Math::dot(v0, v0);
+  const float t = std::max(0.0f, std::min(len, Math::dot(v0, v1))) / len;
+  const glm::vec2 closestPoint = edge.p0 + v0 * t;
+  return Math::length(position - closestPoint) <= radius + edge.thickness;
+}
+
+// Every kernel has to be bit exact with the reference, otherwise replays would diverge between machines
+bool CheckKernels(const Scenario &scenario)
+{
+  constexpr size_t bulletsCount = 4099;
+  constexpr size_t segmentsCases = 20000;
+  const float width = scenario.width;
+  const float height = scenario.height;
+
+  std::mt19937 randGenerator(scenario.seed);
+  std::uniform_real_distribution<float> distributeX(-0.1f * width, 1.1f * width);
+  std::uniform_real_distribution<float> distributeY(-0.1f * height, 1.1f * height);
+  std::uniform_real_distribution<float> distributeVelocity(-400.0f, 400.0f);
+  std::uniform_real_distribution<float> distributeSlowVelocity(-0.08f, 0.08f);
+  std::uniform_real_distribution<float> distributeOffset(-12.0f, 12.0f);
+  std::uniform_real_distribution<float> distributeRadius(0.5f, 6.0f);
+
+  std::vector<float> posX(bulletsCount), posY(bulletsCount), velX(bulletsCount), velY(bulletsCount);
+  for (size_t i = 0; i < bulletsCount; ++i)
+  {
+    posX[i] = distributeX(randGenerator);
+    posY[i] = distributeY(randGenerator);
+    const bool slow = i % 7 == 0;
+    velX[i] = slow ? distributeSlowVelocity(randGenerator) : distributeVelocity(randGenerator);
+    velY[i] = slow ? distributeSlowVelocity(randGenerator) : distributeVelocity(randGenerator);
+  }
+  // Values sitting right on the wrap boundaries
+  const float edgeValues[] = { 0.0f, -0.0f, width, std::nextafter(width, 0.0f), -std::nextafter(0.0f, 1.0f) };
+  for (size_t i = 0; i < std::size(edgeValues); ++i)
+  {
+    posX[i] = edgeValues[i];
+    posY[i] = edgeValues[i] * (height / width);
+    velX[i] = 0.0f;
+    velY[i] = 0.0f;
+  }
+
+  // Segments with circles placed around them, including degenerate and zero thickness ones
+  std::vector<Segment> segments(segmentsCases);
+  std::vector<glm::vec2> circles(segmentsCases);
+  std::vector<float> radii(segmentsCases);
+  for (size_t i = 0; i < segmentsCases; ++i)
+  {
+    const glm::vec2 p0(distributeX(randGenerator), distributeY(randGenerator));
+    const glm::vec2 p1 = i % 97 == 0 ? p0 : p0 + glm::vec2(distributeOffset(randGenerator), distributeOffset(randGenerator));
+    segments[i] = { p0, p1, i % 5 == 0 ? 0.0f : 2.0f };
+    const glm::vec2 anchor = i % 3 == 0 ? p0 : (i % 3 == 1 ? p1 : (p0 + p1) * 0.5f);
+    circles[i] = anchor + glm::vec2(distributeOffset(randGenerator), distributeOffset(randGenerator));
+    radii[i] = distributeRadius(randGenerator);
+  }
+
+  const float deltaTimes[] = { 1.0f / 30.0f, 1.0f / 60.0f, 1.0f / 240.0f };
+
+  bool allPassed = true;
+  for (const auto instructionSet : { Simd::InstructionSet::Scalar, Simd::InstructionSet::Sse2, Simd::InstructionSet::Avx2 })
+  {
+    if (!Simd::IsSupported(instructionSet))
+      continue;
+    Simd::SetInstructionSet(instructionSet);
+
+    size_t integrateMismatches = 0;
+    for (const float deltaTime : deltaTimes)
+    {
+      std::vector<float> refX = posX, refY = posY, refVelX = velX, refVelY = velY;
+      ReferenceIntegrateAndWrap(refX, refY, refVelX, refVelY, deltaTime, width, height);
+
+      std::vector<float> x = posX, y = posY, vx = velX, vy = velY;
+      Simd::IntegrateAndWrap(x.data(), y.data(), vx.data(), vy.data(), bulletsCount, deltaTime, width, height);
+
+      for (size_t i = 0; i < bulletsCount; ++i)
+      {
+        const float expected[] = { refX[i], refY[i], refVelX[i], refVelY[i] };
+        const float actual[] = { x[i], y[i], vx[i], vy[i] };
+        if (std::memcmp(expected, actual, sizeof(expected)) != 0)
+          ++integrateMismatches;
+      }
+    }
+
+    // Every circle goes against a block made of its own segment and the 7 following ones, at every lane count
+    size_t segmentsMismatches = 0;
+    Simd::SegmentsBlock block;
+    for (size_t i = 0; i < segmentsCases; ++i)
+    {
+      block.count = static_cast<uint32_t>(i % Simd::SegmentsBlockSize) + 1;
+      for (uint32_t lane = 0; lane < block.count; ++lane)
+        block.Set(lane, segments[(i + lane) % segmentsCases]);
+
+      uint32_t expected = 0;
+      for (uint32_t lane = 0; lane < block.count; ++lane)
+      {
+        if (ReferenceSegmentVsCircle(segments[(i + lane) % segmentsCases], circles[i], radii[i]))
+          expected |= 1u << lane;
+      }
+      if (Simd::SegmentsVsCircle(block, circles[i].x, circles[i].y, radii[i]) != expected)
+        ++segmentsMismatches;
+    }
+
+    const bool passed = integrateMismatches == 0 && segmentsMismatches == 0;
+    allPassed = allPassed && passed;
+    std::printf("{\"check_kernels\":\"%s\",\"integrate_cases\":%zu,\"integrate_mismatches\":%zu,"
+                "\"segments_cases\":%zu,\"segments_mismatches\":%zu,\"passed\":%s}\n",
+      Simd::GetInstructionSetName(instructionSet),
+      bulletsCount * std::size(deltaTimes),
+      integrateMismatches,
+      segmentsCases,
+      segmentsMismatches,
+      passed ? "true" : "false");
+  }
+
+  Simd::SetInstructionSet(Simd::GetBestInstructionSet());
+  std::fflush(stdout);
+  return allPassed;
+}
+
+// Diamonds of 2 and 64 branches run many times over: the source has to run first and the sink last, every task once
+// per run, and Run must not return before the sink is done. 0 threads runs the graph without a thread manager.
+bool CheckTaskGraph()
+{
+  constexpr size_t runsCount = 500;
+
+  bool allPassed = true;
+  for (const size_t threadsCount : { size_t{ 0 }, size_t{ 1 }, size_t{ 4 } })
+  {
+    std::unique_ptr<ThreadManager> threadManager;
+    if (threadsCount > 0)
+      threadManager = std::make_unique<ThreadManager>(threadsCount - 1);
+
+    for (const size_t branchesCount : { size_t{ 2 }, size_t{ 64 } })
+    {
+      // Node 0 is the source, the last node is the sink
+      const size_t nodesCount = branchesCount + 2;
+      const size_t sink = nodesCount - 1;
+      std::vector<std::vector<size_t>> predecessors(nodesCount);
+      for (size_t branch = 1; branch <= branchesCount; ++branch)
+      {
+        predecessors[branch].push_back(0);
+        predecessors[sink].push_back(branch);
+      }
+
+      // Runs every node has finished so far
+      auto finishedRuns = std::make_unique<std::atomic<size_t>[]>(nodesCount);
+      std::atomic<size_t> violations{ 0 };
+      size_t run = 0;
+
+      TaskGraph graph;
+      for (size_t node = 0; node < nodesCount; ++node)
+      {
+        graph.Add([&, node]() {
+          bool ordered = finishedRuns[node].load(std::memory_order_acquire) == run;
+          for (const size_t predecessor : predecessors[node])
+            ordered = ordered && finishedRuns[predecessor].load(std::memory_order_acquire) == run + 1;
+          if (!ordered)
+            violations.fetch_add(1, std::memory_order_relaxed);
+          finishedRuns[node].fetch_add(1, std::memory_order_release);
+        });
+      }
+      for (size_t node = 0; node < nodesCount; ++node)
+      {
+        for (const size_t predecessor : predecessors[node])
+          graph.Precede(predecessor, node);
+      }
+
+      size_t incompleteRuns = 0;
+      for (run = 0; run < runsCount; ++run)
+      {
+        graph.Run(threadManager.get());
+        for (size_t node = 0; node < nodesCount; ++node)
+        {
+          if (finishedRuns[node].load(std::memory_order_acquire) != run + 1)
+          {
+            ++incompleteRuns;
+            break;
+          }
+        }
+      }
+
+      const bool passed = violations == 0 && incompleteRuns == 0;
+      allPassed = allPassed && passed;
+      std::printf("{\"check_task_graph\":\"diamond\",\"threads\":%zu,\"branches\":%zu,\"runs\":%zu,"
+                  "\"order_violations\":%zu,\"incomplete_runs\":%zu,\"passed\":%s}\n",
+        threadsCount,
+        branchesCount,
+        runsCount,
+        violations.load(),
+        incompleteRuns,
+        passed ? "true" : "false");
+    }
+  }
+  std::fflush(stdout);
+  return allPassed;
+}
+
+// A single fast bullet bounces off the middle of wall A straight into wall B, both within one default tick, and has to
+// destroy both of them. Walls come from single cell generations, which lay one long wall anywhere in the world, and
+// every pair of them whose geometry allows such a path is tried.
+bool CheckWallBounces()
+{
+  constexpr float worldSize = 1000.0f;
+  constexpr uint32_t wallsCount = 24;
+  // Straight run to wall A
+  constexpr float approach = 60.0f;
+
+  // Every case generates its two walls again from their seeds
+  std::vector<Segment> walls;
+  std::vector<uint32_t> seeds;
+  for (uint32_t seed = 1; seed <= wallsCount; ++seed)
+  {
+    BulletManager generator(worldSize, worldSize);
+    generator.GenerateNewWalls(1, seed);
+    if (generator.GetNumberOfWalls() != 1)
+      continue;
+    walls.push_back(generator.GetWalls()[0]);
+    seeds.push_back(seed);
+  }
+
+  size_t casesCount = 0;
+  size_t failures = 0;
+  for (uint32_t a = 0; a < walls.size(); ++a)
+  {
+    for (uint32_t b = 0; b < walls.size(); ++b)
+    {
+      if (a == b)
+        continue;
+      const Segment &wallA = walls[a];
+      const Segment &wallB = walls[b];
+
+      // Bullet centre at the moment it touches the middle of A, on the side of B, then heading to the middle of B
+      const glm::vec2 middleA = (wallA.p0 + wallA.p1) * 0.5f;
+      const glm::vec2 middleB = (wallB.p0 + wallB.p1) * 0.5f;
+      const glm::vec2 along = Math::normalize(wallA.p1 - wallA.p0);
+      glm::vec2 normal(-along.y, along.x);
+      if (Math::dot(middleB - middleA, normal) < 0.0f)
+        normal = -normal;
+      const glm::vec2 impact = middleA + normal * (DefaultBulletRadius + wallA.thickness + 0.5f);
+      const glm::vec2 outbound = middleB - impact;
+      // B has to lie well in front of A, not along it, and the whole path has to stay shorter than the world
+      if (Math::dot(Math::normalize(outbound), normal) < 0.3f || Math::length(outbound) < 50.0f
+          || Math::length(outbound) > 500.0f)
+        continue;
+
+      const glm::vec2 inbound = Math::reflect(Math::normalize(outbound), normal);
+      const glm::vec2 start = impact - inbound * approach;
+      if (start.x < 10.0f || start.y < 10.0f || start.x > worldSize - 10.0f || start.y > worldSize - 10.0f)
+        continue;
+      // The way to A has to be clear of B and the way to B clear of A
+      float toi = 0.0f;
+      if (Collision::SweepCircleVsSegment(start, impact - start, DefaultBulletRadius, wallB, toi)
+        || Collision::SweepCircleVsSegment(impact, outbound, DefaultBulletRadius, wallA, toi))
+        continue;
+
+      // Fast enough to get past the middle of B within the tick
+      const float speed = (approach + Math::length(outbound) + 40.0f) / DefaultFixedDeltaTime;
+
+      BulletManager bulletManager(worldSize, worldSize);
+      bulletManager.GenerateNewWalls(1, seeds[a]);
+      bulletManager.GenerateNewWalls(1, seeds[b]);
+      bulletManager.Fire(start, inbound, speed, 10.0f);
+      bulletManager.Step();
+
+      ++casesCount;
+      if (bulletManager.GetNumberOfWalls() != 0)
+        ++failures;
+    }
+  }
+
+  const bool passed = casesCount > 0 && failures == 0;
+  std::printf("{\"check_wall_bounces\":\"two_walls_one_tick\",\"cases\":%zu,\"failures\":%zu,\"passed\":%s}\n",
+    casesCount,
+    failures,
+    passed ? "true" : "false");
+  std::fflush(stdout);
+  return passed;
+}
+}// namespace
+
+int main(int argc, char **argv)
+{
+  Scenario scenario;
+  if (!ParseArguments(argc, argv, scenario))
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  if (scenario.checkKernels)
+    return CheckKernels(scenario) ? 0 : 1;
+  if (scenario.checkTaskGraph)
+    return CheckTaskGraph() ? 0 : 1;
+  if (scenario.checkWallBounces)
+    return CheckWallBounces() ? 0 : 1;
+
+  if (!scenario.replayPath.empty())
+  {
+    for (size_t i = 0; i < scenario.threads.size(); ++i)
+    {
+      const size_t threadsCount = scenario.threads[i];
+      const bool captureFrames = i == 0 && !scenario.capturePath.empty();
+      Profiler::Reset();
+      RunResult result;
+      const PeakHeapCounter peakHeap;
+      const bool replayed = Replay(scenario, threadsCount, captureFrames, result);
+      result.peakHeapBytes = peakHeap.Get();
+      if (!replayed)
+      {
+        std::fprintf(stderr, "can't replay %s\n", scenario.replayPath.c_str());
+        return 1;
+      }
+      PrintReplayResult(scenario, threadsCount, result);
+      WriteProfile(scenario, threadsCount);
+    }
+    return 0;
+  }
+
+  ReplayRecorder recorder;
+  for (size_t i = 0; i < scenario.threads.size(); ++i)
+  {
+    const bool record = i == 0 && !scenario.recordPath.empty();
+    const bool saveCheckpoint = i == 0 && !scenario.saveCheckpointPath.empty();
+    Profiler::Reset();
+    RunResult result;
+    const bool captureFrames = i == 0 && !scenario.capturePath.empty();
+    const PeakHeapCounter peakHeap;
+    if (!Run(scenario, scenario.threads[i], record ? &recorder : nullptr, saveCheckpoint, captureFrames, result))
+      return 1;
+    result.peakHeapBytes = peakHeap.Get();
+    PrintResult(scenario, scenario.threads[i], result);
+    WriteProfile(scenario, scenario.threads[i]);
+  }
+
+  return 0;
+}
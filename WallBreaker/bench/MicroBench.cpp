@@ -0,0 +1,491 @@
+#include "BulletManager.hpp"
+#include "CollisionKernels.hpp"
+#include "SimdKernels.hpp"
+#include "Spawner.hpp"
+#include "ThreadManager.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Microbenchmarks of the simulation kernels and of whole steps at fixed sizes. Prints a single JSON document
+// (Google Benchmark like layout), so results of different builds can be diffed and tracked over time.
+//
+// usage: wallbreaker_microbench [--filter TEXT] [--max-bullets N] [--threads N] [--min-time SECONDS]
+//                               [--repetitions N]
+
+namespace
+{
+struct Options
+{
+  // Only benchmarks whose name contains it are run
+  std::string filter;
+  size_t maxBullets = 1000000;
+  size_t threads = 1;
+  // Every repetition runs at least this long
+  double minTime = 0.05;
+  size_t repetitions = 5;
+};
+
+struct Result
+{
+  std::string name;
+  uint64_t iterations = 0;
+  // Median and fastest repetition
+  double nsPerIteration = 0.0;
+  double minNsPerIteration = 0.0;
+  size_t itemsPerIteration = 0;
+};
+
+// Inputs of the kernel benchmarks, small enough to stay in cache
+constexpr size_t KernelItems = 4096;
+constexpr float WorldWidth = 1920.0f;
+constexpr float WorldHeight = 1080.0f;
+constexpr uint32_t Seed = 1;
+// Step benchmarks with more bullets get a larger world with the same density, a million bullets on a single
+// screen would overlap each other many times over
+constexpr size_t BulletsPerScreen = 10000;
+
+// Results of measured code end up here, so the compiler can't drop the work
+volatile float Sink;
+
+void PrintUsage()
+{
+  std::fprintf(stderr,
+    "usage: wallbreaker_microbench [--filter TEXT] [--max-bullets N] [--threads N] [--min-time SECONDS]\n"
+    "                              [--repetitions N]\n");
+}
+
+bool ParseArguments(int argc, char **argv, Options &options)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const char *arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+
+    if (std::strcmp(arg, "--filter") == 0 && hasValue)
+      options.filter = argv[++i];
+    else if (std::strcmp(arg, "--max-bullets") == 0 && hasValue)
+      options.maxBullets = std::strtoull(argv[++i], nullptr, 10);
+    else if (std::strcmp(arg, "--threads") == 0 && hasValue)
+      options.threads = std::max<size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+    else if (std::strcmp(arg, "--min-time") == 0 && hasValue)
+      options.minTime = std::strtod(argv[++i], nullptr);
+    else if (std::strcmp(arg, "--repetitions") == 0 && hasValue)
+      options.repetitions = std::max<size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+    else
+      return false;
+  }
+  return true;
+}
+
+class Runner
+{
+public:
+  explicit Runner(const Options &options) : m_options{ options } {}
+
+  bool IsSelected(const std::string &name) const
+  {
+    return m_options.filter.empty() || name.find(m_options.filter) != std::string::npos;
+  }
+
+  // Iterations per repetition are doubled until a batch runs for the minimum time,
+  // then every repetition runs that many iterations and the median is reported
+  template<typename Fn>
+  void Measure(const std::string &name, size_t itemsPerIteration, Fn &&fn)
+  {
+    if (!IsSelected(name))
+      return;
+
+    uint64_t iterations = 1;
+    for (;;)
+    {
+      const double seconds = RunBatch(iterations, fn);
+      if (seconds >= m_options.minTime || iterations >= (1ull << 40))
+        break;
+      // Jump close to the target right away once the batch is long enough to be measured
+      const double scale = seconds > 1e-4 ? m_options.minTime / seconds * 1.2 : 10.0;
+      iterations = std::max(iterations * 2, static_cast<uint64_t>(iterations * std::min(scale, 10.0)));
+    }
+
+    std::vector<double> nsPerIteration(m_options.repetitions);
+    for (double &ns : nsPerIteration)
+      ns = RunBatch(iterations, fn) * 1e9 / iterations;
+    std::sort(nsPerIteration.begin(), nsPerIteration.end());
+
+    Result result;
+    result.name = name;
+    result.iterations = iterations;
+    result.nsPerIteration = nsPerIteration[nsPerIteration.size() / 2];
+    result.minNsPerIteration = nsPerIteration.front();
+    result.itemsPerIteration = itemsPerIteration;
+    m_results.push_back(result);
+
+    std::fprintf(stderr, "%-56s %14.1f ns\n", name.c_str(), result.nsPerIteration);
+  }
+
+  const std::vector<Result> &GetResults() const { return m_results; }
+
+private:
+  template<typename Fn>
+  static double RunBatch(uint64_t iterations, Fn &fn)
+  {
+    const auto begin = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; ++i)
+      fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  }
+
+private:
+  const Options &m_options;
+  std::vector<Result> m_results;
+};
+
+struct KernelInputs
+{
+  std::vector<glm::vec2> positions;
+  std::vector<glm::vec2> velocities;
+  std::vector<float> radii;
+  std::vector<float> masses;
+  std::vector<Segment> segments;
+};
+
+KernelInputs CreateKernelInputs()
+{
+  std::mt19937 randGenerator(Seed);
+  std::uniform_real_distribution<float> distributeX(0.0f, 200.0f);
+  std::uniform_real_distribution<float> distributeY(0.0f, 200.0f);
+  std::uniform_real_distribution<float> distributeVelocity(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> distributeRadius(1.0f, 8.0f);
+  std::uniform_real_distribution<float> distributeOffset(-40.0f, 40.0f);
+
+  // Dense enough for roughly half of the tests to hit
+  KernelInputs inputs;
+  for (size_t i = 0; i < KernelItems; ++i)
+  {
+    const glm::vec2 position(distributeX(randGenerator), distributeY(randGenerator));
+    inputs.positions.push_back(position);
+    inputs.velocities.emplace_back(distributeVelocity(randGenerator), distributeVelocity(randGenerator));
+    inputs.radii.push_back(distributeRadius(randGenerator));
+    inputs.masses.push_back(inputs.radii.back() * 10.0f);
+
+    const glm::vec2 p0 = position + glm::vec2(distributeOffset(randGenerator), distributeOffset(randGenerator));
+    const glm::vec2 p1 = p0 + glm::vec2(distributeOffset(randGenerator), distributeOffset(randGenerator));
+    inputs.segments.push_back({ p0, p1, 2.0f });
+  }
+  return inputs;
+}
+
+void RunCollisionKernels(Runner &runner)
+{
+  KernelInputs inputs = CreateKernelInputs();
+  const std::vector<glm::vec2> &positions = inputs.positions;
+  const std::vector<float> &radii = inputs.radii;
+  const std::vector<Segment> &segments = inputs.segments;
+
+  // Every item is tested against its neighbour in the arrays
+  runner.Measure("DoCirclesOverlap", KernelItems, [&]() {
+    float hits = 0.0f;
+    for (size_t i = 0; i < KernelItems; ++i)
+    {
+      const size_t j = (i + 1) % KernelItems;
+      hits += Collision::DoCirclesOverlap(positions[i], radii[i], positions[j], radii[j]);
+    }
+    Sink = hits;
+  });
+
+  runner.Measure("IsPointInCircle", KernelItems, [&]() {
+    float hits = 0.0f;
+    for (size_t i = 0; i < KernelItems; ++i)
+      hits += Collision::IsPointInCircle(positions[i], radii[i] * 4.0f, positions[(i + 1) % KernelItems]);
+    Sink = hits;
+  });
+
+  runner.Measure("TestWallHit", KernelItems, [&]() {
+    float distance = 0.0f;
+    for (size_t i = 0; i < KernelItems; ++i)
+    {
+      Collision::WallHit hit;
+      if (Collision::TestWallHit(positions[i], radii[i], segments[i], hit))
+        distance += hit.distance;
+    }
+    Sink = distance;
+  });
+
+  runner.Measure("SweepCircleVsSegment", KernelItems, [&]() {
+    float toiSum = 0.0f;
+    for (size_t i = 0; i < KernelItems; ++i)
+    {
+      float toi = 0.0f;
+      if (Collision::SweepCircleVsSegment(positions[i], inputs.velocities[i] * 0.5f, radii[i], segments[i], toi))
+        toiSum += toi;
+    }
+    Sink = toiSum;
+  });
+
+  runner.Measure("SweepPointVsCircle", KernelItems, [&]() {
+    float toiSum = 0.0f;
+    for (size_t i = 0; i < KernelItems; ++i)
+    {
+      const size_t j = (i + 1) % KernelItems;
+      float toi = 0.0f;
+      const glm::vec2 motion = (inputs.velocities[i] - inputs.velocities[j]) * 0.5f;
+      if (Collision::SweepPointVsCircle(positions[i], motion, positions[j], radii[i] + radii[j], toi))
+        toiSum += toi;
+    }
+    Sink = toiSum;
+  });
+
+  // Velocities are written back, elastic collisions keep them bounded over any amount of iterations
+  runner.Measure("ExchangeMomentum", KernelItems / 2, [&]() {
+    std::vector<glm::vec2> &velocities = inputs.velocities;
+    for (size_t i = 0; i + 1 < KernelItems; i += 2)
+    {
+      Collision::ExchangeMomentum(
+        positions[i + 1] - positions[i], inputs.masses[i], velocities[i], inputs.masses[i + 1], velocities[i + 1]);
+    }
+    Sink = velocities[0].x;
+  });
+}
+
+void RunSimdKernels(Runner &runner)
+{
+  KernelInputs inputs = CreateKernelInputs();
+
+  std::vector<float> posX(KernelItems), posY(KernelItems), velX(KernelItems), velY(KernelItems);
+  for (size_t i = 0; i < KernelItems; ++i)
+  {
+    posX[i] = inputs.positions[i].x;
+    posY[i] = inputs.positions[i].y;
+    velX[i] = inputs.velocities[i].x;
+    velY[i] = inputs.velocities[i].y;
+  }
+
+  std::vector<Simd::SegmentsBlock> blocks(KernelItems / Simd::SegmentsBlockSize);
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    blocks[i].count = Simd::SegmentsBlockSize;
+    for (uint32_t lane = 0; lane < Simd::SegmentsBlockSize; ++lane)
+      blocks[i].Set(lane, inputs.segments[i * Simd::SegmentsBlockSize + lane]);
+  }
+
+  for (const auto instructionSet : { Simd::InstructionSet::Scalar, Simd::InstructionSet::Sse2, Simd::InstructionSet::Avx2 })
+  {
+    if (!Simd::IsSupported(instructionSet))
+      continue;
+    Simd::SetInstructionSet(instructionSet);
+    const std::string suffix = std::string("/isa:") + Simd::GetInstructionSetName(instructionSet);
+
+    // Movement of a bullet, wrapped around the world
+    runner.Measure("IntegrateAndWrap" + suffix, KernelItems, [&]() {
+      Simd::IntegrateAndWrap(
+        posX.data(), posY.data(), velX.data(), velY.data(), KernelItems, 1.0f / 30.0f, WorldWidth, WorldHeight);
+      Sink = posX[0];
+    });
+
+    // Every circle against a block of 8 segments
+    runner.Measure("SegmentsVsCircle" + suffix, KernelItems, [&]() {
+      uint32_t hits = 0;
+      for (size_t i = 0; i < KernelItems; ++i)
+      {
+        const glm::vec2 &position = inputs.positions[i];
+        hits += Simd::SegmentsVsCircle(blocks[i / Simd::SegmentsBlockSize], position.x, position.y, inputs.radii[i]);
+      }
+      Sink = static_cast<float>(hits);
+    });
+  }
+
+  Simd::SetInstructionSet(Simd::GetBestInstructionSet());
+}
+
+void RunCreateWalls(Runner &runner, const Options &options)
+{
+  std::unique_ptr<ThreadManager> threadManager;
+  if (options.threads > 1)
+    threadManager = std::make_unique<ThreadManager>(options.threads - 1);
+
+  // 32 x 32, 316 x 316 and 1000 x 1000 grids, about 1k, 100k and 1M walls
+  for (const unsigned int ratio : { 32u, 316u, 1000u })
+  {
+    const std::string name = "CreateWalls/walls:" + std::to_string(ratio * ratio);
+    if (!runner.IsSelected(name))
+      continue;
+
+    BulletManager bulletManager(WorldWidth, WorldHeight);
+    bulletManager.SetThreadManager(threadManager.get());
+    bulletManager.GenerateNewWalls(ratio, Seed);
+    const size_t walls = bulletManager.GetNumberOfWalls();
+    bulletManager.RemoveAllWalls();
+
+    // Removal is a part of every iteration, it's a few clears next to the generation
+    runner.Measure(name, walls, [&]() {
+      bulletManager.GenerateNewWalls(ratio, Seed);
+      bulletManager.RemoveAllWalls();
+    });
+  }
+}
+
+void RunSpawner(Runner &runner, const Options &options)
+{
+  std::unique_ptr<ThreadManager> threadManager;
+  if (options.threads > 1)
+    threadManager = std::make_unique<ThreadManager>(options.threads - 1);
+
+  // Every iteration is a 30 Hz tick worth of bullets, from a single emitter and spread over 16 of them
+  constexpr double tickTime = 1.0 / 30.0;
+  for (const double rate : { 100.0, 10000.0, 1000000.0 })
+  {
+    for (const size_t emitters : { 1u, 16u })
+    {
+      const std::string name =
+        "Spawner/rate:" + std::to_string(static_cast<uint64_t>(rate)) + "/emitters:" + std::to_string(emitters);
+      if (!runner.IsSelected(name))
+        continue;
+
+      Spawner spawner;
+      spawner.SetThreadManager(threadManager.get());
+      spawner.SetRandomSeed(Seed);
+      for (size_t e = 0; e < emitters; ++e)
+      {
+        EmitterConfig emitter;
+        emitter.pattern = static_cast<EmitterPattern>(e % 3);
+        emitter.rate = rate / emitters;
+        emitter.areaMax = glm::vec2(WorldWidth, WorldHeight);
+        emitter.origin = emitter.areaMax * 0.5f;
+        emitter.spread = e % 3 == 2 ? 0.1f : 6.2831853f;
+        emitter.minLifetime = 1.0f;
+        emitter.maxLifetime = 6.0f;
+        spawner.AddEmitter(emitter);
+      }
+
+      // The batch grows to its size before the measurement
+      spawner.Advance(tickTime);
+      const size_t bulletsPerTick = static_cast<size_t>(rate * tickTime);
+      runner.Measure(name, std::max<size_t>(1, bulletsPerTick), [&]() {
+        Sink = static_cast<float>(spawner.Advance(tickTime).size());
+      });
+    }
+  }
+}
+
+void RunSteps(Runner &runner, const Options &options)
+{
+  std::unique_ptr<ThreadManager> threadManager;
+  if (options.threads > 1)
+    threadManager = std::make_unique<ThreadManager>(options.threads - 1);
+
+  for (const size_t bullets : { 1000u, 10000u, 100000u, 1000000u })
+  {
+    if (bullets > options.maxBullets)
+      continue;
+
+    for (const unsigned int ratio : { 0u, 32u, 316u })
+    {
+      for (const bool collisions : { true, false })
+      {
+        for (const BroadPhaseType broadPhase :
+          { BroadPhaseType::SpatialHash, BroadPhaseType::SweepAndPrune, BroadPhaseType::BruteForce })
+        {
+          // Broad phases only matter with collisions, the quadratic one is left out of the large scenes
+          if (broadPhase != BroadPhaseType::SpatialHash
+              && (!collisions || (broadPhase == BroadPhaseType::BruteForce && bullets > 10000)))
+            continue;
+
+          // The default broad phase keeps the names results were tracked under before there was a choice
+          std::string name = "Step/bullets:" + std::to_string(bullets) + "/walls:" + std::to_string(ratio * ratio)
+                             + "/collisions:" + (collisions ? "1" : "0");
+          if (broadPhase != BroadPhaseType::SpatialHash)
+            name += std::string("/broad_phase:") + GetBroadPhaseName(broadPhase);
+          if (!runner.IsSelected(name))
+            continue;
+
+          const float scale = std::sqrt(std::max(1.0f, static_cast<float>(bullets) / BulletsPerScreen));
+          const float width = WorldWidth * scale;
+          const float height = WorldHeight * scale;
+
+          BulletManager bulletManager(width, height);
+          bulletManager.SetThreadManager(threadManager.get());
+          bulletManager.SetBroadPhase(broadPhase);
+          if (!collisions)
+            bulletManager.ToggleProcessBulletsCollision();
+          if (ratio > 0)
+            bulletManager.GenerateNewWalls(ratio, Seed);
+
+          std::mt19937 randGenerator(Seed);
+          std::uniform_real_distribution<float> distributeX(0.0f, width);
+          std::uniform_real_distribution<float> distributeY(0.0f, height);
+          std::uniform_real_distribution<float> distributeAngle(0.0f, 6.2831853f);
+
+          // Bullets outlive any measurement, walls they break are not replaced
+          std::vector<BulletSpawn> spawns(bullets);
+          for (BulletSpawn &spawn : spawns)
+          {
+            spawn.position = glm::vec2(distributeX(randGenerator), distributeY(randGenerator));
+            const float angle = distributeAngle(randGenerator);
+            spawn.direction = glm::vec2(std::cos(angle), std::sin(angle));
+            spawn.lifetime = 1e6f;
+          }
+          bulletManager.FireBatch(spawns);
+          bulletManager.SpawnQueuedBullets();
+
+          runner.Measure(name, bullets, [&]() { bulletManager.Step(); });
+        }
+      }
+    }
+  }
+}
+
+void PrintResults(const Options &options, const std::vector<Result> &results)
+{
+  std::printf("{\n  \"context\": {\"isa\": \"%s\", \"threads\": %zu, \"min_time_s\": %g, \"repetitions\": %zu},\n",
+    Simd::GetInstructionSetName(Simd::GetInstructionSet()),
+    options.threads,
+    options.minTime,
+    options.repetitions);
+  std::printf("  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    const Result &result = results[i];
+    const double nsPerItem = result.itemsPerIteration > 0 ? result.nsPerIteration / result.itemsPerIteration : 0.0;
+    std::printf("    {\"name\": \"%s\", \"iterations\": %llu, \"real_time_ns\": %.3f, \"min_time_ns\": %.3f, "
+                "\"items_per_iteration\": %zu, \"ns_per_item\": %.4f, \"items_per_second\": %.1f}%s\n",
+      result.name.c_str(),
+      static_cast<unsigned long long>(result.iterations),
+      result.nsPerIteration,
+      result.minNsPerIteration,
+      result.itemsPerIteration,
+      nsPerItem,
+      nsPerItem > 0.0 ? 1e9 / nsPerItem : 0.0,
+      i + 1 < results.size() ? "," : "");
+  }
+  std::printf("  ]\n}\n");
+  std::fflush(stdout);
+}
+}// namespace
+
+int main(int argc, char **argv)
+{
+  Options options;
+  if (!ParseArguments(argc, argv, options))
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  Runner runner(options);
+  RunCollisionKernels(runner);
+  RunSimdKernels(runner);
+  RunCreateWalls(runner, options);
+  RunSpawner(runner, options);
+  RunSteps(runner, options);
+
+  PrintResults(options, runner.GetResults());
+  return 0;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "FrameArena.hpp"
+#include "ThreadManager.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Added to the reach of bodies by the box tests of the broad phases, covers the rounding of the paths
+inline constexpr float BroadPhaseMargin = 1.0f / 16.0f;
+
+// Path of a bullet during a substep, everything the bullet pair tests read
+struct SweptBody
+{
+  glm::vec2 from;
+  glm::vec2 motion;
+  float radius;
+  float travel;
+};
+
+// Bullets moving less than their radius in a substep can't pass through each other, pairs of two such bullets are
+// only tested at the end of their paths
+inline bool NeedsSweep(const SweptBody &body)
+{
+  return body.travel > body.radius;
+}
+
+// Candidate pair of bullets, a < b
+struct BulletPair
+{
+  uint32_t a;
+  uint32_t b;
+};
+
+enum class BroadPhaseType : uint8_t
+{
+  SpatialHash,
+  SweepAndPrune,
+  BruteForce,
+};
+
+const char *GetBroadPhaseName(BroadPhaseType type);
+// Accepts the names given by GetBroadPhaseName
+bool ParseBroadPhase(const char *name, BroadPhaseType &type);
+
+// Bullets of a substep, awake ones first
+struct BroadPhaseInput
+{
+  const SweptBody *bodies;
+  size_t count;
+  size_t awakeCount;
+  // Stable slot of every bullet and the amount of slots, for broad phases keeping state between substeps
+  const uint32_t *slots;
+  size_t slotsCount;
+  float maxRadius;
+  float maxTravel;
+  float worldWidth;
+  float worldHeight;
+};
+
+// Finds the pairs of bullets which could meet during a substep. Every pair whose swept paths come within both radii,
+// or only the ends of the paths when neither bullet needs a sweep, across the world edges included, is reported
+// exactly once as (lower, higher) index, pairs of two sleeping bullets are left out. Extra pairs are rejected by the
+// narrow phase, so the contacts don't depend on the broad phase.
+class BroadPhase
+{
+public:
+  virtual ~BroadPhase() = default;
+
+  virtual BroadPhaseType GetType() const = 0;
+  // Called once per substep before the queries
+  virtual void Update(const BroadPhaseInput &input, ThreadManager *threadManager) = 0;
+  // Appends the pairs reported by the awake bullets [begin, end), every pair is reported by one of its bullets only.
+  // Disjoint ranges are queried concurrently, the ranges of a substep cover all awake bullets.
+  virtual void FindPairs(size_t begin, size_t end, ArenaVector<BulletPair> &pairs) const = 0;
+  // Forgets what was kept from the previous substeps, used when the bullets were replaced
+  virtual void Reset() {}
+};
+
+std::unique_ptr<BroadPhase> CreateBroadPhase(BroadPhaseType type);
@@ -1,6 +1,23 @@
 #pragma once
 #include <glm/glm.hpp>
 
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+inline constexpr size_t InvalidBulletIndex = SIZE_MAX;
+
+// Stable reference to a bullet. Indices change whenever another bullet is removed, handles don't;
+// once the bullet is removed its handle never matches again, even when the slot is reused.
+struct BulletHandle
+{
+  uint32_t slot = UINT32_MAX;
+  uint32_t generation = 0;
+
+  bool operator==(const BulletHandle &other) const { return slot == other.slot && generation == other.generation; }
+  bool operator!=(const BulletHandle &other) const { return !(*this == other); }
+};
+
 struct Bullet
 {
   glm::vec2 position;
@@ -8,6 +25,218 @@ struct Bullet
   glm::vec2 acceleration;
   float radius;
   float mass;
-  float spawntime;
-  float lifetime;
+  // Simulation ticks, the bullet is removed at the start of its death tick
+  uint32_t spawnTick;
+  uint32_t deathTick;
+};
+
+// Structure of arrays storage for bullets. Hot physics fields are kept in separate contiguous arrays,
+// so every simulation phase streams only through the data it needs. Render data is stored elsewhere.
+// Bullets stay densely packed, handle slots map stable handles to their current indices.
+struct BulletStorage
+{
+  // Current index of a live bullet, the generation is bumped when the slot is freed
+  struct HandleSlot
+  {
+    uint32_t index;
+    uint32_t generation;
+  };
+
+  // Hot data, touched by movement and collisions
+  std::vector<float> positionX;
+  std::vector<float> positionY;
+  std::vector<float> velocityX;
+  std::vector<float> velocityY;
+  std::vector<float> radius;
+  std::vector<float> mass;
+
+  // Positions at the start of the current tick, read only by render interpolation
+  std::vector<float> previousPositionX;
+  std::vector<float> previousPositionY;
+
+  // Cold data, touched only by expiration and sleeping
+  std::vector<uint32_t> spawnTick;
+  std::vector<uint32_t> deathTick;
+  std::vector<uint32_t> handleSlot;
+  // Consecutive steps spent below the sleep speed
+  std::vector<uint8_t> restingSteps;
+
+  // Freed slots are reused last in first out
+  std::vector<HandleSlot> handleSlots;
+  std::vector<uint32_t> freeHandleSlots;
+
+  size_t Size() const { return positionX.size(); }
+  bool Empty() const { return positionX.empty(); }
+
+  glm::vec2 Position(size_t i) const { return { positionX[i], positionY[i] }; }
+  glm::vec2 Velocity(size_t i) const { return { velocityX[i], velocityY[i] }; }
+
+  void SetPosition(size_t i, glm::vec2 position)
+  {
+    positionX[i] = position.x;
+    positionY[i] = position.y;
+  }
+
+  // Keeps the current positions for interpolation before they are advanced
+  void SavePreviousPositions()
+  {
+    previousPositionX = positionX;
+    previousPositionY = positionY;
+  }
+
+  void SetVelocity(size_t i, glm::vec2 velocity)
+  {
+    velocityX[i] = velocity.x;
+    velocityY[i] = velocity.y;
+  }
+
+  BulletHandle GetHandle(size_t i) const
+  {
+    const uint32_t slot = handleSlot[i];
+    return { slot, handleSlots[slot].generation };
+  }
+
+  // InvalidBulletIndex once the bullet was removed
+  size_t Find(BulletHandle handle) const
+  {
+    if (handle.slot >= handleSlots.size() || handleSlots[handle.slot].generation != handle.generation)
+      return InvalidBulletIndex;
+    return handleSlots[handle.slot].index;
+  }
+
+  size_t Add(const Bullet &bullet)
+  {
+    positionX.push_back(bullet.position.x);
+    positionY.push_back(bullet.position.y);
+    velocityX.push_back(bullet.velocity.x);
+    velocityY.push_back(bullet.velocity.y);
+    radius.push_back(bullet.radius);
+    mass.push_back(bullet.mass);
+    previousPositionX.push_back(bullet.position.x);
+    previousPositionY.push_back(bullet.position.y);
+    spawnTick.push_back(bullet.spawnTick);
+    deathTick.push_back(bullet.deathTick);
+    restingSteps.push_back(0);
+
+    uint32_t slot;
+    if (!freeHandleSlots.empty())
+    {
+      slot = freeHandleSlots.back();
+      freeHandleSlots.pop_back();
+    }
+    else
+    {
+      slot = static_cast<uint32_t>(handleSlots.size());
+      handleSlots.push_back({ 0, 0 });
+    }
+    handleSlots[slot].index = static_cast<uint32_t>(Size() - 1);
+    handleSlot.push_back(slot);
+
+    return Size() - 1;
+  }
+
+  // O(1) removal, the last bullet takes the place of the removed one
+  void SwapRemove(size_t i)
+  {
+    ReleaseHandleSlot(handleSlot[i]);
+
+    const size_t last = Size() - 1;
+    if (i != last)
+    {
+      positionX[i] = positionX[last];
+      positionY[i] = positionY[last];
+      velocityX[i] = velocityX[last];
+      velocityY[i] = velocityY[last];
+      radius[i] = radius[last];
+      mass[i] = mass[last];
+      previousPositionX[i] = previousPositionX[last];
+      previousPositionY[i] = previousPositionY[last];
+      spawnTick[i] = spawnTick[last];
+      deathTick[i] = deathTick[last];
+      restingSteps[i] = restingSteps[last];
+      handleSlot[i] = handleSlot[last];
+      handleSlots[handleSlot[i]].index = static_cast<uint32_t>(i);
+    }
+    PopBack();
+  }
+
+  // Exchanges two bullets, their handles follow them
+  void Swap(size_t i, size_t j)
+  {
+    std::swap(positionX[i], positionX[j]);
+    std::swap(positionY[i], positionY[j]);
+    std::swap(velocityX[i], velocityX[j]);
+    std::swap(velocityY[i], velocityY[j]);
+    std::swap(radius[i], radius[j]);
+    std::swap(mass[i], mass[j]);
+    std::swap(previousPositionX[i], previousPositionX[j]);
+    std::swap(previousPositionY[i], previousPositionY[j]);
+    std::swap(spawnTick[i], spawnTick[j]);
+    std::swap(deathTick[i], deathTick[j]);
+    std::swap(restingSteps[i], restingSteps[j]);
+    std::swap(handleSlot[i], handleSlot[j]);
+    handleSlots[handleSlot[i]].index = static_cast<uint32_t>(i);
+    handleSlots[handleSlot[j]].index = static_cast<uint32_t>(j);
+  }
+
+  // Drops the last bullet, its handle slot has to be released already
+  void PopBack()
+  {
+    positionX.pop_back();
+    positionY.pop_back();
+    velocityX.pop_back();
+    velocityY.pop_back();
+    radius.pop_back();
+    mass.pop_back();
+    previousPositionX.pop_back();
+    previousPositionY.pop_back();
+    spawnTick.pop_back();
+    deathTick.pop_back();
+    restingSteps.pop_back();
+    handleSlot.pop_back();
+  }
+
+  void Reserve(size_t count)
+  {
+    positionX.reserve(count);
+    positionY.reserve(count);
+    velocityX.reserve(count);
+    velocityY.reserve(count);
+    radius.reserve(count);
+    mass.reserve(count);
+    previousPositionX.reserve(count);
+    previousPositionY.reserve(count);
+    spawnTick.reserve(count);
+    deathTick.reserve(count);
+    restingSteps.reserve(count);
+    handleSlot.reserve(count);
+    handleSlots.reserve(count);
+    freeHandleSlots.reserve(count);
+  }
+
+  void Clear()
+  {
+    positionX.clear();
+    positionY.clear();
+    velocityX.clear();
+    velocityY.clear();
+    radius.clear();
+    mass.clear();
+    previousPositionX.clear();
+    previousPositionY.clear();
+    spawnTick.clear();
+    deathTick.clear();
+    restingSteps.clear();
+
+    for (const uint32_t slot : handleSlot)
+      ReleaseHandleSlot(slot);
+    handleSlot.clear();
+  }
+
+  void ReleaseHandleSlot(uint32_t slot)
+  {
+    handleSlots[slot].index = UINT32_MAX;
+    ++handleSlots[slot].generation;
+    freeHandleSlots.push_back(slot);
+  }
 };
@@ -1,70 +1,298 @@
 #pragma once
+#include "BroadPhase.hpp"
 #include "Bullet.hpp"
+#include "Contact.hpp"
+#include "FrameArena.hpp"
 #include "Segment.hpp"
+#include "TimingWheel.hpp"
+#include "WallIndex.hpp"
+#include "WorldChunks.hpp"
+#include "MpscQueue.hpp"
+#include "RenderSnapshot.hpp"
+#include "ThreadManager.hpp"
+#include "Color.hpp"
 
-#include <SFML/Graphics.hpp>
-
-#include <vector>
+#include <cstdint>
+#include <memory>
 #include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+class ReplayRecorder;
 
 inline constexpr float DefaultBulletLifeTime = 5.0f;
 inline constexpr float DefaultBulletRadius = 3.0f;
-inline const sf::Color DefaultBulletColor = sf::Color::Black;
+inline constexpr float DefaultBulletSpeed = 100.0f;
+inline constexpr Color DefaultBulletColor = Colors::Black;
+inline constexpr size_t DefaultSpawnQueueCapacity = 1 << 16;
+inline constexpr float DefaultFixedDeltaTime = 1.0f / 60.0f;
+inline constexpr uint32_t DefaultRandomSeed = 1;
+// Bullets slower than that for a few steps in a row fall asleep. The integration stops them below the same speed,
+// so only bullets which have already stopped are put to sleep.
+inline constexpr float DefaultSleepSpeed = 0.1f;
+inline constexpr uint8_t DefaultSleepSteps = 4;
+// Walls a bullet can bounce off within one substep, the path left after the last bounce isn't swept
+inline constexpr uint32_t MaxWallBounces = 4;
+
+// Identifies a wall for its whole life, while its slot in the walls array changes on compaction
+using WallId = uint32_t;
+inline constexpr size_t InvalidWallSlot = SIZE_MAX;
+
+// Where a streamed wall was generated, so its chunk can create it again or leave it out once destroyed
+struct WallOrigin
+{
+  uint32_t chunk = InvalidChunk;
+  // Grid rectangle of the wall within the chunk
+  uint32_t index = 0;
+};
 
-class WallBreaker;
+// Bullet spawn request produced by firing threads and consumed by the simulation
+struct SpawnRequest
+{
+  glm::vec2 position;
+  glm::vec2 velocity;
+  // Seconds, converted to ticks when the bullet is spawned
+  float lifetime;
+  float radius = DefaultBulletRadius;
+  // Seconds, the bullet is staged until then and appears at a later tick
+  float delay = 0.0f;
+};
+
+// Bullet description accepted by FireBatch, pattern generators produce them in bulk
+struct BulletSpawn
+{
+  glm::vec2 position{};
+  // Unit vector
+  glm::vec2 direction{ 1.0f, 0.0f };
+  float speed = DefaultBulletSpeed;
+  float lifetime = DefaultBulletLifeTime;
+  float radius = DefaultBulletRadius;
+  float delay = 0.0f;
+};
 
+// Simulation core: bullets, walls and their collisions. Doesn't depend on any window or renderer,
+// render back-ends read the state through the const accessors below.
 class BulletManager
 {
 public:
-  BulletManager() = default;
-  BulletManager(sf::RenderWindow *window, float viewportWidth, float viewportHeight)
-    : m_window(window), m_viewportWidth{ viewportWidth }, m_viewportHeight{ viewportHeight }
+  BulletManager(float viewportWidth, float viewportHeight)
+    : m_viewportWidth{ viewportWidth }, m_viewportHeight{ viewportHeight }
   {
   }
   ~BulletManager() = default;
 
-  void Fire(glm::vec2 pos, glm::vec2 dir, float speed, float time, float lifetime = DefaultBulletLifeTime);
-  void Update(float time);
+  // Thread safe and never blocks, returns false if the spawn queue is full and the bullet was dropped.
+  // The bullet is stamped with the tick at which the simulation picks it up.
+  bool Fire(glm::vec2 pos, glm::vec2 dir, float speed, float lifetime = DefaultBulletLifeTime);
+  // Thread safe, appends the whole batch under one short lock and never drops bullets.
+  // All of them are spawned at the same tick, in the given order.
+  void FireBatch(const BulletSpawn *spawns, size_t count);
+  void FireBatch(const std::vector<BulletSpawn> &spawns) { FireBatch(spawns.data(), spawns.size()); }
+  // Advances the simulation by one fixed tick, split into the configured amount of substeps
+  void Step();
+  // Applies queued spawns at the current tick without advancing the simulation
+  void SpawnQueuedBullets();
+  // Spawns bullets right away, or stages the delayed ones, simulation thread only
+  void Spawn(const SpawnRequest &request);
+  void Spawn(const SpawnRequest *requests, size_t count);
+
+  void SetFixedDeltaTime(float deltaTime) { m_fixedDeltaTime = deltaTime; }
+  float GetFixedDeltaTime() const { return m_fixedDeltaTime; }
+  void SetSubsteps(uint32_t substeps) { m_substeps = substeps > 0 ? substeps : 1; }
+  uint32_t GetSubsteps() const { return m_substeps; }
+  // Amount of ticks simulated so far
+  uint32_t GetTick() const { return m_tick; }
+
+  // Seeds the generator which picks seeds for new walls
+  void SetRandomSeed(uint32_t seed) { m_randomGenerator.seed(seed); }
+  // Every state changing event is written to the recorder until it's reset to nullptr
+  void SetRecorder(ReplayRecorder *recorder) { m_recorder = recorder; }
+  // Hash of bullets, walls and the current tick, equal for bit exact simulations
+  uint64_t ComputeStateHash() const;
+
+  // Flat image of the whole simulation state (see Checkpoint.hpp), the simulation continues from a loaded one
+  // bit exactly. Call between steps on the simulation thread. Bullets fired but not spawned yet aren't saved,
+  // a load leaves them queued. Thread manager and recorder aren't a part of the state.
+  bool SaveCheckpoint(const std::string &path) const;
+  // The state is left untouched when the file isn't a valid checkpoint
+  bool LoadCheckpoint(const std::string &path);
 
   void SetViewportWidth(float width) { m_viewportWidth = width; }
   void SetViewportHeight(float height) { m_viewportHeight = height; }
+  float GetViewportWidth() const { return m_viewportWidth; }
+  float GetViewportHeight() const { return m_viewportHeight; }
 
-  void ToggleProcessBulletsCollision() { m_processBulletsCollision = !m_processBulletsCollision; }
+  // Simulation runs serially without a thread manager
+  void SetThreadManager(ThreadManager *threadManager) { m_threadManager = threadManager; }
 
-  size_t GetNumberOfBullets() { return m_bullets.size(); }
-  size_t GetNumberOfWalls() { return m_walls.size(); }
+  void ToggleProcessBulletsCollision();
+  bool IsProcessingBulletsCollision() const { return m_processBulletsCollision; }
 
+  // Finds the bullet pairs tested each substep, contacts are the same whichever is used
+  void SetBroadPhase(BroadPhaseType type);
+  BroadPhaseType GetBroadPhaseType() const { return m_broadPhase->GetType(); }
+
+  // Sleeping bullets are neither moved nor tested against walls, they are only targets for awake bullets
+  // and wake up when one of them hits them. Disabling wakes everybody up.
+  void SetSleepingEnabled(bool enabled);
+  bool IsSleepingEnabled() const { return m_sleepingEnabled; }
+
+  size_t GetNumberOfBullets() const { return m_bullets.Size(); }
+  // Delayed spawns not in the scene yet
+  size_t GetNumberOfStagedBullets() const { return m_stagedSpawns.Size(); }
+  size_t GetNumberOfSleepingBullets() const { return m_bullets.Size() - m_awakeCount; }
+  size_t GetNumberOfWalls() const { return m_walls.size(); }
+  MpscQueueStats GetSpawnQueueStats() const { return m_spawnQueue.GetStats(); }
+  // Everything the collision pipeline allocates comes from these arenas, summed up
+  FrameArenaStats GetCollisionArenaStats() const;
+
+  // Adds ratio x ratio walls to the ones already in the scene, seed is taken from the bullet manager generator
   void GenerateNewWalls(unsigned int ratio);
+  void GenerateNewWalls(unsigned int ratio, uint32_t seed);
   void RemoveAllWalls();
 
+  // Streamed walls are generated chunk by chunk instead of all at once: ratio x ratio walls per chunk, created
+  // when an awake bullet gets next to the chunk and dropped again once the chunk is left alone for a while.
+  // Only walls around activity take memory, whatever the size of the world. Takes effect with the next generation.
+  void SetWallStreaming(bool enabled) { m_wallStreaming = enabled; }
+  bool IsStreamingWalls() const { return m_wallStreaming; }
+  size_t GetNumberOfLoadedChunks() const { return m_chunks.GetLoadedChunks().size(); }
+
+  // Read only state for render back-ends
+  const BulletStorage &GetBullets() const { return m_bullets; }
+  const std::vector<Color> &GetBulletColors() const { return m_bulletColors; }
+  const std::vector<Segment> &GetWalls() const { return m_walls; }
+  const std::vector<Color> &GetWallColors() const { return m_wallColors; }
+  uint64_t GetWallsRevision() const { return m_wallsRevision; }
+  // Copies the render state into a snapshot handed over to another thread, walls only when they changed
+  void WriteRenderSnapshot(RenderSnapshot &snapshot) const;
+
+  BulletHandle GetBulletHandle(size_t i) const { return m_bullets.GetHandle(i); }
+  // Current index of the bullet in GetBullets(), InvalidBulletIndex once it was removed
+  size_t FindBullet(BulletHandle handle) const { return m_bullets.Find(handle); }
+
+  WallId GetWallId(size_t slot) const { return m_wallIds[slot]; }
+  // Current slot of the wall in GetWalls(), InvalidWallSlot once it was destroyed
+  size_t FindWall(WallId id) const { return id < m_wallSlots.size() ? m_wallSlots[id] : InvalidWallSlot; }
+
 private:
-  int CreateBullet(glm::vec2 pos, float radius, float time, float lifetime, sf::Color color = DefaultBulletColor);
-  inline void MoveBullet(Bullet &bullet, float dt);
+  int CreateBullet(glm::vec2 pos, float radius, float lifetime, Color color = DefaultBulletColor);
+  // Room for count more bullets, grows geometrically
+  void ReserveBullets(size_t count);
+  void RemoveBullet(size_t i);
+  void SwapBullets(size_t i, size_t j);
+  // Puts bullets resting for long enough to sleep, at the end of every step
+  void UpdateSleeping();
+  // Moves sleeping bullets hit during the substep back among the awake ones
+  void WakeBullets();
+  void RemoveExpiredBullets();
+  void ResetCollisionScratch();
+  void MoveBullets(float dt);
   void ProcessBulletsCollision(float dt);
+  // Sweeps the bullets, all the awake ones when null, against the walls and bounces each off the first wall on its
+  // path. Bullets with some of the substep left after their bounce are returned to be swept again.
+  void ProcessWallsCollision(const uint32_t *bullets, size_t count, std::vector<uint32_t> &bounced);
+  glm::vec2 WrappedDelta(glm::vec2 from, glm::vec2 to) const;
+  glm::vec2 WrapPosition(glm::vec2 position) const;
+  void ExchangeMomentum(glm::vec2 p1, float mass1, glm::vec2 &v1, glm::vec2 p2, float mass2, glm::vec2 &v2) const;
 
   // Walls stuff should be separated into a separate context for sure ASAP
-  int CreateWall(glm::vec2 start_pos, glm::vec2 end_pos, float thickness, sf::Color color)
-  {
-    size_t i = m_walls.size();
-    m_walls.push_back({ start_pos, end_pos, thickness });
-    m_wallShapes.push_back(SegmentShape(m_walls[i].p0, m_walls[i].p1, color, thickness));
-    return i;
-  }
-  void CreateWalls(unsigned int gridRatio, float thickness, sf::Color color);
+  bool IsWallDead(size_t i) const { return (m_deadWalls[i >> 6] >> (i & 63)) & 1; }
+  // Destroyed walls stay in place until the end of the step, every query skips them
+  void KillWall(size_t i);
+  // Leaves the wall out of the next compaction without destroying it, used when its chunk is unloaded
+  void MarkWallDead(size_t i);
+  void CompactWalls();
+  void CreateWalls(unsigned int gridRatio, uint32_t seed);
+  // One wall in every rectangle of a gridRatio x gridRatio grid over the area, appended to the walls already there.
+  // Chunk walls remember their origin. Cells are generated in parallel, the result doesn't depend on the threads.
+  void CreateWallsInArea(glm::vec2 min, glm::vec2 size, unsigned int gridRatio, uint32_t seed, uint32_t chunk);
+  void StartStreamingWalls(unsigned int ratio, uint32_t seed);
+  // Loads chunks around awake bullets and unloads idle ones, at the start of every step
+  void StreamWalls();
+  void LoadChunkWalls(uint32_t chunk);
 
 private:
-  std::mutex m_bulletsMutex;
-  std::vector<Bullet> m_bullets;
-  std::vector<sf::CircleShape> m_bulletShapes;
+  // Bullets are fired from many threads, spawns are applied by the simulation at the start of each step
+  MpscQueue<SpawnRequest> m_spawnQueue{ DefaultSpawnQueueCapacity };
+  // Batches are appended here and swapped out by the simulation, both buffers keep their capacity
+  std::mutex m_spawnBatchMutex;
+  std::vector<SpawnRequest> m_spawnBatch;
+  std::vector<SpawnRequest> m_drainedSpawnBatch;
+  BulletStorage m_bullets;
+  // Awake bullets come first, [m_awakeCount, size) are sleeping
+  size_t m_awakeCount = 0;
+  bool m_sleepingEnabled = true;
+  // Sleeping bullets hit during the current substep, may contain duplicates
+  std::vector<uint32_t> m_wokenBullets;
+  // Bullets keyed on their death tick, every step touches only the ones expiring at it
+  TimingWheel<BulletHandle> m_expiryWheel;
+  // Delayed spawns keyed on the tick they appear at
+  TimingWheel<SpawnRequest> m_stagedSpawns;
+  // Render data is kept apart from physics, in the same order as m_bullets
+  std::vector<Color> m_bulletColors;
+  std::unique_ptr<BroadPhase> m_broadPhase = CreateBroadPhase(BroadPhaseType::SpatialHash);
 
   std::vector<Segment> m_walls;
-  std::vector<SegmentShape> m_wallShapes;
+  std::vector<Color> m_wallColors;
+  // Changed on every wall creation/destruction, so static render geometry knows when to rebuild
+  uint64_t m_wallsRevision = 0;
+  WallIndex m_wallIndex;
+  // One bit per wall slot, set for walls destroyed during the current step
+  std::vector<uint64_t> m_deadWalls;
+  size_t m_deadWallsCount = 0;
+  // Slot to id and id to slot, ids are never reused
+  std::vector<WallId> m_wallIds;
+  std::vector<size_t> m_wallSlots;
+  // Parallel to m_walls
+  std::vector<WallOrigin> m_wallOrigins;
+  // First wall written by every parallel chunk of generated cells
+  std::vector<size_t> m_wallChunkOffsets;
+
+  bool m_wallStreaming = false;
+  // Zero unless streamed walls were generated
+  unsigned int m_streamedWallsRatio = 0;
+  uint32_t m_streamedWallsSeed = 0;
+  WorldChunks m_chunks;
+  std::vector<uint32_t> m_streamedChunks;
+
+  // Scratch of a parallel chunk, its arena is used by one task at a time
+  struct CollisionChunk
+  {
+    FrameArena arena;
+    ArenaVector<Contact> contacts;
+    ArenaVector<BulletPair> pairs;
+    std::vector<uint32_t> nearWalls;
+  };
+
+  // Collision scratch is reset at the start of every step, capacity is kept between steps
+  std::vector<CollisionChunk> m_collisionChunks;
+  FrameArena m_stepArena;
+  // Bullet contacts resolved at the end of the substep
+  ArenaVector<Contact> m_deferredContacts;
+  // Bullet contacts of all chunks in the order they are resolved
+  ArenaVector<Contact> m_bulletContacts;
+
+  // Start and duration of the path every bullet is swept along in the current substep
+  std::vector<float> m_sweepFromX;
+  std::vector<float> m_sweepFromY;
+  std::vector<float> m_sweepTime;
+  std::vector<SweptBody> m_sweptBodies;
+  // Bullets swept again against the walls after a bounce, and the ones bouncing in the current pass
+  std::vector<uint32_t> m_sweptBullets;
+  std::vector<uint32_t> m_bouncedBullets;
 
   float m_viewportWidth;
   float m_viewportHeight;
 
   bool m_processBulletsCollision = true;
 
-  float m_lastTimeStamp = 0.0f;
-  sf::RenderWindow *m_window;
+  float m_fixedDeltaTime = DefaultFixedDeltaTime;
+  uint32_t m_substeps = 1;
+  uint32_t m_tick = 0;
+  std::mt19937 m_randomGenerator{ DefaultRandomSeed };
+  ReplayRecorder *m_recorder = nullptr;
+
+  ThreadManager *m_threadManager = nullptr;
 };
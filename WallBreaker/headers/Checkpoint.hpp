@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Flat binary image of the whole simulation state, see BulletManager::SaveCheckpoint.
+// Layout: CheckpointHeader, then one section per CheckpointSection, every section starts at a multiple
+// of CheckpointSectionAlignment. Sections are the raw contents of the simulation arrays, in native layout,
+// so a checkpoint is loaded with one bulk copy per array straight out of the mapped file.
+inline constexpr char CheckpointMagic[4] = { 'W', 'B', 'C', 'P' };
+// Version 2 added streamed walls. Version 3 changed how walls are generated, chunks of older checkpoints would load
+// other walls than they were saved with. Checkpoints are meant for the build which wrote them, older ones are rejected.
+inline constexpr uint32_t CheckpointVersion = 3;
+// Written as is, a checkpoint from a machine of the other endianness is rejected
+inline constexpr uint32_t CheckpointByteOrderMark = 0x01020304;
+inline constexpr size_t CheckpointSectionAlignment = 64;
+
+enum class CheckpointSection : uint32_t
+{
+  PositionX,
+  PositionY,
+  VelocityX,
+  VelocityY,
+  Radius,
+  Mass,
+  PreviousPositionX,
+  PreviousPositionY,
+  SpawnTick,
+  DeathTick,
+  HandleSlot,
+  RestingSteps,
+  BulletColors,
+  HandleSlots,
+  FreeHandleSlots,
+  // TimingWheel buckets: the item count of every bucket, then their entries one bucket after another
+  ExpiryBucketSizes,
+  ExpiryEntries,
+  StagedBucketSizes,
+  StagedEntries,
+  Walls,
+  WallColors,
+  WallIds,
+  WallOrigins,
+  // WorldChunks state of streamed walls, empty without them
+  ChunkTouchTicks,
+  LoadedChunks,
+  DestroyedWalls,
+  // Text form of the standard generator state, the only portable way to get it out
+  RandomState,
+  Count
+};
+
+inline constexpr size_t CheckpointSectionsCount = static_cast<size_t>(CheckpointSection::Count);
+
+struct CheckpointSectionRange
+{
+  // From the start of the file, in bytes
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct CheckpointHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t byteOrderMark;
+  uint32_t headerSize;
+  uint64_t fileSize;
+
+  float viewportWidth;
+  float viewportHeight;
+  float fixedDeltaTime;
+  uint32_t substeps;
+  uint32_t tick;
+  uint8_t processBulletsCollision;
+  uint8_t sleeping;
+  uint8_t wallStreaming;
+  uint8_t reserved;
+
+  uint64_t bulletsCount;
+  uint64_t awakeCount;
+  uint64_t wallsCount;
+  // Ids handed out so far, ids of destroyed walls are never reused
+  uint64_t wallIdsCount;
+  uint32_t expiryNextTick;
+  uint32_t stagedNextTick;
+  // Zero when walls aren't streamed
+  uint32_t streamedWallsRatio;
+  uint32_t streamedWallsSeed;
+  uint32_t chunksCount;
+  uint32_t reserved2;
+
+  CheckpointSectionRange sections[CheckpointSectionsCount];
+};
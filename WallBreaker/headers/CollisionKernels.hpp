@@ -0,0 +1,160 @@
+#pragma once
+#include "Math.hpp"
+#include "Segment.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// Geometric kernels of the narrow phase and the collision response. They live in a header,
+// so the simulation and the microbenchmarks run exactly the same code.
+namespace Collision
+{
+inline bool DoCirclesOverlap(glm::vec2 v1, float r1, glm::vec2 v2, float r2)
+{
+  const glm::vec2 v = v1 - v2;
+  return Math::dot(v, v) <= (r1 + r2) * (r1 + r2);
+}
+inline bool IsPointInCircle(glm::vec2 c, float r1, glm::vec2 p)
+{
+  const glm::vec2 v = c - p;
+  return Math::dot(v, v) < (r1 * r1);
+}
+
+struct WallHit
+{
+  glm::vec2 closestPoint;
+  glm::vec2 normal;
+  float distance;
+  float t;
+};
+
+inline bool TestWallHit(glm::vec2 position, float radius, const Segment &edge, WallHit &hit)
+{
+  const glm::vec2 v0 = edge.p1 - edge.p0;
+  const glm::vec2 v1 = position - edge.p0;
+
+  const float len = Math::dot(v0, v0);
+  // Clamping distance between 0 and 1 to handle only segment collion, not the infinite line
+  hit.t = std::max(0.0f, std::min(len, Math::dot(v0, v1))) / len;
+
+  hit.closestPoint = edge.p0 + v0 * hit.t;
+  hit.normal = position - hit.closestPoint;
+  hit.distance = Math::length(hit.normal);
+
+  return hit.distance <= (radius + edge.thickness);
+}
+
+// Earliest t in [0, 1] at which a point moving from origin by motion gets within radius of center
+inline bool SweepPointVsCircle(glm::vec2 origin, glm::vec2 motion, glm::vec2 center, float radius, float &toi)
+{
+  const glm::vec2 f = origin - center;
+  const float c = Math::dot(f, f) - radius * radius;
+  if (c <= 0.0f)
+  {
+    toi = 0.0f;
+    return true;
+  }
+
+  // Not moving or moving away
+  const float a = Math::dot(motion, motion);
+  const float b = Math::dot(f, motion);
+  if (a <= 0.0f || b >= 0.0f)
+    return false;
+
+  const float discriminant = b * b - a * c;
+  if (discriminant < 0.0f)
+    return false;
+
+  const float t = (-b - std::sqrt(discriminant)) / a;
+  if (t > 1.0f)
+    return false;
+  toi = std::max(t, 0.0f);
+  return true;
+}
+
+// Earliest t in [0, 1] at which a circle moving from origin by motion touches the thick segment.
+// The segment inflated by both radii is a capsule: two rounded ends and two flat sides.
+inline bool SweepCircleVsSegment(glm::vec2 origin, glm::vec2 motion, float radius, const Segment &edge, float &toi)
+{
+  const float reach = radius + edge.thickness;
+  bool found = false;
+  float t;
+
+  if (SweepPointVsCircle(origin, motion, edge.p0, reach, t))
+  {
+    toi = t;
+    found = true;
+  }
+  if (SweepPointVsCircle(origin, motion, edge.p1, reach, t) && (!found || t < toi))
+  {
+    toi = t;
+    found = true;
+  }
+
+  const glm::vec2 axis = edge.p1 - edge.p0;
+  const float lengthSq = Math::dot(axis, axis);
+  if (lengthSq <= 0.0f)
+    return found;
+
+  const float length = std::sqrt(lengthSq);
+  const glm::vec2 normal(-axis.y / length, axis.x / length);
+  const float distance = Math::dot(origin - edge.p0, normal);
+
+  if (std::abs(distance) <= reach)
+  {
+    // Between the side lines already, either inside the body or outside of its ends (covered by the rounded ends)
+    const float projection = Math::dot(origin - edge.p0, axis);
+    if (projection >= 0.0f && projection <= lengthSq)
+    {
+      toi = 0.0f;
+      return true;
+    }
+    return found;
+  }
+
+  const float approach = Math::dot(motion, normal);
+  if (approach == 0.0f)
+    return found;
+
+  // Only the side facing the circle can be hit first
+  const float side = distance > 0.0f ? reach : -reach;
+  const float sideToi = (side - distance) / approach;
+  if (sideToi < 0.0f || sideToi > 1.0f || (found && sideToi >= toi))
+    return found;
+
+  const float projection = Math::dot(origin + motion * sideToi - edge.p0, axis);
+  if (projection < 0.0f || projection > lengthSq)
+    return found;
+
+  toi = sideToi;
+  return true;
+}
+
+// Elastic collision of two bodies, delta goes from the first one to the second one
+inline void ExchangeMomentum(glm::vec2 delta, float mass1, glm::vec2 &v1, float mass2, glm::vec2 &v2)
+{
+  const float fDistance = Math::length(delta);
+  if (fDistance <= 0.0f)
+    return;
+  glm::vec2 n = delta / fDistance;
+
+  glm::vec2 tangent = { -n.y, n.x };
+  // Dot Product Tangent
+  float dpTan1 = Math::dot(v1, tangent);
+  float dpTan2 = Math::dot(v2, tangent);
+
+  // Dot Product Normal
+  float dpNorm1 = Math::dot(v1, n);
+  float dpNorm2 = Math::dot(v2, n);
+
+  // Conservation of momentum in 1D
+  float m1 = (dpNorm1 * (mass1 - mass2) + 2.0f * mass2 * dpNorm2) / (mass1 + mass2);
+  float m2 = (dpNorm2 * (mass2 - mass1) + 2.0f * mass1 * dpNorm1) / (mass1 + mass2);
+
+  // Update bullet velocities
+  v1 = tangent * dpTan1 + n * m1;
+  v2 = tangent * dpTan2 + n * m2;
+}
+}// namespace Collision
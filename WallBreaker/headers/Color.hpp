@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+
+// Renderer independent RGBA color, so the simulation doesn't depend on any graphics library
+struct Color
+{
+  uint8_t r = 0;
+  uint8_t g = 0;
+  uint8_t b = 0;
+  uint8_t a = 255;
+};
+
+namespace Colors
+{
+inline constexpr Color Black{ 0, 0, 0, 255 };
+inline constexpr Color White{ 255, 255, 255, 255 };
+inline constexpr Color Yellow{ 255, 255, 0, 255 };
+inline constexpr Color Cyan{ 0, 255, 255, 255 };
+}// namespace Colors
@@ -0,0 +1,28 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+// Immovable body standing in for a wall endpoint, bullets bounce off it like off another bullet
+struct StaticBody
+{
+  glm::vec2 position;
+  float radius;
+  float mass;
+};
+
+// Contact found by the narrow phase along the path of bullet a during a substep
+struct Contact
+{
+  uint32_t a;
+  // Another bullet or a wall
+  uint32_t b;
+  // Fraction of the path of a travelled before the impact
+  float toi;
+  // Unit vector from b towards a at the moment of impact, zero when the centre lies right on b
+  glm::vec2 normal;
+  float penetration;
+  // Set for hits on a wall endpoint only, allocated from the arena of the collision chunk which found the hit and
+  // valid until the next step resets the chunk arenas
+  const StaticBody *endpoint;
+};
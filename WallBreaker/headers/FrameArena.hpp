@@ -0,0 +1,118 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+inline constexpr size_t DefaultFrameArenaBlockSize = 64 * 1024;
+
+struct FrameArenaStats
+{
+  // Blocks taken from the heap since the arena was created
+  uint64_t heapAllocations = 0;
+  size_t capacity = 0;
+  size_t used = 0;
+  // Largest amount used between two resets
+  size_t peakUsed = 0;
+};
+
+// Linear allocator for data living during a single simulation step: allocation is a pointer bump
+// and everything is released at once by Reset. When a step didn't fit into one block, the blocks are
+// merged into a single larger one on reset, so steady state steps don't touch the heap at all.
+// Destructors are never called, only trivially destructible types are accepted.
+class FrameArena
+{
+public:
+  explicit FrameArena(size_t blockSize = DefaultFrameArenaBlockSize) : m_blockSize{ blockSize } {}
+  ~FrameArena() = default;
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+  FrameArena(FrameArena &&) = default;
+  FrameArena &operator=(FrameArena &&) = default;
+
+  void *Allocate(size_t size, size_t alignment);
+
+  // Uninitialised storage for count objects
+  template<typename T>
+  T *Allocate(size_t count)
+  {
+    static_assert(std::is_trivially_destructible_v<T>, "arena memory is released without destructors");
+    return static_cast<T *>(Allocate(count * sizeof(T), alignof(T)));
+  }
+
+  // Invalidates everything allocated so far
+  void Reset();
+
+  FrameArenaStats GetStats() const;
+
+private:
+  struct Block
+  {
+    std::unique_ptr<std::byte[]> memory;
+    size_t size;
+  };
+
+  void AddBlock(size_t size);
+
+private:
+  size_t m_blockSize;
+  // Allocations are served from the last block, the previous ones are full
+  std::vector<Block> m_blocks;
+  size_t m_offset = 0;
+  size_t m_usedInFullBlocks = 0;
+  size_t m_peakUsed = 0;
+  uint64_t m_heapAllocations = 0;
+};
+
+// Growable array in arena memory. Growing doubles the storage and leaves the old one to the arena,
+// which gets it back on reset. Bound to its arena, it must not outlive the next reset.
+template<typename T>
+class ArenaVector
+{
+  static_assert(std::is_trivially_copyable_v<T>, "elements are moved with memcpy");
+
+public:
+  ArenaVector() = default;
+  explicit ArenaVector(FrameArena &arena, size_t capacity = 0) : m_arena{ &arena } { Reserve(capacity); }
+
+  void PushBack(const T &value)
+  {
+    if (m_size == m_capacity)
+      Reserve(m_capacity > 0 ? m_capacity * 2 : 16);
+    m_data[m_size++] = value;
+  }
+
+  void Reserve(size_t capacity)
+  {
+    if (capacity <= m_capacity)
+      return;
+    T *data = m_arena->Allocate<T>(capacity);
+    if (m_size > 0)
+      std::memcpy(data, m_data, m_size * sizeof(T));
+    m_data = data;
+    m_capacity = capacity;
+  }
+
+  // Keeps the storage
+  void Clear() { m_size = 0; }
+
+  size_t Size() const { return m_size; }
+  bool Empty() const { return m_size == 0; }
+
+  T &operator[](size_t i) { return m_data[i]; }
+  const T &operator[](size_t i) const { return m_data[i]; }
+
+  T *begin() { return m_data; }
+  T *end() { return m_data + m_size; }
+  const T *begin() const { return m_data; }
+  const T *end() const { return m_data + m_size; }
+
+private:
+  FrameArena *m_arena = nullptr;
+  T *m_data = nullptr;
+  size_t m_size = 0;
+  size_t m_capacity = 0;
+};
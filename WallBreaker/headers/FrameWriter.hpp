@@ -0,0 +1,41 @@
+#pragma once
+#include "Color.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Writes rendered frames out, either as numbered PPM images or as raw RGBA frames one after another,
+// into a file or into the standard input of a command such as a video encoder.
+class FrameWriter
+{
+public:
+  FrameWriter() = default;
+  ~FrameWriter() { Close(); }
+
+  FrameWriter(const FrameWriter &) = delete;
+  FrameWriter &operator=(const FrameWriter &) = delete;
+
+  // A target with a frame number field (frames/%05d.ppm) writes one PPM image per frame, a target starting
+  // with '|' runs the rest as a command and pipes raw frames to it, any other target is a file of raw frames
+  bool Open(const std::string &target);
+  bool Write(const Color *pixels, unsigned int width, unsigned int height);
+  // Waits for the command to exit when frames were piped
+  void Close();
+
+  bool IsOpen() const { return m_stream || !m_pattern.empty(); }
+  size_t GetNumberOfFrames() const { return m_frames; }
+
+private:
+  bool WritePpm(const Color *pixels, unsigned int width, unsigned int height);
+
+private:
+  std::FILE *m_stream = nullptr;
+  bool m_pipe = false;
+  // printf format of PPM image paths, taking the frame number
+  std::string m_pattern;
+  size_t m_frames = 0;
+  // One row of RGB pixels, PPM has no alpha
+  std::vector<unsigned char> m_row;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Whole file mapped into memory, either read only or created with a fixed size and writable.
+// Reads and writes go straight to the page cache, without any intermediate buffer.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile() { Close(); }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // Fails on a missing or empty file
+  bool OpenRead(const std::string &path);
+  // Creates the file or truncates an existing one to the given size. The disk space is reserved up front, so a full
+  // disk fails here rather than on a later write through the mapping.
+  bool Create(const std::string &path, size_t size);
+  // Writes the pages of a created file back to the disk and waits for them, false when writeback failed
+  bool Flush();
+  void Close();
+
+  bool IsOpen() const { return m_data != nullptr; }
+  const uint8_t *GetData() const { return m_data; }
+  // Writable only when the file was created
+  uint8_t *GetData() { return m_data; }
+  size_t GetSize() const { return m_size; }
+
+private:
+  uint8_t *m_data = nullptr;
+  size_t m_size = 0;
+#if defined(_WIN32)
+  void *m_file = nullptr;
+  void *m_mapping = nullptr;
+#endif
+};
@@ -0,0 +1,181 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+struct MpscQueueStats
+{
+  uint64_t pushed = 0;
+  uint64_t dropped = 0;
+  uint64_t drained = 0;
+  size_t depth = 0;
+  size_t peakDepth = 0;
+  // Time between push and drain of the items taken by the last drain
+  double lastDrainMaxLatencyUs = 0.0;
+  double averageLatencyUs = 0.0;
+};
+
+// Bounded lock-free multi-producer single-consumer ring (sequence numbered cells, D. Vyukov's scheme).
+// Producers never block: when the ring is full the item is dropped and counted.
+template<typename T>
+class MpscQueue
+{
+public:
+  // Capacity is rounded up to a power of two
+  explicit MpscQueue(size_t capacity);
+  ~MpscQueue() = default;
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  // Safe to call from any thread
+  bool TryPush(const T &item);
+
+  // Consumer thread only, calls fn(item) for every item available at the moment of the call
+  template<typename Fn>
+  size_t Drain(Fn &&fn);
+
+  size_t GetCapacity() const { return m_mask + 1; }
+  MpscQueueStats GetStats() const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    Clock::rep pushTime;
+    T item;
+  };
+
+  static size_t RoundUpToPowerOfTwo(size_t v)
+  {
+    size_t p = 1;
+    while (p < v)
+      p <<= 1;
+    return p;
+  }
+
+private:
+  std::unique_ptr<Cell[]> m_cells;
+  size_t m_mask;
+
+  // Producers and consumer positions live on separate cache lines to avoid false sharing
+  alignas(64) std::atomic<size_t> m_enqueuePos{ 0 };
+  alignas(64) std::atomic<size_t> m_dequeuePos{ 0 };
+
+  alignas(64) std::atomic<uint64_t> m_dropped{ 0 };
+
+  // Written by the consumer only
+  alignas(64) std::atomic<uint64_t> m_drained{ 0 };
+  std::atomic<size_t> m_peakDepth{ 0 };
+  std::atomic<double> m_lastDrainMaxLatencyUs{ 0.0 };
+  std::atomic<double> m_totalLatencyUs{ 0.0 };
+};
+
+template<typename T>
+MpscQueue<T>::MpscQueue(size_t capacity)
+  : m_cells(new Cell[RoundUpToPowerOfTwo(capacity < 2 ? 2 : capacity)]),
+    m_mask(RoundUpToPowerOfTwo(capacity < 2 ? 2 : capacity) - 1)
+{
+  for (size_t i = 0; i <= m_mask; ++i)
+    m_cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template<typename T>
+bool MpscQueue<T>::TryPush(const T &item)
+{
+  size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+  for (;;)
+  {
+    Cell &cell = m_cells[pos & m_mask];
+    const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+    if (diff == 0)
+    {
+      // The cell is free, try to claim it
+      if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        cell.item = item;
+        cell.pushTime = Clock::now().time_since_epoch().count();
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    }
+    else if (diff < 0)
+    {
+      // The ring is full, the consumer hasn't released this cell yet
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    else
+    {
+      pos = m_enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template<typename T>
+template<typename Fn>
+size_t MpscQueue<T>::Drain(Fn &&fn)
+{
+  size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+  const size_t depth = m_enqueuePos.load(std::memory_order_relaxed) - pos;
+  if (depth > m_peakDepth.load(std::memory_order_relaxed))
+    m_peakDepth.store(depth, std::memory_order_relaxed);
+
+  const Clock::rep now = Clock::now().time_since_epoch().count();
+  double maxLatencyUs = 0.0;
+  double totalLatencyUs = 0.0;
+
+  size_t count = 0;
+  for (;;)
+  {
+    Cell &cell = m_cells[pos & m_mask];
+    const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+
+    // Not published yet (or being written right now), it will be taken by the next drain
+    if (sequence != pos + 1)
+      break;
+
+    const double latencyUs =
+      std::chrono::duration<double, std::micro>(Clock::duration(now - cell.pushTime)).count();
+    maxLatencyUs = latencyUs > maxLatencyUs ? latencyUs : maxLatencyUs;
+    totalLatencyUs += latencyUs > 0.0 ? latencyUs : 0.0;
+
+    fn(cell.item);
+
+    cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+    ++pos;
+    ++count;
+  }
+
+  m_dequeuePos.store(pos, std::memory_order_relaxed);
+  m_drained.store(m_drained.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+  m_lastDrainMaxLatencyUs.store(maxLatencyUs, std::memory_order_relaxed);
+  m_totalLatencyUs.store(m_totalLatencyUs.load(std::memory_order_relaxed) + totalLatencyUs, std::memory_order_relaxed);
+
+  return count;
+}
+
+template<typename T>
+MpscQueueStats MpscQueue<T>::GetStats() const
+{
+  MpscQueueStats stats;
+  stats.drained = m_drained.load(std::memory_order_relaxed);
+  stats.dropped = m_dropped.load(std::memory_order_relaxed);
+
+  const size_t enqueuePos = m_enqueuePos.load(std::memory_order_relaxed);
+  const size_t dequeuePos = m_dequeuePos.load(std::memory_order_relaxed);
+  stats.pushed = enqueuePos;
+  stats.depth = enqueuePos >= dequeuePos ? enqueuePos - dequeuePos : 0;
+  stats.peakDepth = m_peakDepth.load(std::memory_order_relaxed);
+
+  stats.lastDrainMaxLatencyUs = m_lastDrainMaxLatencyUs.load(std::memory_order_relaxed);
+  if (stats.drained > 0)
+    stats.averageLatencyUs = m_totalLatencyUs.load(std::memory_order_relaxed) / stats.drained;
+
+  return stats;
+}
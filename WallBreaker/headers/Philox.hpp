@@ -0,0 +1,44 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+// Philox4x32-10 counter based generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// Every output is a keyed bijection of a 128 bit counter, so any element of any stream is computed directly,
+// in any order and on any thread: generating in parallel gives the same numbers as generating serially.
+using PhiloxCounter = std::array<uint32_t, 4>;
+using PhiloxKey = std::array<uint32_t, 2>;
+
+inline PhiloxCounter Philox4x32(PhiloxCounter counter, PhiloxKey key)
+{
+  constexpr uint32_t Multiplier0 = 0xD2511F53;
+  constexpr uint32_t Multiplier1 = 0xCD9E8D57;
+  constexpr uint32_t KeyStep0 = 0x9E3779B9;
+  constexpr uint32_t KeyStep1 = 0xBB67AE85;
+
+  for (int round = 0; round < 10; ++round)
+  {
+    const uint64_t product0 = uint64_t{ Multiplier0 } * counter[0];
+    const uint64_t product1 = uint64_t{ Multiplier1 } * counter[2];
+    counter = { static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+      static_cast<uint32_t>(product1),
+      static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+      static_cast<uint32_t>(product0) };
+    key[0] += KeyStep0;
+    key[1] += KeyStep1;
+  }
+  return counter;
+}
+
+// Maps 32 random bits into [min, max] with a multiply and a shift. The result is the same on every platform,
+// unlike the standard distributions whose algorithms are left to the library.
+inline int32_t UniformInt(uint32_t bits, int32_t min, int32_t max)
+{
+  const auto range = static_cast<uint64_t>(static_cast<int64_t>(max) - min + 1);
+  return static_cast<int32_t>(min + static_cast<int64_t>((bits * range) >> 32));
+}
+
+// Maps the top 24 bits into [min, max), exact in single precision for the unit range
+inline float UniformFloat(uint32_t bits, float min, float max)
+{
+  return min + (max - min) * (static_cast<float>(bits >> 8) * (1.0f / 16777216.0f));
+}
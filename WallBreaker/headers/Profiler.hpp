@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Low overhead instrumentation of the hot paths: scoped timers and counters are recorded into per-thread
+// ring buffers and dumped as a Chrome trace (chrome://tracing, ui.perfetto.dev) and a per-phase CSV summary.
+// Everything compiles out unless the build defines WB_ENABLE_PROFILER, the macros below expand to nothing then.
+namespace Profiler
+{
+#if defined(WB_ENABLE_PROFILER)
+inline constexpr bool Enabled = true;
+#else
+inline constexpr bool Enabled = false;
+#endif
+
+enum class Counter : uint32_t
+{
+  PairsTested,
+  Contacts,
+  WallsDestroyed,
+  BulletsSpawned,
+  ChunksLoaded,
+  Count
+};
+
+const char *GetCounterName(Counter counter);
+
+// Nanoseconds since the first use of the profiler
+uint64_t Now();
+// Names have to outlive the profiler, string literals are expected
+void RecordScope(const char *name, uint64_t begin, uint64_t end);
+void AddCount(Counter counter, uint64_t value);
+// Sum over all threads since the last reset
+uint64_t GetCount(Counter counter);
+// Puts the current counters into the trace, called once per simulation step
+void SampleCounters();
+
+// Reset and dumps read every thread buffer, nothing may be recorded meanwhile
+void Reset();
+bool WriteChromeTrace(const std::string &path);
+bool WriteSummaryCsv(const std::string &path);
+
+class ScopedTimer
+{
+public:
+  explicit ScopedTimer(const char *name) : m_name(name), m_begin(Now()) {}
+  ~ScopedTimer() { RecordScope(m_name, m_begin, Now()); }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+  const char *m_name;
+  uint64_t m_begin;
+};
+}// namespace Profiler
+
+#define WB_PROFILE_CONCAT_IMPL(a, b) a##b
+#define WB_PROFILE_CONCAT(a, b) WB_PROFILE_CONCAT_IMPL(a, b)
+
+#if defined(WB_ENABLE_PROFILER)
+#define WB_PROFILE_SCOPE(name) const Profiler::ScopedTimer WB_PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define WB_PROFILE_COUNT(counter, value) Profiler::AddCount(Profiler::Counter::counter, static_cast<uint64_t>(value))
+#define WB_PROFILE_SAMPLE_COUNTERS() Profiler::SampleCounters()
+#else
+#define WB_PROFILE_SCOPE(name) ((void)0)
+// The value is not evaluated, local tallies kept only for the profiler don't trigger unused warnings
+#define WB_PROFILE_COUNT(counter, value) ((void)sizeof(value))
+#define WB_PROFILE_SAMPLE_COUNTERS() ((void)0)
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+#include "Color.hpp"
+#include "Segment.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Immutable copy of everything a frame needs, published by the simulation thread after every tick.
+// Bullets carry their positions at the start and at the end of the tick, so the render thread can
+// interpolate between the last two ticks without holding on to an older snapshot.
+struct RenderSnapshot
+{
+  uint32_t tick = 0;
+  float fixedDeltaTime = 0.0f;
+  // Moment the snapshot was published, interpolation runs from there over one tick
+  std::chrono::steady_clock::time_point publishTime;
+
+  std::vector<float> previousPositionX;
+  std::vector<float> previousPositionY;
+  std::vector<float> positionX;
+  std::vector<float> positionY;
+  std::vector<float> radius;
+  std::vector<Color> bulletColors;
+
+  // Walls are copied only when they changed since this buffer was filled the last time
+  std::vector<Segment> walls;
+  std::vector<Color> wallColors;
+  uint64_t wallsRevision = UINT64_MAX;
+
+  size_t GetNumberOfBullets() const { return positionX.size(); }
+};
+
+// Longer moves within one tick are wraps around the screen edge, those aren't interpolated
+inline constexpr float WrapSnapDistance = 64.0f;
+
+// One coordinate of a bullet at alpha between its previous and current positions
+inline float InterpolateCoordinate(float previous, float current, float alpha)
+{
+  const float delta = current - previous;
+  return std::abs(delta) < WrapSnapDistance ? previous + delta * alpha : current;
+}
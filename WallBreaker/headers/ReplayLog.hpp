@@ -0,0 +1,120 @@
+#pragma once
+#include "BulletManager.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Binary log of everything that changes the simulation besides stepping it: spawns, walls and toggles.
+// Every event is keyed by the tick it was applied at, so feeding the events back before the same ticks
+// reproduces the recorded run bit exactly, whatever the amount of threads.
+//
+// Layout: "WBRL", uint32 version, ReplayHeader fields, then events. Every event is a type byte,
+// the tick delta from the previous event as a LEB128 varint and a type specific payload.
+inline constexpr char ReplayLogMagic[4] = { 'W', 'B', 'R', 'L' };
+// Version 2 added the bullet radius to spawns, version 3 the sleeping flag and version 4 the wall streaming flag.
+// Version 5 generates walls from counter based streams and lets walls be added to a populated scene, their walls
+// can't be generated again from older logs. Version 6 resolves bullet contacts ordered by bullet pair instead of the
+// order the spatial hash found them in, older logs would diverge from their recording. Only version 6 logs are read,
+// older ones are rejected.
+inline constexpr uint32_t ReplayLogVersion = 6;
+inline constexpr uint32_t ReplayLogMinVersion = 6;
+
+struct ReplayHeader
+{
+  float worldWidth = 0.0f;
+  float worldHeight = 0.0f;
+  float fixedDeltaTime = DefaultFixedDeltaTime;
+  uint32_t substeps = 1;
+  uint8_t processBulletsCollision = 1;
+  uint8_t sleeping = 1;
+  uint8_t wallStreaming = 0;
+};
+
+enum class ReplayEventType : uint8_t
+{
+  Spawn = 1,
+  GenerateWalls = 2,
+  RemoveAllWalls = 3,
+  ToggleBulletsCollision = 4,
+  // Last event of a log, its tick is the amount of recorded ticks
+  End = 5
+};
+
+struct ReplayEvent
+{
+  uint32_t tick = 0;
+  ReplayEventType type = ReplayEventType::End;
+
+  // Spawn
+  SpawnRequest spawn{};
+  // GenerateWalls
+  uint32_t wallsRatio = 0;
+  uint32_t wallsSeed = 0;
+};
+
+// Simulation thread only, events are buffered and written in big blocks
+class ReplayRecorder
+{
+public:
+  ReplayRecorder() = default;
+  ~ReplayRecorder();
+
+  ReplayRecorder(const ReplayRecorder &) = delete;
+  ReplayRecorder &operator=(const ReplayRecorder &) = delete;
+
+  bool Open(const std::string &path, const ReplayHeader &header);
+  bool IsOpen() const { return m_file != nullptr; }
+
+  // Ticks have to be non-decreasing
+  void Record(const ReplayEvent &event);
+  // Writes the end marker, nothing is recorded after the given tick
+  void Close(uint32_t endTick);
+
+private:
+  void Write(const void *data, size_t size);
+  void WriteVarint(uint32_t value);
+  void Flush();
+
+private:
+  std::FILE *m_file = nullptr;
+  std::vector<uint8_t> m_buffer;
+  uint32_t m_lastTick = 0;
+};
+
+class ReplayReader
+{
+public:
+  ReplayReader() = default;
+  ~ReplayReader();
+
+  ReplayReader(const ReplayReader &) = delete;
+  ReplayReader &operator=(const ReplayReader &) = delete;
+
+  // Fails on a missing file, a wrong magic or an unsupported version
+  bool Open(const std::string &path);
+  const ReplayHeader &GetHeader() const { return m_header; }
+
+  // Configures a fresh bullet manager the same way the recorded one was
+  void Configure(BulletManager &bulletManager) const;
+
+  // Applies all events recorded for the current tick of the bullet manager, call it before every Step.
+  // Returns false once the recorded amount of ticks is reached.
+  bool ApplyEvents(BulletManager &bulletManager);
+
+private:
+  bool ReadEvent(ReplayEvent &event);
+  bool Read(void *data, size_t size);
+  bool ReadVarint(uint32_t &value);
+
+private:
+  std::FILE *m_file = nullptr;
+  ReplayHeader m_header;
+  uint32_t m_version = 0;
+  uint32_t m_lastTick = 0;
+
+  // One event look ahead, it belongs to a later tick
+  ReplayEvent m_pending;
+  bool m_hasPending = false;
+};
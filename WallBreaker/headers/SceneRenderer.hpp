@@ -0,0 +1,53 @@
+#pragma once
+#include "Color.hpp"
+#include "RenderSnapshot.hpp"
+#include "SegmentShape.hpp"
+#include "ThreadManager.hpp"
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Size of the shared circle texture used by every bullet quad
+inline constexpr unsigned int BulletTextureSize = 32;
+
+// Batched renderer: all bullets go into one vertex array rebuilt every frame and all walls into one
+// static vertex buffer rebuilt only when walls change, so the scene takes two draw calls whatever its size.
+class SceneRenderer
+{
+public:
+  // Nothing is drawn without a target
+  explicit SceneRenderer(sf::RenderTarget *target = nullptr) : m_target(target) {}
+  ~SceneRenderer() = default;
+
+  // Vertices are filled in parallel when a thread manager is provided
+  void SetThreadManager(ThreadManager *threadManager) { m_threadManager = threadManager; }
+
+  // Bullets are drawn at alpha between their previous and current positions, 1 draws the latest state
+  void DrawBullets(const RenderSnapshot &snapshot, float alpha = 1.0f);
+  // Geometry is rebuilt only when the walls revision differs from the one used for the last build
+  void DrawWalls(const RenderSnapshot &snapshot);
+
+private:
+  // GPU resources are created on the first draw, when the render target is ready for sure
+  void CreateResources();
+  static sf::Color ToSfColor(Color color) { return { color.r, color.g, color.b, color.a }; }
+  void RebuildWalls(const std::vector<Segment> &walls, const std::vector<Color> &colors);
+
+private:
+  sf::RenderTarget *m_target;
+  ThreadManager *m_threadManager = nullptr;
+  bool m_resourcesCreated = false;
+
+  // Every bullet is a textured quad, a white antialiased disc tinted by the vertex color
+  sf::Texture m_bulletTexture;
+  sf::VertexArray m_bulletVertices{ sf::Quads };
+
+  // Static GPU buffer when supported, plain vertex array otherwise
+  bool m_useWallsBuffer = false;
+  sf::VertexBuffer m_wallsBuffer{ sf::Quads, sf::VertexBuffer::Static };
+  sf::VertexArray m_wallsVertices{ sf::Quads };
+  std::vector<sf::Vertex> m_wallsScratch;
+  uint64_t m_wallsRevision = UINT64_MAX;
+};
@@ -0,0 +1,91 @@
+#pragma once
+#include "Segment.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WB_SIMD_SSE2 1
+#endif
+
+// AVX2 kernels live in a separate translation unit built with AVX2 code generation,
+// the build turns them off with WB_DISABLE_AVX2 when the compiler can't produce them
+#if defined(WB_SIMD_SSE2) && !defined(WB_DISABLE_AVX2)
+#define WB_SIMD_AVX2 1
+#endif
+
+// Vectorised kernels of the hot simulation loops with runtime CPU dispatch.
+// Every implementation performs exactly the same IEEE operations in the same order as the scalar one
+// (no FMA, no reciprocal approximations), so results are bit identical whatever instruction set is used.
+namespace Simd
+{
+enum class InstructionSet
+{
+  Scalar,
+  Sse2,
+  Avx2
+};
+
+// Best instruction set supported by both the build and the CPU
+InstructionSet GetBestInstructionSet();
+InstructionSet GetInstructionSet();
+// Forces a lower instruction set (verification, benchmarks), unsupported ones fall back to the best available
+void SetInstructionSet(InstructionSet instructionSet);
+bool IsSupported(InstructionSet instructionSet);
+const char *GetInstructionSetName(InstructionSet instructionSet);
+
+// Lanes processed by a single SegmentsVsCircle call
+inline constexpr uint32_t SegmentsBlockSize = 8;
+
+// Up to 8 segments in structure of arrays layout, lanes past count are ignored
+struct alignas(32) SegmentsBlock
+{
+  float p0x[SegmentsBlockSize];
+  float p0y[SegmentsBlockSize];
+  float p1x[SegmentsBlockSize];
+  float p1y[SegmentsBlockSize];
+  float thickness[SegmentsBlockSize];
+  uint32_t count = 0;
+
+  void Set(uint32_t lane, const Segment &segment)
+  {
+    p0x[lane] = segment.p0.x;
+    p0y[lane] = segment.p0.y;
+    p1x[lane] = segment.p1.x;
+    p1y[lane] = segment.p1.y;
+    thickness[lane] = segment.thickness;
+  }
+};
+
+// position += velocity * dt with wrapping into [0, width) x [0, height), velocities near zero are cleared
+void IntegrateAndWrap(float *posX, float *posY, float *velX, float *velY, size_t count, float deltaTime,
+  float width, float height);
+
+// Tests one circle against all segments of the block in a single pass, bit i is set when lane i is touched
+uint32_t SegmentsVsCircle(const SegmentsBlock &block, float x, float y, float radius);
+
+namespace Scalar
+{
+void IntegrateAndWrap(float *posX, float *posY, float *velX, float *velY, size_t count, float deltaTime,
+  float width, float height);
+uint32_t SegmentsVsCircle(const SegmentsBlock &block, float x, float y, float radius);
+}// namespace Scalar
+
+#if defined(WB_SIMD_SSE2)
+namespace Sse2
+{
+void IntegrateAndWrap(float *posX, float *posY, float *velX, float *velY, size_t count, float deltaTime,
+  float width, float height);
+uint32_t SegmentsVsCircle(const SegmentsBlock &block, float x, float y, float radius);
+}// namespace Sse2
+#endif
+
+#if defined(WB_SIMD_AVX2)
+namespace Avx2
+{
+void IntegrateAndWrap(float *posX, float *posY, float *velX, float *velY, size_t count, float deltaTime,
+  float width, float height);
+uint32_t SegmentsVsCircle(const SegmentsBlock &block, float x, float y, float radius);
+}// namespace Avx2
+#endif
+}// namespace Simd
@@ -0,0 +1,90 @@
+#pragma once
+#include "Color.hpp"
+#include "RenderSnapshot.hpp"
+#include "ThreadManager.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Side of the square screen tiles, in pixels
+inline constexpr unsigned int RasterTileSize = 64;
+
+// CPU rasterizer drawing snapshots into an RGBA framebuffer, for frame capture without any GPU or window.
+// Primitives are first binned into the screen tiles they overlap, then every tile is rasterized by a single task,
+// so tiles run in parallel without sharing pixels. Bins keep the primitives in drawing order, bullets then walls
+// like SceneRenderer, so frames are the same whatever the amount of threads.
+class SoftwareRenderer
+{
+public:
+  SoftwareRenderer(unsigned int width, unsigned int height);
+  ~SoftwareRenderer() = default;
+
+  // Binning and tiles run in parallel when a thread manager is provided
+  void SetThreadManager(ThreadManager *threadManager) { m_threadManager = threadManager; }
+  // World position shown at the top left corner of the frame and pixels per world unit
+  void SetView(glm::vec2 origin, float scale);
+  void SetClearColor(Color color) { m_clearColor = color; }
+
+  // Bullets are drawn at alpha between their previous and current positions, 1 draws the latest state
+  void Render(const RenderSnapshot &snapshot, float alpha = 1.0f);
+
+  unsigned int GetWidth() const { return m_width; }
+  unsigned int GetHeight() const { return m_height; }
+  // Rows from top to bottom, every pixel is 4 bytes in RGBA order
+  const Color *GetPixels() const { return m_pixels.data(); }
+
+private:
+  struct Circle
+  {
+    glm::vec2 center;
+    float radius;
+    Color color;
+  };
+
+  // Corners of the wall quad ordered with a positive signed area, so a pixel is inside when every edge function
+  // is positive
+  struct Quad
+  {
+    glm::vec2 corners[4];
+    glm::vec2 min;
+    glm::vec2 max;
+    Color color;
+  };
+
+  void BuildCircles(const RenderSnapshot &snapshot, float alpha);
+  void BuildQuads(const RenderSnapshot &snapshot);
+  // Inclusive range of tiles overlapped by a primitive, false when it's out of the frame
+  bool GetTileRange(size_t primitive, uint32_t &minX, uint32_t &minY, uint32_t &maxX, uint32_t &maxY) const;
+  void BinPrimitives();
+  void RasterizeTile(uint32_t tile);
+  void DrawCircle(const Circle &circle, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+  void DrawQuad(const Quad &quad, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+
+private:
+  unsigned int m_width;
+  unsigned int m_height;
+  uint32_t m_tilesX;
+  uint32_t m_tilesY;
+  glm::vec2 m_origin{ 0.0f, 0.0f };
+  float m_scale = 1.0f;
+  Color m_clearColor = Colors::Black;
+  ThreadManager *m_threadManager = nullptr;
+
+  std::vector<Color> m_pixels;
+
+  // Screen space primitives of the frame, bullets are indexed first and walls after them
+  std::vector<Circle> m_circles;
+  std::vector<Quad> m_quads;
+  // Walls are transformed again only when they or the view changed
+  uint64_t m_quadsRevision = UINT64_MAX;
+
+  // Binning counts the tiles of every chunk of primitives, then places every chunk after the previous ones in
+  // each tile, so the primitives of a bin stay in order without any sorting
+  size_t m_binChunks = 0;
+  size_t m_binGrain = 0;
+  std::vector<uint32_t> m_chunkTileOffsets;
+  std::vector<uint32_t> m_tileBegin;
+  std::vector<uint32_t> m_binnedPrimitives;
+};
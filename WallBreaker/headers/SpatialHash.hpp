@@ -0,0 +1,133 @@
+#pragma once
+#include "ThreadManager.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Uniform grid broad-phase over a toroidal (wrapped) world.
+// Grid cells are hashed into a bucket table sized by the number of entries, so memory depends on the
+// amount of bodies rather than on the size of the world. It is rebuilt from scratch every simulation step.
+class SpatialHash
+{
+public:
+  SpatialHash() = default;
+  ~SpatialHash() = default;
+
+  // cellSize has to be at least the largest interaction distance (sum of two radii)
+  void Configure(float cellSize, float worldWidth, float worldHeight);
+
+  // Cells are computed in parallel when a thread manager is provided
+  template<typename PositionFn>
+  void Build(size_t count, PositionFn &&getPosition, ThreadManager *threadManager = nullptr);
+
+  // Calls pairFn(i, j) exactly once for every pair of entries located in the same or neighbouring cells,
+  // including neighbours across the world edges. Narrow-phase is left to the caller.
+  template<typename PairFn>
+  void ForEachPair(PairFn &&pairFn) const
+  {
+    ForEachPairInRange(0, static_cast<uint32_t>(m_entryCells.size()), pairFn);
+  }
+
+  // Same as ForEachPair, but only for pairs where the lower entry is in [begin, end).
+  // Disjoint ranges can be processed concurrently.
+  template<typename PairFn>
+  void ForEachPairInRange(uint32_t begin, uint32_t end, PairFn &&pairFn) const;
+
+  // Calls entryFn(i) for every entry located in the cells overlapped by the box, the box wraps across the world edges
+  template<typename EntryFn>
+  void ForEachEntryInBox(glm::vec2 min, glm::vec2 max, EntryFn &&entryFn) const;
+
+  size_t GetNumberOfEntries() const { return m_entryCells.size(); }
+
+private:
+  uint32_t ComputeCell(glm::vec2 position) const;
+  uint32_t BucketOf(uint32_t cell) const { return (cell * 2654435761u) & (m_bucketsCount - 1); }
+
+  // Neighbourhood of a cell (3x3 with wrapping), duplicates are removed for tiny grids
+  uint32_t GatherNeighbourCells(uint32_t cell, uint32_t (&neighbours)[9]) const;
+
+  void Sort();
+
+private:
+  float m_cellWidth = 1.0f;
+  float m_cellHeight = 1.0f;
+  uint32_t m_cellsX = 1;
+  uint32_t m_cellsY = 1;
+
+  uint32_t m_bucketsCount = 1;
+
+  // Per entry cell, indexed by the entry id
+  std::vector<uint32_t> m_entryCells;
+
+  // Entries sorted by bucket (counting sort), m_bucketStart[b]..m_bucketStart[b+1] is a bucket range
+  std::vector<uint32_t> m_bucketStart;
+  std::vector<uint32_t> m_sortedEntries;
+  std::vector<uint32_t> m_sortedCells;
+};
+
+template<typename PositionFn>
+void SpatialHash::Build(size_t count, PositionFn &&getPosition, ThreadManager *threadManager)
+{
+  constexpr size_t cellsGrain = 8192;
+
+  m_entryCells.resize(count);
+  ParallelFor(threadManager, 0, count, cellsGrain, [this, &getPosition](size_t begin, size_t end, size_t) {
+    for (size_t i = begin; i < end; ++i)
+      m_entryCells[i] = ComputeCell(getPosition(i));
+  });
+
+  Sort();
+}
+
+template<typename PairFn>
+void SpatialHash::ForEachPairInRange(uint32_t begin, uint32_t end, PairFn &&pairFn) const
+{
+  uint32_t neighbours[9];
+
+  for (uint32_t i = begin; i < end; ++i)
+  {
+    const uint32_t neighboursCount = GatherNeighbourCells(m_entryCells[i], neighbours);
+    for (uint32_t n = 0; n < neighboursCount; ++n)
+    {
+      const uint32_t cell = neighbours[n];
+      const uint32_t bucket = BucketOf(cell);
+      for (uint32_t k = m_bucketStart[bucket]; k < m_bucketStart[bucket + 1]; ++k)
+      {
+        // Buckets are shared between different cells, and every pair is reported from its lower entry only
+        const uint32_t j = m_sortedEntries[k];
+        if (j > i && m_sortedCells[k] == cell)
+          pairFn(i, j);
+      }
+    }
+  }
+}
+
+template<typename EntryFn>
+void SpatialHash::ForEachEntryInBox(glm::vec2 min, glm::vec2 max, EntryFn &&entryFn) const
+{
+  const auto firstX = static_cast<int64_t>(std::floor(min.x / m_cellWidth));
+  const auto firstY = static_cast<int64_t>(std::floor(min.y / m_cellHeight));
+  // Boxes larger than the world visit every cell once
+  const int64_t spanX = std::min<int64_t>(static_cast<int64_t>(std::floor(max.x / m_cellWidth)) - firstX + 1, m_cellsX);
+  const int64_t spanY = std::min<int64_t>(static_cast<int64_t>(std::floor(max.y / m_cellHeight)) - firstY + 1, m_cellsY);
+
+  for (int64_t dy = 0; dy < spanY; ++dy)
+  {
+    const int64_t y = ((firstY + dy) % m_cellsY + m_cellsY) % m_cellsY;
+    for (int64_t dx = 0; dx < spanX; ++dx)
+    {
+      const int64_t x = ((firstX + dx) % m_cellsX + m_cellsX) % m_cellsX;
+      const auto cell = static_cast<uint32_t>(y * m_cellsX + x);
+      const uint32_t bucket = BucketOf(cell);
+      for (uint32_t k = m_bucketStart[bucket]; k < m_bucketStart[bucket + 1]; ++k)
+      {
+        if (m_sortedCells[k] == cell)
+          entryFn(m_sortedEntries[k]);
+      }
+    }
+  }
+}
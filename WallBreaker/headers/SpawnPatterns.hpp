@@ -0,0 +1,20 @@
+#pragma once
+#include "BulletManager.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Generators of bullet formations for FireBatch. Every generator appends count spawns to out in one pass,
+// speed, lifetime and radius are taken from the prototype, positions and directions are computed.
+namespace SpawnPatterns
+{
+// Bullets evenly spread over a full circle, starting offset away from the centre and heading outwards.
+// The first one heads at startAngle (radians).
+void Radial(std::vector<BulletSpawn> &out, size_t count, glm::vec2 centre, float offset, float startAngle,
+  const BulletSpawn &prototype = {});
+
+// Bullets evenly spread over an arc of spread radians around the heading angle, starting offset away from the origin
+void Cone(std::vector<BulletSpawn> &out, size_t count, glm::vec2 origin, float offset, float angle, float spread,
+  const BulletSpawn &prototype = {});
+}// namespace SpawnPatterns
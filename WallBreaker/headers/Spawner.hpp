@@ -0,0 +1,101 @@
+#pragma once
+#include "BulletManager.hpp"
+#include "ThreadManager.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+enum class EmitterPattern : uint8_t
+{
+  // Anywhere within the area, heading within the spread around the angle
+  Scatter,
+  // From the origin, heading within the spread around the angle
+  Cone,
+  // From the origin, every bullet heads spread radians further than the previous one
+  Spiral,
+};
+
+struct EmitterConfig
+{
+  EmitterPattern pattern = EmitterPattern::Scatter;
+  // Bullets per second
+  double rate = 0.0;
+  // Scatter only
+  glm::vec2 areaMin{};
+  glm::vec2 areaMax{};
+  // Cone and spiral only, bullets start offset away from the origin along their heading
+  glm::vec2 origin{};
+  float offset = 0.0f;
+  // Radians
+  float angle = 0.0f;
+  float spread = 6.2831853f;
+  // Picked uniformly within the ranges
+  float minSpeed = DefaultBulletSpeed;
+  float maxSpeed = DefaultBulletSpeed;
+  float minLifetime = DefaultBulletLifeTime;
+  float maxLifetime = DefaultBulletLifeTime;
+  float radius = DefaultBulletRadius;
+};
+
+// Fires bullets from emitters at exact rates: t seconds after its rate was set an emitter has fired floor(rate * t)
+// bullets, however often it's updated. Every emitter owns a Philox stream keyed by the seed and its index, and bullet
+// n of an emitter is made from element n of the stream. Bullets due at an update are generated in chunks on the thread
+// manager and handed over in a single batch, so they are the same for any amount of threads. Not thread safe, it's
+// driven from the thread which steps the simulation.
+class Spawner
+{
+public:
+  // Returns the index of the new emitter
+  size_t AddEmitter(const EmitterConfig &config);
+  void RemoveAllEmitters() { m_emitters.clear(); }
+  size_t GetNumberOfEmitters() const { return m_emitters.size(); }
+
+  // Bullets fired so far are kept, the new rate counts from the current time
+  void SetRate(size_t emitter, double rate);
+  double GetRate(size_t emitter) const { return m_emitters[emitter].config.rate; }
+  // The emitter fires count more bullets at the next update, on top of its rate
+  void Burst(size_t emitter, uint64_t count) { m_emitters[emitter].burstsPending += count; }
+
+  // Streams of all emitters depend on it, set it before the first update
+  void SetRandomSeed(uint32_t seed) { m_seed = seed; }
+  // Generation runs serially without a thread manager
+  void SetThreadManager(ThreadManager *threadManager) { m_threadManager = threadManager; }
+
+  // Advances the time and fires the bullets due meanwhile with FireBatch, returns their amount
+  size_t Update(double deltaTime, BulletManager &bulletManager);
+  // Advances the time and generates the bullets due meanwhile without firing them, grouped by emitter.
+  // The batch is reused by the next call.
+  const std::vector<BulletSpawn> &Advance(double deltaTime);
+
+  uint64_t GetNumberOfFired() const { return m_fired; }
+
+private:
+  struct Emitter
+  {
+    EmitterConfig config;
+    // Time and amount of bullets fired at the rate when the rate was set
+    double rateTime = 0.0;
+    uint64_t rateBase = 0;
+    uint64_t firedAtRate = 0;
+    uint64_t burstsPending = 0;
+    // Position in the stream, bursts included
+    uint64_t fired = 0;
+  };
+
+  // Bullets [first, first + count) of the emitter's stream
+  void Generate(uint32_t emitter, uint64_t first, size_t count, BulletSpawn *out) const;
+
+private:
+  std::vector<Emitter> m_emitters;
+  double m_time = 0.0;
+  uint32_t m_seed = DefaultRandomSeed;
+  uint64_t m_fired = 0;
+  ThreadManager *m_threadManager = nullptr;
+
+  // Bullets of the current update, grouped by emitter. m_batchBegin[e] is where the ones of emitter e start,
+  // followed by the total amount.
+  std::vector<BulletSpawn> m_batch;
+  std::vector<size_t> m_batchBegin;
+};
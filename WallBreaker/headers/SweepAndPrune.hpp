@@ -0,0 +1,139 @@
+#pragma once
+#include "BroadPhase.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Incremental sweep and prune. Every bullet has a box around its path, the bounds of the boxes are kept sorted along
+// both axes from one substep to the next. Bullets move little between substeps, so insertion sort puts the lists back
+// in order in nearly linear time, and overlapping boxes are cached as pairs: the swaps of the sort add a pair when they
+// make two boxes overlap and drop it when they make them separate. Boxes belong to handle slots, so bullets can be
+// reordered between substeps. New boxes, and the ones of bullets wrapping around the world, are merged into the lists
+// in one pass and find their pairs with a range query along the dominant axis. Boxes close to the world edges query
+// their images on the other side for the pairs across the edges.
+class SweepAndPrune final : public BroadPhase
+{
+public:
+  SweepAndPrune() = default;
+  ~SweepAndPrune() override = default;
+
+  BroadPhaseType GetType() const override { return BroadPhaseType::SweepAndPrune; }
+  void Update(const BroadPhaseInput &input, ThreadManager *threadManager) override;
+  void FindPairs(size_t begin, size_t end, ArenaVector<BulletPair> &pairs) const override;
+  void Reset() override;
+
+  size_t GetNumberOfCachedPairs() const { return m_pairs.Size(); }
+
+private:
+  struct Box
+  {
+    float min[2];
+    float max[2];
+  };
+
+  // Bound of a box along an axis, data is the slot shifted left once with the low bit set for upper bounds.
+  // Lower bounds come first at equal values, so touching boxes overlap. The bounds of the box along the other axis
+  // are kept along, so that most bounds passing each other are told apart without reading the boxes. While the lists
+  // are sorted they cover the previous bounds of the box too.
+  struct Endpoint
+  {
+    float value;
+    uint32_t data;
+    float otherMin;
+    float otherMax;
+
+    bool IsUpper() const { return data & 1; }
+    uint32_t Slot() const { return data >> 1; }
+    bool operator<(const Endpoint &other) const
+    {
+      return value < other.value || (value == other.value && (data & 1) < (other.data & 1));
+    }
+  };
+
+  // Set of slot pairs, open addressing with linear probing
+  class PairSet
+  {
+  public:
+    bool Contains(uint64_t key) const;
+    void Insert(uint64_t key);
+    void Erase(uint64_t key);
+    // Keeps the storage
+    void Clear();
+    size_t Size() const { return m_size; }
+
+    template<typename Fn>
+    void ForEach(Fn &&fn) const
+    {
+      for (const uint64_t key : m_keys)
+      {
+        if (key != EmptyKey)
+          fn(key);
+      }
+    }
+
+  private:
+    static constexpr uint64_t EmptyKey = UINT64_MAX;
+
+    size_t Home(uint64_t key) const { return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> m_shift); }
+    void Grow();
+
+  private:
+    std::vector<uint64_t> m_keys;
+    size_t m_size = 0;
+    uint32_t m_shift = 64;
+  };
+
+  static uint64_t PairKey(uint32_t p, uint32_t q)
+  {
+    return p < q ? (uint64_t{ p } << 32) | q : (uint64_t{ q } << 32) | p;
+  }
+  static bool Overlap(const Box &a, const Box &b)
+  {
+    return a.min[0] <= b.max[0] && b.min[0] <= a.max[0] && a.min[1] <= b.max[1] && b.min[1] <= a.max[1];
+  }
+  static bool OverlapOnOtherAxis(const Endpoint &a, const Endpoint &b)
+  {
+    return a.otherMin <= b.otherMax && b.otherMin <= a.otherMax;
+  }
+
+  // Drops the boxes of bullets which are gone or wrapped around the world, with their pairs
+  void RemoveBoxes();
+  void SortAxis(int axis);
+  void InsertBoxes();
+  // Calls slotFn for every box in the lists overlapping the given one
+  template<typename SlotFn>
+  void QueryBox(const Box &box, SlotFn &&slotFn) const;
+  void FindPairsAcrossEdges();
+  void BuildPairLists();
+
+private:
+  BroadPhaseInput m_input{};
+  // Bumped every update, boxes not seen by the current update belong to bullets which are gone
+  uint32_t m_stamp = 0;
+
+  // Indexed by slot, a slot without a box was last seen at stamp zero
+  std::vector<Box> m_boxes;
+  // New boxes until the removed ones are dropped
+  std::vector<Box> m_nextBoxes;
+  std::vector<uint32_t> m_lastSeen;
+  std::vector<uint32_t> m_bulletIndices;
+  // Slots whose box is taken out of the lists and inserted again
+  std::vector<uint8_t> m_reinserted;
+
+  std::vector<Endpoint> m_endpoints[2];
+  std::vector<Endpoint> m_insertedEndpoints;
+  std::vector<Endpoint> m_mergeScratch;
+  std::vector<uint32_t> m_removedSlots;
+  std::vector<uint32_t> m_insertedSlots;
+  // Queries run along the axis the boxes are the most spread on, bounded by the largest box
+  int m_queryAxis = 0;
+  float m_maxExtent[2] = {};
+
+  PairSet m_pairs;
+  // Pairs overlapping across the world edges only, found again every update
+  std::vector<uint64_t> m_edgePairs;
+
+  // Higher partners of every awake bullet, m_pairsBegin[i]..m_pairsBegin[i + 1] in m_partners
+  std::vector<uint32_t> m_pairsBegin;
+  std::vector<uint32_t> m_partners;
+};
@@ -1,15 +1,174 @@
 #pragma once
+#include <algorithm>
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
 
+// Persistent pool of worker threads with a work-stealing scheduler.
+// Every worker owns a task deque: it pops its own tasks from the back and steals from the front of others.
+// Tasks submitted from threads outside of the pool go to a shared injection queue.
 class ThreadManager
 {
 public:
-  ThreadManager() = default;
-  ~ThreadManager() = default;
+  using Task = std::function<void()>;
+
+  explicit ThreadManager(size_t workersCount = DefaultWorkersCount());
+  ~ThreadManager();
+
+  ThreadManager(const ThreadManager &) = delete;
+  ThreadManager &operator=(const ThreadManager &) = delete;
+
+  static size_t DefaultWorkersCount();
+
+  // Threads taking part in parallel work: all workers plus the calling thread
+  size_t GetNumberOfThreads() const { return m_threads.size() + 1; }
+  size_t GetNumberOfWorkers() const { return m_threads.size(); }
+
+  // 0 for threads outside of the pool, 1..N for workers
+  static size_t GetThreadIndex();
+
+  void Submit(Task task);
+
+  // Runs fn(chunkBegin, chunkEnd, chunkIndex) for every grain sized chunk of [begin, end) and waits for all of them.
+  // Chunking doesn't depend on the number of threads, so per chunk results can be merged in a deterministic order.
+  template<typename Fn>
+  void ParallelFor(size_t begin, size_t end, size_t grain, Fn &&fn);
+
+  // Helps executing queued tasks until the counter drops to zero
+  void WaitFor(const std::atomic<size_t> &counter);
+
+private:
+  struct WorkQueue
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void WorkerLoop(size_t index);
+  bool TryPopTask(size_t queueIndex, Task &task);
+  bool TryStealTask(size_t queueIndex, Task &task);
+  bool TryGetTask(size_t thiefIndex, Task &task);
+  bool TryRunOneTask();
 
 private:
   std::vector<std::thread> m_threads;
   std::atomic_bool m_threadsRunning;
+
+  // Queue 0 is the injection queue, queue i belongs to worker i
+  std::vector<std::unique_ptr<WorkQueue>> m_queues;
+  std::atomic<size_t> m_queuedTasks{ 0 };
+
+  std::mutex m_sleepMutex;
+  std::condition_variable m_wakeCondition;
+};
+
+// Dependency graph of tasks, every task starts when all of its predecessors are finished
+class TaskGraph
+{
+public:
+  using TaskId = size_t;
+
+  TaskId Add(ThreadManager::Task task);
+  // 'before' has to finish before 'after' starts
+  void Precede(TaskId before, TaskId after);
+
+  // Blocks until the whole graph is executed, runs serially without a thread manager
+  void Run(ThreadManager *threadManager);
+
+private:
+  struct Node
+  {
+    ThreadManager::Task task;
+    std::vector<TaskId> successors;
+    size_t predecessorsCount = 0;
+  };
+
+  void RunNode(ThreadManager *threadManager, TaskId id);
+
+private:
+  std::vector<Node> m_nodes;
+  std::unique_ptr<std::atomic<size_t>[]> m_pendingPredecessors;
+  std::atomic<size_t> m_remainingTasks{ 0 };
 };
+
+template<typename Fn>
+void ThreadManager::ParallelFor(size_t begin, size_t end, size_t grain, Fn &&fn)
+{
+  if (end <= begin)
+    return;
+
+  grain = grain == 0 ? 1 : grain;
+  const size_t chunksCount = (end - begin + grain - 1) / grain;
+
+  // Lives on this stack frame, helper tasks only hold a pointer to it, so submitting them doesn't allocate.
+  // Helpers could start after all chunks are already taken, all of them are waited for before returning.
+  struct Job
+  {
+    std::atomic<size_t> nextChunk{ 0 };
+    std::atomic<size_t> remainingChunks{ 0 };
+    std::atomic<size_t> activeHelpers{ 0 };
+    size_t begin;
+    size_t end;
+    size_t grain;
+    size_t chunksCount;
+    std::remove_reference_t<Fn> *fn;
+
+    void RunChunks()
+    {
+      for (;;)
+      {
+        const size_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= chunksCount)
+          break;
+
+        const size_t chunkBegin = begin + chunk * grain;
+        const size_t chunkEnd = chunkBegin + grain < end ? chunkBegin + grain : end;
+        (*fn)(chunkBegin, chunkEnd, chunk);
+        remainingChunks.fetch_sub(1, std::memory_order_acq_rel);
+      }
+    }
+  };
+
+  Job job;
+  job.remainingChunks = chunksCount;
+  job.begin = begin;
+  job.end = end;
+  job.grain = grain;
+  job.chunksCount = chunksCount;
+  job.fn = &fn;
+
+  const size_t helpersCount = std::min(GetNumberOfWorkers(), chunksCount - 1);
+  job.activeHelpers = helpersCount;
+  for (size_t i = 0; i < helpersCount; ++i)
+  {
+    Submit([&job]() {
+      job.RunChunks();
+      job.activeHelpers.fetch_sub(1, std::memory_order_acq_rel);
+    });
+  }
+
+  job.RunChunks();
+  WaitFor(job.remainingChunks);
+  WaitFor(job.activeHelpers);
+}
+
+// Runs on the thread manager when one is provided, otherwise serially with the same chunking
+template<typename Fn>
+void ParallelFor(ThreadManager *threadManager, size_t begin, size_t end, size_t grain, Fn &&fn)
+{
+  if (threadManager)
+  {
+    threadManager->ParallelFor(begin, end, grain, std::forward<Fn>(fn));
+    return;
+  }
+
+  grain = grain == 0 ? 1 : grain;
+  for (size_t chunkBegin = begin, chunk = 0; chunkBegin < end; chunkBegin += grain, ++chunk)
+    fn(chunkBegin, chunkBegin + grain < end ? chunkBegin + grain : end, chunk);
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timing wheel keyed on simulation ticks. The near level holds one slot per tick for the next
+// 256 ticks, the far level one slot per 256 ticks for the next 65536, later items wait in an overflow list.
+// Far slots are cascaded into the near level when their block of ticks begins, so advancing by one tick
+// touches only the items due at that tick. Items due at the same tick fire in a deterministic order.
+template<typename T>
+class TimingWheel
+{
+public:
+  struct Entry
+  {
+    T item;
+    uint32_t tick;
+  };
+
+  // Buckets are the near slots, the far slots and the overflow list, in this order. Restoring every bucket
+  // with the same entries keeps the order in which items due at the same tick fire.
+  static constexpr size_t BucketsCount = 2 * 256 + 1;
+
+  explicit TimingWheel(uint32_t startTick = 0) : m_nextTick{ startTick } {}
+
+  // Items already overdue fire on the next advance
+  void Schedule(const T &item, uint32_t tick)
+  {
+    if (tick < m_nextTick)
+      tick = m_nextTick;
+
+    const uint32_t delta = tick - m_nextTick;
+    if (delta < SlotsCount)
+      m_near[tick & SlotMask].push_back({ item, tick });
+    else if (delta < SlotsCount * SlotsCount)
+      m_far[(tick >> SlotBits) & SlotMask].push_back({ item, tick });
+    else
+      m_overflow.push_back({ item, tick });
+    ++m_size;
+  }
+
+  // Calls fn(item) for every item due up to and including tick. Ticks are processed one by one,
+  // fn must not schedule new items.
+  template<typename Fn>
+  void Advance(uint32_t tick, Fn &&fn)
+  {
+    while (m_nextTick <= tick)
+    {
+      if ((m_nextTick & SlotMask) == 0)
+        Cascade();
+
+      std::vector<Entry> &slot = m_near[m_nextTick & SlotMask];
+      for (const Entry &entry : slot)
+        fn(entry.item);
+      m_size -= slot.size();
+      slot.clear();
+
+      ++m_nextTick;
+    }
+  }
+
+  // Storage of every slot is kept
+  void Clear(uint32_t startTick = 0)
+  {
+    for (std::vector<Entry> &slot : m_near)
+      slot.clear();
+    for (std::vector<Entry> &slot : m_far)
+      slot.clear();
+    m_overflow.clear();
+    m_size = 0;
+    m_nextTick = startTick;
+  }
+
+  size_t Size() const { return m_size; }
+  bool Empty() const { return m_size == 0; }
+  uint32_t GetNextTick() const { return m_nextTick; }
+
+  const std::vector<Entry> &GetBucket(size_t i) const
+  {
+    if (i < SlotsCount)
+      return m_near[i];
+    if (i < 2 * SlotsCount)
+      return m_far[i - SlotsCount];
+    return m_overflow;
+  }
+
+  // Replaces the whole content with buckets taken from GetBucket, entries of all buckets follow each other
+  void Restore(uint32_t nextTick, const uint32_t *bucketSizes, const Entry *entries)
+  {
+    Clear(nextTick);
+    for (size_t i = 0; i < BucketsCount; ++i)
+    {
+      std::vector<Entry> &bucket = i < SlotsCount ? m_near[i] : (i < 2 * SlotsCount ? m_far[i - SlotsCount] : m_overflow);
+      bucket.assign(entries, entries + bucketSizes[i]);
+      entries += bucketSizes[i];
+      m_size += bucketSizes[i];
+    }
+  }
+
+private:
+  static constexpr uint32_t SlotBits = 8;
+  static constexpr uint32_t SlotsCount = 1u << SlotBits;
+  static constexpr uint32_t SlotMask = SlotsCount - 1;
+  static_assert(BucketsCount == 2 * SlotsCount + 1);
+
+  // Called at the first tick of every block of 256 ticks
+  void Cascade()
+  {
+    // The far level wrapped, overflow items may fit into it now
+    if ((m_nextTick & (SlotsCount * SlotsCount - 1)) == 0 && !m_overflow.empty())
+    {
+      m_rescheduled.swap(m_overflow);
+      m_size -= m_rescheduled.size();
+      for (const Entry &entry : m_rescheduled)
+        Schedule(entry.item, entry.tick);
+      m_rescheduled.clear();
+    }
+
+    std::vector<Entry> &far = m_far[(m_nextTick >> SlotBits) & SlotMask];
+    for (const Entry &entry : far)
+      m_near[entry.tick & SlotMask].push_back(entry);
+    far.clear();
+  }
+
+private:
+  std::array<std::vector<Entry>, SlotsCount> m_near;
+  std::array<std::vector<Entry>, SlotsCount> m_far;
+  std::vector<Entry> m_overflow;
+  std::vector<Entry> m_rescheduled;
+  size_t m_size = 0;
+  uint32_t m_nextTick;
+};
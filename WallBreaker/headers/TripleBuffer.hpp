@@ -0,0 +1,51 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer single consumer exchange of the latest value.
+// The writer fills its own buffer and publishes it, the reader takes the most recently published one.
+// Neither side ever waits for the other, intermediate values are skipped when the reader is slower.
+template<typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer() = default;
+
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+  // Writer only, the buffer keeps whatever was written into it three publications ago
+  T &GetWriteBuffer() { return m_buffers[m_writeIndex]; }
+
+  // Writer only, hands the write buffer over to the reader and takes a free one
+  void Publish()
+  {
+    const uint32_t previous = m_middle.exchange(m_writeIndex | FreshFlag, std::memory_order_acq_rel);
+    m_writeIndex = previous & IndexMask;
+  }
+
+  // Reader only, switches to the latest published buffer, false if nothing new was published
+  bool Acquire()
+  {
+    if ((m_middle.load(std::memory_order_relaxed) & FreshFlag) == 0)
+      return false;
+
+    const uint32_t previous = m_middle.exchange(m_readIndex, std::memory_order_acq_rel);
+    m_readIndex = previous & IndexMask;
+    return true;
+  }
+
+  // Reader only, stays valid and unchanged until the next Acquire
+  const T &GetReadBuffer() const { return m_buffers[m_readIndex]; }
+
+private:
+  static constexpr uint32_t IndexMask = 3;
+  static constexpr uint32_t FreshFlag = 4;
+
+  std::array<T, 3> m_buffers;
+  // Every index is owned by exactly one side, the middle one is in flight between them
+  uint32_t m_writeIndex = 0;
+  alignas(64) std::atomic<uint32_t> m_middle{ 1 };
+  alignas(64) uint32_t m_readIndex = 2;
+};
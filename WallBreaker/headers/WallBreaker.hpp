@@ -2,19 +2,55 @@
 #include <SFML/Graphics.hpp>
 #include <glm/glm.hpp>
 
-#include "Segment.hpp"
 #include "BulletManager.hpp"
+#include "MpscQueue.hpp"
+#include "RenderSnapshot.hpp"
+#include "ReplayLog.hpp"
+#include "SceneRenderer.hpp"
+#include "Spawner.hpp"
+#include "ThreadManager.hpp"
+#include "TripleBuffer.hpp"
 
 #include <string>
 #include <map>
 #include <thread>
+#include <atomic>
 
 // settings
 inline constexpr uint16_t DefaultWindowWidth = 1920;
 inline constexpr uint16_t DefaultWindowHeight = 1080;
 inline constexpr auto DefaultTitle = "WallBreaker";
+// Longer stalls aren't caught up with, so the simulation doesn't spiral trying to catch up
+inline constexpr float MaxFrameTime = 0.25f;
+inline constexpr size_t DefaultCommandQueueCapacity = 64;
+inline constexpr auto DefaultCheckpointPath = "wallbreaker.wbcp";
+// Bullets per second of the continuous fire, the keys scale it tenfold within the limits
+inline constexpr double DefaultFireRate = 250.0;
+inline constexpr double MinFireRate = 100.0;
+inline constexpr double MaxFireRate = 1000000.0;
+// The window thread builds vertices on a pool of its own with this share of the workers, the simulation keeps the rest
+inline constexpr size_t RenderWorkersDivisor = 4;
 
-constexpr uint16_t DefaultBulletSpeed = 100;
+// Input turned into simulation changes, applied by the simulation thread before its next tick
+enum class SimulationCommandType : uint8_t
+{
+  ToggleBulletsCollision,
+  GenerateWalls,
+  RemoveAllWalls,
+  SaveCheckpoint,
+  LoadCheckpoint,
+  // Stops the continuous fire
+  FireBurst,
+  IncreaseFireRate,
+  DecreaseFireRate
+};
+
+struct SimulationCommand
+{
+  SimulationCommandType type;
+  unsigned int wallsRatio = 0;
+  uint32_t bulletsCount = 0;
+};
 
 class WallBreaker
 {
@@ -23,6 +59,13 @@ public:
     uint16_t width = DefaultWindowWidth, uint16_t height = DefaultWindowHeight, std::string title = DefaultTitle);
   ~WallBreaker() = default;
 
+  // All of them have to be set before Run
+  void SetRandomSeed(uint32_t seed);
+  bool StartRecording(const std::string &path);
+  // The scene starts from the checkpoint instead of the initial walls, it's saved back to the same file.
+  // Replays start from an empty scene, so a resumed session can't be recorded.
+  bool ResumeFromCheckpoint(const std::string &path);
+
   void Run();
   inline bool IsRunning() const;
 
@@ -30,21 +73,43 @@ public:
   uint16_t GetHeight() const { return m_height; }
 
 private:
-  void Update(float time);
   void ProcessInput();
+  void Draw(const RenderSnapshot &snapshot, float alpha);
+  void StopRecording();
+
+  // Simulation thread: applies commands, steps at the fixed rate and publishes a snapshot after every tick
+  void SimulationLoop();
+  void ApplyCommands();
+  void PushCommand(SimulationCommandType type, unsigned int wallsRatio = 0);
+  void PushCommand(const SimulationCommand &command);
 
 private:
-  std::vector<std::thread> m_workThreads;
-  std::atomic_bool m_workThreadsRunning;
+  // Owned by the simulation thread while it runs, the render thread sees only the snapshots
   BulletManager m_bulletManager;
+  Spawner m_spawner;
+  size_t m_streamEmitter = 0;
+  size_t m_burstEmitter = 0;
+
+  std::thread m_simulationThread;
+  std::atomic_bool m_simulationRunning{ false };
+  MpscQueue<SimulationCommand> m_commands{ DefaultCommandQueueCapacity };
+  TripleBuffer<RenderSnapshot> m_snapshots;
 
-  // TODO: Renderer should be separated into another context with some interface
   sf::RenderWindow m_window;
+  SceneRenderer m_renderer;
   sf::View m_view;
   sf::Clock m_clock;
+  ReplayRecorder m_recorder;
 
   // Preferences
   std::string m_windowTitle;
   uint16_t m_width;
   uint16_t m_height;
+  std::string m_checkpointPath = DefaultCheckpointPath;
+  bool m_resumed = false;
+
+  // Declared last, so all queued work is finished before anything it uses is destroyed.
+  // Waits help running any task of their pool, so the window thread never waits on a pool running simulation tasks.
+  ThreadManager m_threadManager;
+  ThreadManager m_renderThreadManager;
 };
@@ -0,0 +1,96 @@
+#pragma once
+#include "Segment.hpp"
+#include "ThreadManager.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+inline constexpr float DefaultWallIndexCellSize = 32.0f;
+
+// Static binned grid for walls. Every wall is registered in all cells overlapped by its AABB
+// fattened by the wall thickness. Walls don't move, so the index is built once when walls are created
+// and only patched when walls are destroyed. Cells are grouped into square blocks allocated on first use
+// and released once empty, and blocks are found by hash, so memory follows the area covered by walls rather than
+// the size of the world.
+class WallIndex
+{
+public:
+  WallIndex() = default;
+  ~WallIndex() = default;
+
+  void Configure(float cellSize, float worldWidth, float worldHeight);
+  void Clear();
+
+  // Registers count walls under the ids firstId, firstId + 1... Cells get their walls in id order, as if they were
+  // inserted one by one, but ranges are computed and blocks are filled in parallel
+  void Insert(uint32_t firstId, const Segment *walls, size_t count, ThreadManager *threadManager = nullptr);
+  void Remove(uint32_t id);
+  // Used when a wall is moved to another slot of the walls array
+  void Rename(uint32_t oldId, uint32_t newId);
+
+  // Appends ids of walls whose cells overlap the circle AABB, every wall is reported once
+  void Query(glm::vec2 center, float radius, std::vector<uint32_t> &result) const;
+
+private:
+  struct CellRange
+  {
+    uint32_t minX;
+    uint32_t minY;
+    uint32_t maxX;
+    uint32_t maxY;
+  };
+
+  static constexpr uint32_t BlockBits = 5;
+  static constexpr uint32_t BlockSize = 1u << BlockBits;
+  static constexpr uint32_t BlockMask = BlockSize - 1;
+
+  struct Block
+  {
+    std::array<std::vector<uint32_t>, BlockSize * BlockSize> cells;
+    // Registrations in all cells of the block
+    size_t entries = 0;
+  };
+
+  CellRange ComputeRange(glm::vec2 min, glm::vec2 max) const;
+  CellRange ComputeWallRange(const Segment &wall) const;
+  uint64_t BlockKeyOf(uint32_t blockX, uint32_t blockY) const { return uint64_t{ blockY } * m_blocksX + blockX; }
+  static uint32_t CellIndexOf(uint32_t x, uint32_t y) { return (y & BlockMask) * BlockSize + (x & BlockMask); }
+  Block *FindBlock(uint64_t key) const;
+  // Calls fn(block, x, y) for every cell of the range within an allocated block, one block after another
+  template<typename Fn>
+  void ForEachCell(const CellRange &range, Fn &&fn) const;
+
+private:
+  float m_cellSize = DefaultWallIndexCellSize;
+  uint32_t m_cellsX = 1;
+  uint32_t m_cellsY = 1;
+  uint32_t m_blocksX = 1;
+  uint32_t m_blocksY = 1;
+
+  // Blocks holding walls by key, missing blocks have no walls
+  std::unordered_map<uint64_t, std::unique_ptr<Block>> m_blocks;
+  // Cell range of every registered wall, indexed by wall id
+  std::vector<CellRange> m_wallRanges;
+
+  // Insertion scratch: pairs of a block and a wall, those of every parallel chunk start at m_chunkPairsBegin[chunk].
+  // Once sorted by block, every run of one block is filled from m_fillRuns[run].first.
+  struct BlockPair
+  {
+    uint64_t key;
+    uint32_t id;
+  };
+  struct FillRun
+  {
+    size_t first;
+    Block *block;
+  };
+  std::vector<size_t> m_chunkPairsBegin;
+  std::vector<BlockPair> m_blockPairs;
+  std::vector<BlockPair> m_sortedPairs;
+  std::vector<FillRun> m_fillRuns;
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+inline constexpr float DefaultChunkSize = 1024.0f;
+// Chunks stay loaded for this many ticks after the last awake bullet left their neighbourhood,
+// so bullets moving along a chunk border don't load and unload it over and over
+inline constexpr uint32_t DefaultChunkKeepTicks = 60;
+inline constexpr uint32_t InvalidChunk = UINT32_MAX;
+
+// Square chunks tiling the world, the last row and column are cut by the world edges. Tracks which chunks are
+// in use: a chunk is touched together with its 8 neighbours whenever an awake bullet is inside it, and stays
+// loaded until it wasn't touched for a while. Generated content destroyed in a chunk is remembered, so the
+// chunk is loaded back the way it was left.
+class WorldChunks
+{
+public:
+  WorldChunks() = default;
+  ~WorldChunks() = default;
+
+  // Forgets every chunk state
+  void Configure(float chunkSize, float worldWidth, float worldHeight);
+  void Clear();
+
+  uint32_t GetNumberOfChunks() const { return m_chunksX * m_chunksY; }
+  // Positions outside of the world wrap around like bullets do
+  uint32_t ChunkAt(glm::vec2 position) const;
+  void GetBounds(uint32_t chunk, glm::vec2 &min, glm::vec2 &max) const;
+
+  // Touches the chunk and its neighbours at the tick, those which weren't loaded are loaded and appended to loaded.
+  // Cheap to call again for a chunk already touched at the same tick.
+  void Touch(uint32_t chunk, uint32_t tick, std::vector<uint32_t> &loaded);
+  // Unloads chunks not touched for more than keepTicks and appends them to unloaded, in the order they were loaded
+  void UnloadIdle(uint32_t tick, uint32_t keepTicks, std::vector<uint32_t> &unloaded);
+  bool IsLoaded(uint32_t chunk) const { return m_touchTicks[chunk] != 0; }
+  // In the order they were loaded
+  const std::vector<uint32_t> &GetLoadedChunks() const { return m_loadedChunks; }
+
+  // Index is the position of the item in the generated content of the chunk
+  void MarkDestroyed(uint32_t chunk, uint32_t index);
+  bool IsDestroyed(uint32_t chunk, uint32_t index) const;
+  // Calls fn(chunk, index) for every destroyed item, chunks in ascending order
+  template<typename Fn>
+  void ForEachDestroyed(Fn &&fn) const;
+
+  // Checkpoints, tick of the last touch plus one for every chunk, zero for unloaded ones
+  const std::vector<uint32_t> &GetTouchTicks() const { return m_touchTicks; }
+  // The configuration has to be the same as the saved one
+  void Restore(const uint32_t *touchTicks, const uint32_t *loadedChunks, size_t loadedCount);
+
+private:
+  float m_chunkSize = DefaultChunkSize;
+  float m_worldWidth = 0.0f;
+  float m_worldHeight = 0.0f;
+  uint32_t m_chunksX = 0;
+  uint32_t m_chunksY = 0;
+
+  // Both store the tick plus one, so zero means never
+  std::vector<uint32_t> m_touchTicks;
+  // Chunks whose own bullets touched the neighbourhood at that tick already
+  std::vector<uint32_t> m_centreTicks;
+  std::vector<uint32_t> m_loadedChunks;
+  // Only chunks with destroyed content have an entry, one bit per generated item
+  std::unordered_map<uint32_t, std::vector<uint64_t>> m_destroyed;
+};
+
+template<typename Fn>
+void WorldChunks::ForEachDestroyed(Fn &&fn) const
+{
+  // Hash map order isn't deterministic, chunks are sorted first
+  std::vector<uint32_t> chunks;
+  chunks.reserve(m_destroyed.size());
+  for (const auto &entry : m_destroyed)
+    chunks.push_back(entry.first);
+  std::sort(chunks.begin(), chunks.end());
+
+  for (const uint32_t chunk : chunks)
+  {
+    const std::vector<uint64_t> &bits = m_destroyed.at(chunk);
+    for (size_t word = 0; word < bits.size(); ++word)
+    {
+      for (uint64_t mask = bits[word]; mask != 0; mask &= mask - 1)
+      {
+        uint32_t bit = 0;
+        while (((mask >> bit) & 1) == 0)
+          ++bit;
+        fn(chunk, static_cast<uint32_t>(word * 64 + bit));
+      }
+    }
+  }
+}
@@ -0,0 +1,204 @@
+#include "BroadPhase.hpp"
+#include "SpatialHash.hpp"
+#include "SweepAndPrune.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+// Fastest bullets don't define the cell size, they search around their paths on their own
+constexpr float FastBulletsFraction = 0.1f;
+
+glm::vec2 WrapPosition(glm::vec2 position, float width, float height)
+{
+  // Paths are never longer than the world, so a single correction is enough
+  if (position.x < 0)
+    position.x += width;
+  if (position.x >= width)
+    position.x -= width;
+  if (position.y < 0)
+    position.y += height;
+  if (position.y >= height)
+    position.y -= height;
+  return position;
+}
+
+// While most bullets don't need a sweep, they are hashed by the end of their paths into cells of two radii, like
+// resting bullets would be. Otherwise they are hashed by the middle of their paths, two of them can meet only if the
+// middles are closer than both radii plus both half paths, and a few fast bullets would blow the cells up for
+// everybody, so they aren't taken into account for the cell size. Bullets the cells aren't sized for search the cells
+// around their paths instead. Rebuilt from scratch every substep.
+class SpatialHashBroadPhase final : public BroadPhase
+{
+public:
+  BroadPhaseType GetType() const override { return BroadPhaseType::SpatialHash; }
+
+  void Update(const BroadPhaseInput &input, ThreadManager *threadManager) override
+  {
+    m_input = input;
+
+    size_t sweptCount = 0;
+    for (size_t i = 0; i < input.awakeCount; ++i)
+      sweptCount += NeedsSweep(input.bodies[i]) ? 1 : 0;
+    m_hashEnds = sweptCount <= input.awakeCount * FastBulletsFraction;
+    if (m_hashEnds)
+    {
+      m_hash.Configure(2.0f * input.maxRadius + BroadPhaseMargin, input.worldWidth, input.worldHeight);
+      m_hash.Build(input.count, [this](size_t i) { return EndOfPath(i); }, threadManager);
+      return;
+    }
+
+    m_fastTravel = input.maxTravel;
+    if (input.awakeCount > 0)
+    {
+      m_travelScratch.resize(input.awakeCount);
+      for (size_t i = 0; i < input.awakeCount; ++i)
+        m_travelScratch[i] = input.bodies[i].travel;
+      const size_t slowCount = static_cast<size_t>((input.awakeCount - 1) * (1.0f - FastBulletsFraction));
+      std::nth_element(m_travelScratch.begin(), m_travelScratch.begin() + slowCount, m_travelScratch.end());
+      m_fastTravel = m_travelScratch[slowCount];
+    }
+
+    m_hash.Configure(2.0f * input.maxRadius + m_fastTravel, input.worldWidth, input.worldHeight);
+    m_hash.Build(input.count, [this](size_t i) { return MiddleOfPath(i); }, threadManager);
+  }
+
+  void FindPairs(size_t begin, size_t end, ArenaVector<BulletPair> &pairs) const override
+  {
+    const SweptBody *bodies = m_input.bodies;
+    const auto first = static_cast<uint32_t>(begin);
+    const auto last = static_cast<uint32_t>(end);
+    m_hash.ForEachPairInRange(first, last, [&](uint32_t i, uint32_t j) {
+      if (!IsSearchingAround(i) && !IsSearchingAround(j))
+        pairs.PushBack({ i, j });
+    });
+
+    // Pairs with fast bullets, two fast ones are reported from the lower one only. Ends are half a path further
+    // from the middles than the middles of the other bullets.
+    const float otherTravel = m_hashEnds ? m_input.maxTravel : 0.5f * m_input.maxTravel;
+    for (uint32_t i = first; i < last; ++i)
+    {
+      if (!IsSearchingAround(i))
+        continue;
+
+      const glm::vec2 middle = MiddleOfPath(i);
+      const float extent = bodies[i].radius + m_input.maxRadius + 0.5f * bodies[i].travel + otherTravel;
+      const glm::vec2 box(extent, extent);
+      m_hash.ForEachEntryInBox(middle - box, middle + box, [&](uint32_t k) {
+        if (k == i || (IsSearchingAround(k) && k < i))
+          return;
+        pairs.PushBack({ std::min(i, k), std::max(i, k) });
+      });
+    }
+  }
+
+private:
+  bool IsSearchingAround(size_t i) const
+  {
+    const SweptBody &body = m_input.bodies[i];
+    return m_hashEnds ? NeedsSweep(body) : body.travel > m_fastTravel;
+  }
+
+  glm::vec2 MiddleOfPath(size_t i) const
+  {
+    const SweptBody &body = m_input.bodies[i];
+    return WrapPosition(body.from + body.motion * 0.5f, m_input.worldWidth, m_input.worldHeight);
+  }
+
+  glm::vec2 EndOfPath(size_t i) const
+  {
+    const SweptBody &body = m_input.bodies[i];
+    return WrapPosition(body.from + body.motion, m_input.worldWidth, m_input.worldHeight);
+  }
+
+private:
+  BroadPhaseInput m_input{};
+  bool m_hashEnds = false;
+  float m_fastTravel = 0.0f;
+  SpatialHash m_hash;
+  std::vector<float> m_travelScratch;
+};
+
+// Every awake bullet against every bullet after it, with a box test around the middles of both paths.
+// Quadratic, it's the reference the other broad phases are measured against.
+class BruteForceBroadPhase final : public BroadPhase
+{
+public:
+  BroadPhaseType GetType() const override { return BroadPhaseType::BruteForce; }
+
+  void Update(const BroadPhaseInput &input, ThreadManager *) override
+  {
+    m_input = input;
+    m_middles.resize(input.count);
+    m_reach.resize(input.count);
+    for (size_t i = 0; i < input.count; ++i)
+    {
+      const SweptBody &body = input.bodies[i];
+      m_middles[i] = body.from + body.motion * 0.5f;
+      m_reach[i] = body.radius + 0.5f * body.travel;
+    }
+  }
+
+  void FindPairs(size_t begin, size_t end, ArenaVector<BulletPair> &pairs) const override
+  {
+    const float width = m_input.worldWidth;
+    const float height = m_input.worldHeight;
+    for (size_t i = begin; i < end; ++i)
+    {
+      for (size_t j = i + 1; j < m_input.count; ++j)
+      {
+        // Shortest way across the world edges, the margin covers rounding of the paths
+        glm::vec2 delta = m_middles[j] - m_middles[i];
+        delta.x = std::abs(delta.x);
+        delta.y = std::abs(delta.y);
+        delta.x = std::min(delta.x, std::abs(width - delta.x));
+        delta.y = std::min(delta.y, std::abs(height - delta.y));
+        const float reach = m_reach[i] + m_reach[j] + BroadPhaseMargin;
+        if (delta.x <= reach && delta.y <= reach)
+          pairs.PushBack({ static_cast<uint32_t>(i), static_cast<uint32_t>(j) });
+      }
+    }
+  }
+
+private:
+  BroadPhaseInput m_input{};
+  std::vector<glm::vec2> m_middles;
+  std::vector<float> m_reach;
+};
+
+constexpr const char *BroadPhaseNames[] = { "hash", "sap", "brute" };
+}// namespace
+
+const char *GetBroadPhaseName(BroadPhaseType type)
+{
+  return BroadPhaseNames[static_cast<size_t>(type)];
+}
+
+bool ParseBroadPhase(const char *name, BroadPhaseType &type)
+{
+  for (size_t i = 0; i < std::size(BroadPhaseNames); ++i)
+  {
+    if (std::strcmp(name, BroadPhaseNames[i]) == 0)
+    {
+      type = static_cast<BroadPhaseType>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+std::unique_ptr<BroadPhase> CreateBroadPhase(BroadPhaseType type)
+{
+  switch (type)
+  {
+  case BroadPhaseType::SweepAndPrune:
+    return std::make_unique<SweepAndPrune>();
+  case BroadPhaseType::BruteForce:
+    return std::make_unique<BruteForceBroadPhase>();
+  case BroadPhaseType::SpatialHash:
+    break;
+  }
+  return std::make_unique<SpatialHashBroadPhase>();
+}
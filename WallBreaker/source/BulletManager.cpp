@@ -1,288 +1,1047 @@
 #include "BulletManager.hpp"
-#include "WallBreaker.hpp"
+#include "CollisionKernels.hpp"
 #include "Math.hpp"
+#include "Philox.hpp"
+#include "Profiler.hpp"
+#include "ReplayLog.hpp"
+#include "SimdKernels.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <random>
 
 namespace
 {
-inline float DoCirclesOverlap(glm::vec2 v1, float r1, glm::vec2 v2, float r2)
+// Amount of bullets processed by a single parallel task
+constexpr size_t BulletsGrain = 2048;
+// Amount of wall cells generated by a single parallel task
+constexpr size_t WallCellsGrain = 16384;
+
+constexpr float WallsThickness = 2.0f;
+constexpr Color WallsColor = Colors::Cyan;
+
+// The wall of a cell of a gridRatio x gridRatio grid over the area, false when its ends coincide. Random numbers
+// come from the cell and chunk indices keyed by the seed, so cells are generated in any order with the same result.
+bool GenerateCellWall(glm::vec2 min, glm::vec2 cellSize, unsigned int gridRatio, uint32_t cell, uint32_t chunk,
+  uint32_t seed, Segment &wall)
 {
-  const glm::vec2 v = v1 - v2;
-  return fabs(Math::dot(v, v)) <= (r1 + r2) * (r1 + r2);
+  const PhiloxCounter random = Philox4x32({ cell, chunk, 0, 0 }, { seed, 0 });
+
+  const glm::vec2 cellOrigin(min.x + (cell % gridRatio) * cellSize.x, min.y + (cell / gridRatio) * cellSize.y);
+  const int minX = cellOrigin.x;
+  const int maxX = cellOrigin.x + cellSize.x;
+  const int minY = cellOrigin.y;
+  const int maxY = cellOrigin.y + cellSize.y;
+
+  wall.p0 = glm::vec2(UniformInt(random[0], minX, maxX), UniformInt(random[1], minY, maxY));
+  wall.p1 = glm::vec2(UniformInt(random[2], minX, maxX), UniformInt(random[3], minY, maxY));
+  wall.thickness = WallsThickness;
+  return wall.p0 != wall.p1;
 }
-inline float IsPointInCircle(glm::vec2 c, float r1, glm::vec2 p)
+
+inline uint32_t CountTrailingZeros(uint32_t mask)
 {
-  const glm::vec2 v = c - p;
-  return fabs(Math::dot(v, v)) < (r1 * r1);
+  uint32_t count = 0;
+  while ((mask & 1u) == 0)
+  {
+    mask >>= 1;
+    ++count;
+  }
+  return count;
+}
+
+// FNV-1a
+constexpr uint64_t HashOffsetBasis = 14695981039346656037ull;
+inline uint64_t HashBytes(uint64_t hash, const void *data, size_t size)
+{
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i)
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  return hash;
 }
 }// namespace
 
-int BulletManager::CreateBullet(glm::vec2 pos, float radius, float time, float lifetime, sf::Color color)
+int BulletManager::CreateBullet(glm::vec2 pos, float radius, float lifetime, Color color)
 {
+  // Every bullet lives at least one tick
+  const auto lifetimeTicks = static_cast<uint32_t>(std::ceil(lifetime / m_fixedDeltaTime));
+
   Bullet b{};
   b.position = pos;
   b.radius = radius;
   b.mass = radius * 10.0f;
-  b.spawntime = time;
-  b.lifetime = lifetime;
+  b.spawnTick = m_tick;
+  b.deathTick = m_tick + std::max(lifetimeTicks, 1u);
 
-  m_bullets.emplace_back(b);
+  size_t i = m_bullets.Add(b);
+  m_expiryWheel.Schedule(m_bullets.GetHandle(i), b.deathTick);
 
-  sf::CircleShape shape{};
-  shape.setRadius(radius);
-  shape.setFillColor(color);
-  //shape.setOutlineColor(sf::Color::Yellow);
-  //shape.setOutlineThickness(1);
-  m_bulletShapes.emplace_back(shape);
+  m_bulletColors.push_back(color);
+
+  // New bullets are awake, the first sleeping one makes room for it
+  if (i != m_awakeCount)
+  {
+    SwapBullets(i, m_awakeCount);
+    i = m_awakeCount;
+  }
+  ++m_awakeCount;
 
-  return m_bullets.size() - 1;
+  return i;
 }
 
-void BulletManager::Fire(glm::vec2 pos, glm::vec2 dir, float speed, float time, float lifetime)
+void BulletManager::ReserveBullets(size_t count)
 {
-  std::lock_guard lock(m_bulletsMutex);
+  const size_t required = m_bullets.Size() + count;
+  const size_t capacity = m_bullets.positionX.capacity();
+  if (required <= capacity)
+    return;
 
-  const int i = CreateBullet(pos, DefaultBulletRadius, time, lifetime, sf::Color::Yellow);
-  m_bullets[i].velocity = dir * speed;
+  const size_t newCapacity = std::max(required, capacity * 2);
+  m_bullets.Reserve(newCapacity);
+  m_bulletColors.reserve(newCapacity);
 }
 
-void BulletManager::Update(float time)
+void BulletManager::RemoveBullet(size_t i)
 {
-  const float deltaTime = time - m_lastTimeStamp;
-  m_lastTimeStamp = time;
+  // The last awake bullet takes the place of the removed one, so awake bullets stay in front
+  if (i < m_awakeCount)
+  {
+    --m_awakeCount;
+    SwapBullets(i, m_awakeCount);
+    i = m_awakeCount;
+  }
 
-  std::lock_guard lock(m_bulletsMutex);
+  m_bullets.SwapRemove(i);
 
-  for (size_t i = 0; i < m_bullets.size(); ++i)
+  // Render data follows the same swap and pop order
+  const size_t last = m_bulletColors.size() - 1;
+  if (i != last)
+    m_bulletColors[i] = m_bulletColors[last];
+  m_bulletColors.pop_back();
+}
+
+void BulletManager::SwapBullets(size_t i, size_t j)
+{
+  m_bullets.Swap(i, j);
+  std::swap(m_bulletColors[i], m_bulletColors[j]);
+}
+
+bool BulletManager::Fire(glm::vec2 pos, glm::vec2 dir, float speed, float lifetime)
+{
+  return m_spawnQueue.TryPush({ pos, dir * speed, lifetime });
+}
+
+void BulletManager::FireBatch(const BulletSpawn *spawns, size_t count)
+{
+  std::lock_guard lock(m_spawnBatchMutex);
+
+  // Geometric growth, so a stream of small batches doesn't reallocate on every call
+  const size_t required = m_spawnBatch.size() + count;
+  if (required > m_spawnBatch.capacity())
+    m_spawnBatch.reserve(std::max(required, m_spawnBatch.capacity() * 2));
+
+  for (size_t i = 0; i < count; ++i)
   {
-    auto &bullet = m_bullets[i];
-    // Other threads can spawn bullets earlier, so we need to wait
-    if (bullet.spawntime > time)
+    const BulletSpawn &spawn = spawns[i];
+    m_spawnBatch.push_back(
+      { spawn.position, spawn.direction * spawn.speed, spawn.lifetime, spawn.radius, spawn.delay });
+  }
+}
+
+void BulletManager::SpawnQueuedBullets()
+{
+  WB_PROFILE_SCOPE("SpawnQueuedBullets");
+
+  // Staged bullets due now come first, they were fired earlier than anything queued
+  m_stagedSpawns.Advance(m_tick, [this](const SpawnRequest &request) { Spawn(request); });
+
+  m_spawnQueue.Drain([this](const SpawnRequest &request) { Spawn(request); });
+
+  // Batches are taken in one swap, firing threads can append the next ones meanwhile
+  {
+    std::lock_guard lock(m_spawnBatchMutex);
+    m_spawnBatch.swap(m_drainedSpawnBatch);
+  }
+  Spawn(m_drainedSpawnBatch.data(), m_drainedSpawnBatch.size());
+  m_drainedSpawnBatch.clear();
+}
+
+void BulletManager::Spawn(const SpawnRequest &request)
+{
+  Spawn(&request, 1);
+}
+
+void BulletManager::Spawn(const SpawnRequest *requests, size_t count)
+{
+  if (count == 0)
+    return;
+
+  ReserveBullets(count);
+
+  size_t spawned = 0;
+  for (size_t r = 0; r < count; ++r)
+  {
+    const SpawnRequest &request = requests[r];
+    if (request.delay > 0.0f)
     {
+      // Recorded when it appears, so replays see it as a plain spawn at that tick
+      const auto delayTicks = static_cast<uint32_t>(std::ceil(request.delay / m_fixedDeltaTime));
+      SpawnRequest staged = request;
+      staged.delay = 0.0f;
+      m_stagedSpawns.Schedule(staged, m_tick + std::max(delayTicks, 1u));
       continue;
     }
 
-    if (bullet.spawntime + bullet.lifetime < time)
+    if (m_recorder)
     {
-      m_bullets.erase(m_bullets.begin() + i);
-      // probably a lot of cache misses would be here, need to be investigated
-      m_bulletShapes.erase(m_bulletShapes.begin() + i);
-      i--;
-      continue;
+      ReplayEvent event;
+      event.tick = m_tick;
+      event.type = ReplayEventType::Spawn;
+      event.spawn = request;
+      m_recorder->Record(event);
     }
 
+    const int i = CreateBullet(request.position, request.radius, request.lifetime, Colors::Yellow);
+    m_bullets.SetVelocity(i, request.velocity);
+    ++spawned;
+  }
+  WB_PROFILE_COUNT(BulletsSpawned, spawned);
+}
+
+void BulletManager::Step()
+{
+  WB_PROFILE_SCOPE("Step");
+
+  SpawnQueuedBullets();
+
+  RemoveExpiredBullets();
+
+  StreamWalls();
+
+  ResetCollisionScratch();
+
+  // Render interpolates from these towards the positions at the end of the tick
+  m_bullets.SavePreviousPositions();
+
+  // Every bullet is deflected by another one at most once per substep, more substeps resolve more impacts within a tick
+  const float substepDeltaTime = m_fixedDeltaTime / m_substeps;
+  for (uint32_t substep = 0; substep < m_substeps; ++substep)
+  {
     // Global bullet movement
-    MoveBullet(bullet, deltaTime);
+    MoveBullets(substepDeltaTime);
+
+    ProcessBulletsCollision(substepDeltaTime);
   }
 
-  ProcessBulletsCollision(deltaTime);
+  UpdateSleeping();
+
+  // Walls destroyed by any substep leave the arrays in a single pass
+  CompactWalls();
 
-  // This loop is a bottleneck right now because of SFML renderer, definitely should be reworked later
-  //    TODO: Even primitive shapes in SFML contain a lot of useless fields which occupies a lot of memory. 
-  //    We are wasting a lot of time on cache misses due to big size of rendering elements. For our current task we should use
-  //    custom SFML shapes with smaller size (or use own OpenGL renderer) to pack primitive shapes mory tightly)
-  // Each SFML circle shape position located outside of circle, we should displace it
-  for (size_t i = 0; i < m_bullets.size(); ++i)
+  ++m_tick;
+
+  WB_PROFILE_SAMPLE_COUNTERS();
+}
+
+void BulletManager::RemoveExpiredBullets()
+{
+  WB_PROFILE_SCOPE("RemoveExpiredBullets");
+
+  m_expiryWheel.Advance(m_tick, [this](BulletHandle handle) {
+    const size_t i = m_bullets.Find(handle);
+    if (i != InvalidBulletIndex)
+      RemoveBullet(i);
+  });
+}
+
+void BulletManager::UpdateSleeping()
+{
+  if (!m_sleepingEnabled)
+    return;
+
+  WB_PROFILE_SCOPE("UpdateSleeping");
+
+  // Backwards, so the awake bullet swapped in from the end of the awake range has been checked already
+  constexpr float sleepSpeedSq = DefaultSleepSpeed * DefaultSleepSpeed;
+  for (size_t i = m_awakeCount; i-- > 0;)
   {
-    glm::vec2 displacedPos{ m_bullets[i].position.x, m_bullets[i].position.y };
-    displacedPos -= m_bullets[i].radius;
-    m_bulletShapes[i].setPosition({ displacedPos.x, displacedPos.y });
-    m_window->draw(m_bulletShapes[i]);
+    const glm::vec2 velocity = m_bullets.Velocity(i);
+    if (Math::dot(velocity, velocity) >= sleepSpeedSq)
+    {
+      m_bullets.restingSteps[i] = 0;
+      continue;
+    }
+    if (++m_bullets.restingSteps[i] < DefaultSleepSteps)
+      continue;
+
+    m_bullets.SetVelocity(i, glm::vec2(0.0f, 0.0f));
+    --m_awakeCount;
+    SwapBullets(i, m_awakeCount);
   }
+}
 
-  // TODO: Walls stuff should be revisited
-  for (size_t i = 0; i < m_walls.size(); ++i)
+void BulletManager::WakeBullets()
+{
+  if (m_wokenBullets.empty())
+    return;
+
+  // Ascending, so every swap exchanges the woken bullet with a lower one, bullets still to wake stay in place
+  std::sort(m_wokenBullets.begin(), m_wokenBullets.end());
+  m_wokenBullets.erase(std::unique(m_wokenBullets.begin(), m_wokenBullets.end()), m_wokenBullets.end());
+  for (const uint32_t i : m_wokenBullets)
+  {
+    m_bullets.restingSteps[i] = 0;
+    SwapBullets(i, m_awakeCount);
+    ++m_awakeCount;
+  }
+  m_wokenBullets.clear();
+}
+
+void BulletManager::SetSleepingEnabled(bool enabled)
+{
+  m_sleepingEnabled = enabled;
+  if (enabled)
+    return;
+
+  m_awakeCount = m_bullets.Size();
+  std::fill(m_bullets.restingSteps.begin(), m_bullets.restingSteps.end(), 0);
+}
+
+void BulletManager::ResetCollisionScratch()
+{
+  // Bullets aren't added or removed during substeps, so chunks stay the same for the whole step
+  const size_t chunksCount = (m_bullets.Size() + BulletsGrain - 1) / BulletsGrain;
+  if (m_collisionChunks.size() < chunksCount)
+    m_collisionChunks.resize(chunksCount);
+
+  // Vectors are bound again after the reset, the old storage was given back to the arenas
+  for (CollisionChunk &chunk : m_collisionChunks)
+  {
+    chunk.arena.Reset();
+    chunk.contacts = ArenaVector<Contact>(chunk.arena);
+    chunk.pairs = ArenaVector<BulletPair>(chunk.arena);
+  }
+  m_stepArena.Reset();
+  m_deferredContacts = ArenaVector<Contact>(m_stepArena);
+  m_bulletContacts = ArenaVector<Contact>(m_stepArena);
+}
+
+FrameArenaStats BulletManager::GetCollisionArenaStats() const
+{
+  FrameArenaStats total = m_stepArena.GetStats();
+  for (const CollisionChunk &chunk : m_collisionChunks)
   {
-    // TODO: no need to set position here each time, walls are static, we should set shape postions somewhere else
-    m_wallShapes[i].setPosition(m_walls[i].p0, m_walls[i].p1);
-    m_window->draw(m_wallShapes[i]);
+    const FrameArenaStats stats = chunk.arena.GetStats();
+    total.heapAllocations += stats.heapAllocations;
+    total.capacity += stats.capacity;
+    total.used += stats.used;
+    total.peakUsed += stats.peakUsed;
   }
+  return total;
 }
 
-inline void BulletManager::MoveBullet(Bullet &bullet, float deltaTime)
+void BulletManager::MoveBullets(float deltaTime)
 {
+  WB_PROFILE_SCOPE("MoveBullets");
+
+  // Collisions are swept along the path from these positions
+  m_sweepFromX = m_bullets.positionX;
+  m_sweepFromY = m_bullets.positionY;
+  m_sweepTime.assign(m_bullets.Size(), deltaTime);
+
+  float *posX = m_bullets.positionX.data();
+  float *posY = m_bullets.positionY.data();
+  float *velX = m_bullets.velocityX.data();
+  float *velY = m_bullets.velocityY.data();
+
   // Acceleration sumulation
-  constexpr float ExternalForceCoeff = 0.8f;
+  //constexpr float ExternalForceCoeff = 0.8f;
   //bullet.acceleration = -bullet.velocity * ExternalForceCoeff;
-
-  // Update bullet physics
   //bullet.velocity += bullet.acceleration * deltaTime;
-  bullet.position += bullet.velocity * deltaTime;
 
-  // Wrap bullets around the screen
-  if (bullet.position.x < 0)
-    bullet.position.x += m_viewportWidth;
-  if (bullet.position.x >= m_viewportWidth)
-    bullet.position.x -= m_viewportWidth;
-  if (bullet.position.y < 0)
-    bullet.position.y += m_viewportHeight;
-  if (bullet.position.y >= m_viewportHeight)
-    bullet.position.y -= m_viewportHeight;
+  // Every bullet moves independently, so the integration is split across all cores and vectorised within a chunk.
+  // Sleeping bullets don't move.
+  ParallelFor(m_threadManager, 0, m_awakeCount, BulletsGrain, [&](size_t begin, size_t end, size_t) {
+    Simd::IntegrateAndWrap(posX + begin, posY + begin, velX + begin, velY + begin, end - begin, deltaTime,
+      m_viewportWidth, m_viewportHeight);
+  });
+}
+
+glm::vec2 BulletManager::WrappedDelta(glm::vec2 from, glm::vec2 to) const
+{
+  // Shortest vector between two points on the wrapped screen
+  glm::vec2 delta = to - from;
+  if (delta.x > m_viewportWidth * 0.5f)
+    delta.x -= m_viewportWidth;
+  else if (delta.x < -m_viewportWidth * 0.5f)
+    delta.x += m_viewportWidth;
+  if (delta.y > m_viewportHeight * 0.5f)
+    delta.y -= m_viewportHeight;
+  else if (delta.y < -m_viewportHeight * 0.5f)
+    delta.y += m_viewportHeight;
+  return delta;
+}
 
-  // Clamp velocity near zero
-  if (fabs(Math::dot(bullet.velocity, bullet.velocity)) < 0.01f)
-    bullet.velocity = { 0.0f, 0.0f };
+glm::vec2 BulletManager::WrapPosition(glm::vec2 position) const
+{
+  // Paths are never longer than the viewport, so a single correction is enough
+  if (position.x < 0)
+    position.x += m_viewportWidth;
+  if (position.x >= m_viewportWidth)
+    position.x -= m_viewportWidth;
+  if (position.y < 0)
+    position.y += m_viewportHeight;
+  if (position.y >= m_viewportHeight)
+    position.y -= m_viewportHeight;
+  return position;
 }
 
 void BulletManager::ProcessBulletsCollision(float deltaTime)
 {
-  std::vector<std::pair<Bullet *, Bullet *>> collidingBullets;
-  std::vector<Bullet *> fakeBullets;
+  WB_PROFILE_SCOPE("ProcessBulletsCollision");
+
+  // Bullets which kept overlapping after the swept pass, they are resolved with the old end of step response
+  ArenaVector<Contact> &collidingBullets = m_deferredContacts;
+  collidingBullets.Clear();
+
+  float *posX = m_bullets.positionX.data();
+  float *posY = m_bullets.positionY.data();
+  const float *velX = m_bullets.velocityX.data();
+  const float *velY = m_bullets.velocityY.data();
+  const float *radius = m_bullets.radius.data();
+  float *fromX = m_sweepFromX.data();
+  float *fromY = m_sweepFromY.data();
+  float *sweepTime = m_sweepTime.data();
+  const size_t count = m_bullets.Size();
+  // Only awake bullets look for contacts, sleeping ones are static targets
+  const size_t awakeCount = m_awakeCount;
 
-  // Bullets collision handling
-  for (auto &bullet : m_bullets)
+  // Candidates are searched in parallel into per chunk lists, chunks don't depend on the number of threads
+  // and are merged in their order, so contact resolution below is the same for any amount of cores
+  const size_t chunksCount = (awakeCount + BulletsGrain - 1) / BulletsGrain;
+
+  // Every bullet is deflected at its earliest impact at most once per substep, later contacts fall back to
+  // the end of substep response and are caught by the next sweep
+  char *deflectedBullets = m_stepArena.Allocate<char>(count);
+  std::fill(deflectedBullets, deflectedBullets + count, 0);
+
+  // Bullets collision handling, broad-phase gives us only bullets which can meet during the substep
+  if (m_processBulletsCollision)
   {
-    if(m_processBulletsCollision)
+    WB_PROFILE_SCOPE("BulletsCollision");
+
+    // Everything the pair test reads is packed together, candidates are visited in random order
+    m_sweptBodies.resize(count);
+    SweptBody *bodies = m_sweptBodies.data();
+    float maxRadius = DefaultBulletRadius;
+    float maxTravel = 0.0f;
+    for (size_t i = 0; i < count; ++i)
     {
-      for (auto &targetBullet : m_bullets)
-      {
-        if (&bullet == &targetBullet)
-          continue;
+      SweptBody &body = bodies[i];
+      body.from = glm::vec2(fromX[i], fromY[i]);
+      body.motion = glm::vec2(velX[i], velY[i]) * deltaTime;
+      body.radius = radius[i];
+      body.travel = Math::length(body.motion);
+      maxRadius = std::max(maxRadius, body.radius);
+      maxTravel = std::max(maxTravel, body.travel);
+    }
+
+    {
+      WB_PROFILE_SCOPE("BulletsBroadPhase");
+      const BroadPhaseInput input{ bodies, count, awakeCount, m_bullets.handleSlot.data(),
+        m_bullets.handleSlots.size(), maxRadius, maxTravel, m_viewportWidth, m_viewportHeight };
+      m_broadPhase->Update(input, m_threadManager);
+    }
+
+    // Narrow-phase, time of impact of every pair along the relative motion. Broad phases leave out pairs of two
+    // sleeping bullets, they can't meet.
+    ParallelFor(m_threadManager, 0, awakeCount, BulletsGrain, [&](size_t begin, size_t end, size_t chunk) {
+      WB_PROFILE_SCOPE("BulletsNarrowPhase");
+      CollisionChunk &scratch = m_collisionChunks[chunk];
+      ArenaVector<Contact> &contacts = scratch.contacts;
+      contacts.Clear();
+      ArenaVector<BulletPair> &pairs = scratch.pairs;
+      pairs.Clear();
+      m_broadPhase->FindPairs(begin, end, pairs);
 
-        if (DoCirclesOverlap(bullet.position, bullet.radius, targetBullet.position, targetBullet.radius))
+      for (const BulletPair &pair : pairs)
+      {
+        const SweptBody &a = bodies[pair.a];
+        const SweptBody &b = bodies[pair.b];
+        if (!NeedsSweep(a) && !NeedsSweep(b))
         {
-          // Collision has occured
-          collidingBullets.push_back({ &bullet, &targetBullet });
-          // Distance between bullet centers
-          float fDistance = Math::distance(bullet.position, targetBullet.position);
-          // Calculate displacement required
-          float fOverlap = 0.5f * (fDistance - bullet.radius - targetBullet.radius);
-          // Displace Current bullet away from collision
-          bullet.position -= fOverlap * (bullet.position - targetBullet.position) / fDistance;
-          // Displace Target bullet away from collision
-          targetBullet.position += fOverlap * (bullet.position - targetBullet.position) / fDistance;
+          // Neither can pass through the other, overlaps at the end positions are separated like the ones left by
+          // the sweep
+          const glm::vec2 delta = WrappedDelta({ posX[pair.b], posY[pair.b] }, { posX[pair.a], posY[pair.a] });
+          if (Collision::DoCirclesOverlap(delta, a.radius, glm::vec2(0.0f, 0.0f), b.radius))
+            contacts.PushBack({ pair.a, pair.b, 0.0f, glm::vec2(0.0f, 0.0f), 0.0f, nullptr });
+          continue;
         }
+
+        // Bullets could touch each other across the screen edge
+        const glm::vec2 delta = WrappedDelta(b.from, a.from);
+        const glm::vec2 motion = a.motion - b.motion;
+        const float reach = a.radius + b.radius;
+        float toi = 0.0f;
+        if (!Collision::SweepPointVsCircle(delta, motion, glm::vec2(0.0f, 0.0f), reach, toi))
+          continue;
+
+        // Separation at the moment of impact
+        const glm::vec2 separation = delta + motion * toi;
+        const float distance = Math::length(separation);
+        const glm::vec2 normal = distance > 0.0f ? separation / distance : glm::vec2(0.0f, 0.0f);
+        contacts.PushBack({ pair.a, pair.b, toi, normal, reach - distance, nullptr });
       }
+
+      WB_PROFILE_COUNT(PairsTested, pairs.Size());
+      WB_PROFILE_COUNT(Contacts, contacts.Size());
+    });
+
+    // Responses change both bullets, so they are applied serially in a fixed order. Broad phases find pairs in
+    // their own order and from either bullet, contacts are sorted by pair so the result doesn't depend on them.
+    WB_PROFILE_SCOPE("BulletsResponse");
+    ArenaVector<Contact> &bulletContacts = m_bulletContacts;
+    bulletContacts.Clear();
+    for (size_t chunk = 0; chunk < chunksCount; ++chunk)
+    {
+      for (const Contact &contact : m_collisionChunks[chunk].contacts)
+        bulletContacts.PushBack(contact);
     }
+    std::sort(bulletContacts.begin(), bulletContacts.end(),
+      [](const Contact &x, const Contact &y) { return x.a < y.a || (x.a == y.a && x.b < y.b); });
 
-    for (size_t j = 0; j < m_walls.size(); ++j)
+    for (const Contact &contact : bulletContacts)
     {
-      Segment &edge = m_walls[j];
-      const glm::vec2 v0 = edge.p1 - edge.p0;
-      const glm::vec2 v1 = bullet.position - edge.p0;
+      const uint32_t i = contact.a;
+      const uint32_t j = contact.b;
 
-      const float len = Math::dot(v0, v0);
-      // Clamping distance between 0 and 1 to handle only segment collion, not the infinite line
-      const float t = std::max(0.0f, std::min(len, Math::dot(v0, v1))) / len;
+      if (contact.toi > 0.0f && !deflectedBullets[i] && !deflectedBullets[j])
+      {
+        // Both bullets are moved back to the moment of impact, exchange momentum and fly the rest of the substep
+        const float impactTime = deltaTime * contact.toi;
+        const glm::vec2 impactI = glm::vec2(fromX[i], fromY[i]) + m_bullets.Velocity(i) * impactTime;
+        const glm::vec2 impactJ = glm::vec2(fromX[j], fromY[j]) + m_bullets.Velocity(j) * impactTime;
 
-      glm::vec2 c = edge.p0 + v0 * t;
+        glm::vec2 v1 = m_bullets.Velocity(i);
+        glm::vec2 v2 = m_bullets.Velocity(j);
+        ExchangeMomentum(impactI, m_bullets.mass[i], v1, impactJ, m_bullets.mass[j], v2);
+        m_bullets.SetVelocity(i, v1);
+        m_bullets.SetVelocity(j, v2);
 
-      glm::vec2 n = bullet.position - c;
-      float fDistance = Math::length(n);
+        const float timeLeft = deltaTime - impactTime;
+        m_bullets.SetPosition(i, WrapPosition(impactI + v1 * timeLeft));
+        // A sleeping bullet isn't swept against walls, it waits for the next substep where it moves awake
+        if (j < awakeCount)
+          m_bullets.SetPosition(j, WrapPosition(impactJ + v2 * timeLeft));
+        else
+          m_wokenBullets.push_back(j);
 
-      if (fDistance <= (bullet.radius + edge.thickness))
+        // Walls are swept along the rest of the path only
+        fromX[i] = impactI.x;
+        fromY[i] = impactI.y;
+        sweepTime[i] = timeLeft;
+        fromX[j] = impactJ.x;
+        fromY[j] = impactJ.y;
+        sweepTime[j] = timeLeft;
+
+        deflectedBullets[i] = 1;
+        deflectedBullets[j] = 1;
+        continue;
+      }
+
+      // Overlapping from the start or already deflected, separated at the end positions
+      const glm::vec2 delta = WrappedDelta({ posX[j], posY[j] }, { posX[i], posY[i] });
+      if (!Collision::DoCirclesOverlap(delta, radius[i], glm::vec2(0.0f, 0.0f), radius[j]))
+        continue;
+
+      // Collision has occured
+      collidingBullets.PushBack(contact);
+      if (j >= awakeCount)
+        m_wokenBullets.push_back(j);
+      // Distance between bullet centers
+      const float fDistance = Math::length(delta);
+      if (fDistance <= 0.0f)
+        continue;
+      // Calculate displacement required
+      const float fOverlap = 0.5f * (fDistance - radius[i] - radius[j]);
+      const glm::vec2 displacement = fOverlap * delta / fDistance;
+      // Displace Current bullet away from collision
+      posX[i] -= displacement.x;
+      posY[i] -= displacement.y;
+      // Displace Target bullet away from collision
+      posX[j] += displacement.x;
+      posY[j] += displacement.y;
+    }
+  }
+
+  // A bounce can send the bullet into another wall within the same substep, the rest of its path is swept again
+  ProcessWallsCollision(nullptr, awakeCount, m_bouncedBullets);
+  for (uint32_t pass = 1; pass < MaxWallBounces && !m_bouncedBullets.empty(); ++pass)
+  {
+    m_sweptBullets.swap(m_bouncedBullets);
+    ProcessWallsCollision(m_sweptBullets.data(), m_sweptBullets.size(), m_bouncedBullets);
+  }
+
+  // Handle Bullet vs Bullet collisions left for the end of the substep
+  for (const Contact &contact : collidingBullets)
+  {
+    glm::vec2 v1 = m_bullets.Velocity(contact.a);
+    glm::vec2 v2 = m_bullets.Velocity(contact.b);
+    ExchangeMomentum(m_bullets.Position(contact.a), m_bullets.mass[contact.a], v1,
+      m_bullets.Position(contact.b), m_bullets.mass[contact.b], v2);
+    m_bullets.SetVelocity(contact.a, v1);
+    m_bullets.SetVelocity(contact.b, v2);
+  }
+
+  WakeBullets();
+}
+
+void BulletManager::ProcessWallsCollision(const uint32_t *bullets, size_t count, std::vector<uint32_t> &bounced)
+{
+  const float *radius = m_bullets.radius.data();
+  float *fromX = m_sweepFromX.data();
+  float *fromY = m_sweepFromY.data();
+  float *sweepTime = m_sweepTime.data();
+
+  // Only walls registered around the path of the bullet are visited
+  ParallelFor(m_threadManager, 0, count, BulletsGrain, [&](size_t begin, size_t end, size_t chunk) {
+    WB_PROFILE_SCOPE("WallsNarrowPhase");
+    CollisionChunk &scratch = m_collisionChunks[chunk];
+    ArenaVector<Contact> &hits = scratch.contacts;
+    hits.Clear();
+
+    std::vector<uint32_t> &nearWalls = scratch.nearWalls;
+    for (size_t k = begin; k < end; ++k)
+    {
+      const size_t i = bullets ? bullets[k] : k;
+      const glm::vec2 from(fromX[i], fromY[i]);
+      const glm::vec2 motion = m_bullets.Velocity(i) * sweepTime[i];
+      // Circle around the whole path of the bullet
+      const glm::vec2 center = from + motion * 0.5f;
+      const float reach = radius[i] + 0.5f * Math::length(motion);
+
+      nearWalls.clear();
+      m_wallIndex.Query(center, reach, nearWalls);
+      // Walls destroyed by an earlier substep are still indexed
+      if (m_deadWallsCount > 0)
+        nearWalls.erase(std::remove_if(nearWalls.begin(), nearWalls.end(), [this](uint32_t j) { return IsWallDead(j); }),
+          nearWalls.end());
+      // Keep the same order as a linear pass over all walls would have
+      std::sort(nearWalls.begin(), nearWalls.end());
+
+      // Walls far from the path are rejected in blocks of 8 by the vectorised test, the rest are swept exactly
+      const size_t firstHit = hits.Size();
+      Simd::SegmentsBlock block;
+      for (size_t first = 0; first < nearWalls.size(); first += Simd::SegmentsBlockSize)
       {
-        // 0 or 1 are collisions with start/end points
-        if (t == 0 || t == 1)
+        block.count = static_cast<uint32_t>(std::min<size_t>(Simd::SegmentsBlockSize, nearWalls.size() - first));
+        for (uint32_t lane = 0; lane < block.count; ++lane)
+          block.Set(lane, m_walls[nearWalls[first + lane]]);
+
+        for (uint32_t mask = Simd::SegmentsVsCircle(block, center.x, center.y, reach); mask != 0; mask &= mask - 1)
         {
-          // Colision with the start/end of a segment
-          Bullet *fakeBullet = new Bullet;
-          fakeBullet->position = c;
-          fakeBullet->radius = edge.thickness;
-          fakeBullet->mass = bullet.mass * 0.8f;
-          fakeBullet->velocity = -bullet.velocity;
-
-          // Add collision to vector of collisions for dynamic resolution
-          collidingBullets.push_back({ &bullet, fakeBullet });
-          fakeBullets.push_back(fakeBullet);
-          // Calculate displacement
-          float fOverlap = 1.0f * (fDistance - bullet.radius - fakeBullet->radius);
-          bullet.position -= fOverlap * (bullet.position - fakeBullet->position) / fDistance;
+          const uint32_t j = nearWalls[first + CountTrailingZeros(mask)];
+          float toi = 0.0f;
+          if (Collision::SweepCircleVsSegment(from, motion, radius[i], m_walls[j], toi))
+            hits.PushBack({ static_cast<uint32_t>(i), j, toi, glm::vec2(0.0f, 0.0f), 0.0f, nullptr });
         }
-        else
+      }
+
+      // Earliest impact first, ties in walls order
+      std::sort(hits.begin() + firstHit, hits.end(), [](const Contact &a, const Contact &b) {
+        return a.toi < b.toi || (a.toi == b.toi && a.b < b.b);
+      });
+
+      // Contact geometry at the moment of impact, bullet state doesn't change before the response below
+      for (size_t h = firstHit; h < hits.Size(); ++h)
+      {
+        Contact &contact = hits[h];
+        const Segment &edge = m_walls[contact.b];
+        Collision::WallHit hit;
+        Collision::TestWallHit(from + m_bullets.Velocity(i) * (sweepTime[i] * contact.toi), radius[i], edge, hit);
+
+        contact.normal = hit.distance > 0.0f ? Math::normalize(hit.normal) : glm::vec2(0.0f, 0.0f);
+        contact.penetration = radius[i] + edge.thickness - hit.distance;
+
+        // 0 or 1 are collisions with start/end points, resolved against a static body standing in the endpoint
+        if (hit.t == 0 || hit.t == 1)
         {
-          // Collision with the "flat" part of a segment
-          bullet.velocity = Math::reflect(bullet.velocity, Math::normalize(n));
+          StaticBody *endpoint = scratch.arena.Allocate<StaticBody>(1);
+          endpoint->position = hit.closestPoint;
+          endpoint->radius = edge.thickness;
+          endpoint->mass = m_bullets.mass[i] * 0.8f;
+          contact.endpoint = endpoint;
         }
-
-        m_walls.erase(m_walls.begin() + j);
-        // Erasing shapes here could be a performace bottleneck due to possible cache misses
-        m_wallShapes.erase(m_wallShapes.begin() + j);
-        j--;
       }
     }
-  }
 
-  // Handle Bullet vs Bullet collisions
-  for (auto &c : collidingBullets)
+    WB_PROFILE_COUNT(Contacts, hits.Size());
+  });
+
+  // Every wall is destroyed by the first bullet hitting it, so hits are applied serially in bullets order.
+  // A bullet bounces off the earliest wall still standing on its path, its hits are sorted and kept together.
+  WB_PROFILE_SCOPE("WallsResponse");
+  bounced.clear();
+  const size_t chunksCount = (count + BulletsGrain - 1) / BulletsGrain;
+  uint32_t bouncedBullet = UINT32_MAX;
+  for (size_t chunk = 0; chunk < chunksCount; ++chunk)
   {
-    Bullet *b1 = c.first;
-    Bullet *b2 = c.second;
+    for (const Contact &contact : m_collisionChunks[chunk].contacts)
+    {
+      const uint32_t i = contact.a;
+      const uint32_t j = contact.b;
+      if (i == bouncedBullet || IsWallDead(j))
+        continue;
+
+      // Position of the bullet at the moment of impact
+      const float impactTime = sweepTime[i] * contact.toi;
+      glm::vec2 position = glm::vec2(fromX[i], fromY[i]) + m_bullets.Velocity(i) * impactTime;
+      glm::vec2 velocity = m_bullets.Velocity(i);
 
-    const float fDistance = Math::distance(b1->position, b2->position);
-    glm::vec2 n = (b2->position - b1->position) / fDistance;
+      // Only bullets whose centre lies right on the wall have no direction to be pushed or reflected in
+      const bool hasNormal = contact.normal.x != 0.0f || contact.normal.y != 0.0f;
+      if (contact.endpoint)
+      {
+        // Only bullets which started inside the wall are really moved
+        if (hasNormal)
+          position += contact.normal * contact.penetration;
 
-    glm::vec2 tangent = { -n.y, n.x };
-    // Dot Product Tangent
-    float dpTan1 = Math::dot(b1->velocity, tangent);
-    float dpTan2 = Math::dot(b2->velocity, tangent);
+        // The endpoint doesn't move, its response is discarded
+        glm::vec2 endpointVelocity = -velocity;
+        ExchangeMomentum(position, m_bullets.mass[i], velocity, contact.endpoint->position, contact.endpoint->mass,
+          endpointVelocity);
+      }
+      else if (hasNormal)
+      {
+        // Collision with the "flat" part of a segment
+        velocity = Math::reflect(velocity, contact.normal);
+      }
 
-    // Dot Product Normal
-    float dpNorm1 = Math::dot(b1->velocity, n);
-    float dpNorm2 = Math::dot(b2->velocity, n);
+      // The rest of the substep is flown with the new velocity
+      const float timeLeft = sweepTime[i] - impactTime;
+      m_bullets.SetVelocity(i, velocity);
+      m_bullets.SetPosition(i, WrapPosition(position + velocity * timeLeft));
 
-    // Conservation of momentum in 1D
-    float m1 = (dpNorm1 * (b1->mass - b2->mass) + 2.0f * b2->mass * dpNorm2) / (b1->mass + b2->mass);
-    float m2 = (dpNorm2 * (b2->mass - b1->mass) + 2.0f * b1->mass * dpNorm1) / (b1->mass + b2->mass);
+      KillWall(j);
+      bouncedBullet = i;
 
-    // Update bullet velocities
-    b1->velocity = tangent * dpTan1 + n * m1;
-    b2->velocity = tangent * dpTan2 + n * m2;
+      // The next pass sweeps the rest of the path from the wall
+      if (timeLeft > 0.0f)
+      {
+        position = WrapPosition(position);
+        fromX[i] = position.x;
+        fromY[i] = position.y;
+        sweepTime[i] = timeLeft;
+        bounced.push_back(i);
+      }
+    }
   }
 
-  for (auto &b : fakeBullets)
-    delete b;
 }
 
-void BulletManager::CreateWalls(unsigned int gridRatio, float thickness, sf::Color color)
+void BulletManager::ExchangeMomentum(glm::vec2 p1, float mass1, glm::vec2 &v1, glm::vec2 p2, float mass2, glm::vec2 &v2) const
+{
+  // Bodies touching across the screen edge exchange momentum along the short way
+  Collision::ExchangeMomentum(WrappedDelta(p1, p2), mass1, v1, mass2, v2);
+}
+
+void BulletManager::KillWall(size_t i)
+{
+  // Streamed walls stay destroyed when their chunk is loaded again
+  const WallOrigin origin = m_wallOrigins[i];
+  if (origin.chunk != InvalidChunk)
+    m_chunks.MarkDestroyed(origin.chunk, origin.index);
+
+  MarkWallDead(i);
+  WB_PROFILE_COUNT(WallsDestroyed, 1);
+}
+
+void BulletManager::MarkWallDead(size_t i)
 {
-  if (!m_walls.empty())
+  m_deadWalls[i >> 6] |= uint64_t{ 1 } << (i & 63);
+  ++m_deadWallsCount;
+}
+
+void BulletManager::CompactWalls()
+{
+  if (m_deadWallsCount == 0)
     return;
 
-  const float rectWidth = m_viewportWidth / gridRatio;
-  const float rectHeight = m_viewportHeight / gridRatio;
+  WB_PROFILE_SCOPE("CompactWalls");
+
+  auto forget = [this](size_t i) {
+    m_wallIndex.Remove(static_cast<uint32_t>(i));
+    m_wallSlots[m_wallIds[i]] = InvalidWallSlot;
+  };
 
-  std::random_device os_seed;
-  const auto seed = os_seed();
-  std::mt19937 randGenerator(seed);
+  // Holes are filled by live walls taken from the back, dead walls at the back are simply dropped
+  size_t last = m_walls.size();
+  auto dropDeadBack = [&]() {
+    for (; last > 0 && IsWallDead(last - 1); --last)
+      forget(last - 1);
+  };
 
-  for (size_t i = 0; i < gridRatio; ++i)
+  dropDeadBack();
+  for (size_t i = 0; i < last; ++i)
   {
-    for (size_t j = 0; j < gridRatio; ++j)
-    {
-      glm::vec2 currRectOrigin(j * rectWidth, i * rectHeight);
+    if (!IsWallDead(i))
+      continue;
+
+    forget(i);
+    --last;
+    m_wallIndex.Rename(static_cast<uint32_t>(last), static_cast<uint32_t>(i));
+    m_walls[i] = m_walls[last];
+    m_wallColors[i] = m_wallColors[last];
+    m_wallIds[i] = m_wallIds[last];
+    m_wallOrigins[i] = m_wallOrigins[last];
+    m_wallSlots[m_wallIds[i]] = i;
+    // The slot holds a live wall now, dropDeadBack would take it for the dead one otherwise
+    m_deadWalls[i >> 6] &= ~(uint64_t{ 1 } << (i & 63));
+    dropDeadBack();
+  }
+
+  m_walls.resize(last);
+  m_wallColors.resize(last);
+  m_wallIds.resize(last);
+  m_wallOrigins.resize(last);
+  m_deadWalls.assign((last + 63) / 64, 0);
+  m_deadWallsCount = 0;
+  ++m_wallsRevision;
+}
+
+void BulletManager::CreateWalls(unsigned int gridRatio, uint32_t seed)
+{
+  // Streamed walls own the whole world, any other walls are added to the scene
+  if (m_streamedWallsRatio != 0)
+    return;
+
+  if (m_walls.empty())
+    m_wallIndex.Configure(DefaultWallIndexCellSize, m_viewportWidth, m_viewportHeight);
+
+  CreateWallsInArea(glm::vec2(0.0f, 0.0f), glm::vec2(m_viewportWidth, m_viewportHeight), gridRatio, seed, InvalidChunk);
+}
+
+void BulletManager::CreateWallsInArea(glm::vec2 min, glm::vec2 size, unsigned int gridRatio, uint32_t seed,
+  uint32_t chunk)
+{
+  const size_t cellsCount = static_cast<size_t>(gridRatio) * gridRatio;
+  if (cellsCount == 0)
+    return;
+
+  WB_PROFILE_SCOPE("CreateWalls");
 
-      const int minX = currRectOrigin.x;
-      const int maxX = currRectOrigin.x + rectWidth;
-      const int minY = currRectOrigin.y;
-      const int maxY = currRectOrigin.y + rectHeight;
+  const glm::vec2 cellSize = size / static_cast<float>(gridRatio);
+  auto generate = [&](size_t cell, Segment &wall) {
+    const auto index = static_cast<uint32_t>(cell);
+    return GenerateCellWall(min, cellSize, gridRatio, index, chunk, seed, wall)
+      && (chunk == InvalidChunk || !m_chunks.IsDestroyed(chunk, index));
+  };
 
-      std::uniform_int_distribution distributeX(minX, maxX);
-      std::uniform_int_distribution distributeY(minY, maxY);
+  // Cells are generated twice, first to count the walls of every parallel chunk, then to write them at their
+  // final slots. Generating a cell costs less than keeping it around, and walls keep the order of their cells.
+  const size_t chunksCount = (cellsCount + WallCellsGrain - 1) / WallCellsGrain;
+  m_wallChunkOffsets.assign(chunksCount + 1, 0);
+  ParallelFor(m_threadManager, 0, cellsCount, WallCellsGrain, [&](size_t begin, size_t end, size_t parallelChunk) {
+    size_t count = 0;
+    Segment wall;
+    for (size_t cell = begin; cell < end; ++cell)
+      count += generate(cell, wall);
+    m_wallChunkOffsets[parallelChunk + 1] = count;
+  });
+  for (size_t i = 0; i < chunksCount; ++i)
+    m_wallChunkOffsets[i + 1] += m_wallChunkOffsets[i];
 
-      const glm::vec2 startPoint(distributeX(randGenerator), distributeY(randGenerator));
-      const glm::vec2 endPoint(distributeX(randGenerator), distributeY(randGenerator));
+  const size_t first = m_walls.size();
+  const size_t count = m_wallChunkOffsets[chunksCount];
+  if (count == 0)
+    return;
+
+  const auto firstId = static_cast<WallId>(m_wallSlots.size());
+  m_walls.resize(first + count);
+  m_wallColors.resize(first + count, WallsColor);
+  m_wallIds.resize(first + count);
+  m_wallSlots.resize(firstId + count);
+  m_wallOrigins.resize(first + count);
+  m_deadWalls.resize((m_walls.size() + 63) / 64, 0);
 
-      if (startPoint == endPoint)
+  ParallelFor(m_threadManager, 0, cellsCount, WallCellsGrain, [&](size_t begin, size_t end, size_t parallelChunk) {
+    size_t i = first + m_wallChunkOffsets[parallelChunk];
+    Segment wall;
+    for (size_t cell = begin; cell < end; ++cell)
+    {
+      if (!generate(cell, wall))
         continue;
 
-      CreateWall(startPoint, endPoint, thickness, color);
+      const auto id = static_cast<WallId>(firstId + (i - first));
+      m_walls[i] = wall;
+      m_wallIds[i] = id;
+      m_wallSlots[id] = i;
+      m_wallOrigins[i] = { chunk, static_cast<uint32_t>(cell) };
+      ++i;
     }
+  });
+
+  m_wallIndex.Insert(static_cast<uint32_t>(first), &m_walls[first], count, m_threadManager);
+  ++m_wallsRevision;
+}
+
+void BulletManager::StartStreamingWalls(unsigned int ratio, uint32_t seed)
+{
+  if (!m_walls.empty() || m_streamedWallsRatio != 0 || ratio == 0)
+    return;
+
+  m_streamedWallsRatio = ratio;
+  m_streamedWallsSeed = seed;
+  m_wallIndex.Configure(DefaultWallIndexCellSize, m_viewportWidth, m_viewportHeight);
+  m_chunks.Configure(DefaultChunkSize, m_viewportWidth, m_viewportHeight);
+
+  // Bullets already in the scene get their walls right away
+  StreamWalls();
+}
+
+void BulletManager::StreamWalls()
+{
+  if (m_streamedWallsRatio == 0)
+    return;
+
+  WB_PROFILE_SCOPE("StreamWalls");
+
+  // Bullets are visited in order, so chunks are loaded in the same order for any amount of threads
+  m_streamedChunks.clear();
+  for (size_t i = 0; i < m_awakeCount; ++i)
+    m_chunks.Touch(m_chunks.ChunkAt(m_bullets.Position(i)), m_tick, m_streamedChunks);
+  for (const uint32_t chunk : m_streamedChunks)
+    LoadChunkWalls(chunk);
+
+  // Destroyed walls are remembered by their chunks, the rest is generated again on the next load
+  m_streamedChunks.clear();
+  m_chunks.UnloadIdle(m_tick, DefaultChunkKeepTicks, m_streamedChunks);
+  if (m_streamedChunks.empty())
+    return;
+
+  for (size_t i = 0; i < m_walls.size(); ++i)
+  {
+    const uint32_t chunk = m_wallOrigins[i].chunk;
+    if (chunk != InvalidChunk && !m_chunks.IsLoaded(chunk))
+      MarkWallDead(i);
   }
+  CompactWalls();
+}
+
+void BulletManager::LoadChunkWalls(uint32_t chunk)
+{
+  WB_PROFILE_COUNT(ChunksLoaded, 1);
+
+  // Every chunk has its own random streams, so it's generated the same way whenever and in whatever order it's loaded
+  glm::vec2 min, max;
+  m_chunks.GetBounds(chunk, min, max);
+  CreateWallsInArea(min, max - min, m_streamedWallsRatio, m_streamedWallsSeed, chunk);
 }
 
 void BulletManager::GenerateNewWalls(unsigned int ratio)
 {
+  GenerateNewWalls(ratio, static_cast<uint32_t>(m_randomGenerator()));
+}
+
+void BulletManager::GenerateNewWalls(unsigned int ratio, uint32_t seed)
+{
+  if (m_recorder)
   {
-    constexpr float wallsThickness = 2.0f;
-    const sf::Color wallsColor = sf::Color::Cyan;
-    CreateWalls(ratio, wallsThickness, wallsColor);
+    ReplayEvent event;
+    event.tick = m_tick;
+    event.type = ReplayEventType::GenerateWalls;
+    event.wallsRatio = ratio;
+    event.wallsSeed = seed;
+    m_recorder->Record(event);
   }
+
+  if (m_wallStreaming)
+    StartStreamingWalls(ratio, seed);
+  else
+    CreateWalls(ratio, seed);
 }
 
 void BulletManager::RemoveAllWalls()
 {
+  if (m_recorder)
+  {
+    ReplayEvent event;
+    event.tick = m_tick;
+    event.type = ReplayEventType::RemoveAllWalls;
+    m_recorder->Record(event);
+  }
+
+  for (const WallId id : m_wallIds)
+    m_wallSlots[id] = InvalidWallSlot;
+
   m_walls.clear();
-  m_wallShapes.clear();
+  m_wallColors.clear();
+  m_wallIds.clear();
+  m_wallOrigins.clear();
+  m_deadWalls.clear();
+  m_deadWallsCount = 0;
+  m_wallIndex.Clear();
+  m_streamedWallsRatio = 0;
+  m_chunks.Clear();
+  ++m_wallsRevision;
+}
+
+void BulletManager::ToggleProcessBulletsCollision()
+{
+  if (m_recorder)
+  {
+    ReplayEvent event;
+    event.tick = m_tick;
+    event.type = ReplayEventType::ToggleBulletsCollision;
+    m_recorder->Record(event);
+  }
+
+  m_processBulletsCollision = !m_processBulletsCollision;
+}
+
+void BulletManager::SetBroadPhase(BroadPhaseType type)
+{
+  if (m_broadPhase->GetType() != type)
+    m_broadPhase = CreateBroadPhase(type);
+}
+
+void BulletManager::WriteRenderSnapshot(RenderSnapshot &snapshot) const
+{
+  snapshot.tick = m_tick;
+  snapshot.fixedDeltaTime = m_fixedDeltaTime;
+
+  snapshot.previousPositionX = m_bullets.previousPositionX;
+  snapshot.previousPositionY = m_bullets.previousPositionY;
+  snapshot.positionX = m_bullets.positionX;
+  snapshot.positionY = m_bullets.positionY;
+  snapshot.radius = m_bullets.radius;
+  snapshot.bulletColors = m_bulletColors;
+
+  if (snapshot.wallsRevision != m_wallsRevision)
+  {
+    snapshot.walls = m_walls;
+    snapshot.wallColors = m_wallColors;
+    snapshot.wallsRevision = m_wallsRevision;
+  }
+}
+
+uint64_t BulletManager::ComputeStateHash() const
+{
+  uint64_t hash = HashOffsetBasis;
+  hash = HashBytes(hash, &m_tick, sizeof(m_tick));
+
+  const size_t count = m_bullets.Size();
+  hash = HashBytes(hash, &count, sizeof(count));
+  hash = HashBytes(hash, m_bullets.positionX.data(), count * sizeof(float));
+  hash = HashBytes(hash, m_bullets.positionY.data(), count * sizeof(float));
+  hash = HashBytes(hash, m_bullets.velocityX.data(), count * sizeof(float));
+  hash = HashBytes(hash, m_bullets.velocityY.data(), count * sizeof(float));
+  hash = HashBytes(hash, m_bullets.deathTick.data(), count * sizeof(uint32_t));
+
+  for (const Segment &wall : m_walls)
+  {
+    const float values[] = { wall.p0.x, wall.p0.y, wall.p1.x, wall.p1.y, wall.thickness };
+    hash = HashBytes(hash, values, sizeof(values));
+  }
+  return hash;
 }
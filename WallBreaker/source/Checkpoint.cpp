@@ -0,0 +1,394 @@
+#include "BulletManager.hpp"
+#include "Checkpoint.hpp"
+#include "MappedFile.hpp"
+#include "Profiler.hpp"
+
+#include <cstring>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+
+namespace
+{
+struct SectionSource
+{
+  const void *data;
+  size_t size;
+};
+
+template<typename T>
+SectionSource GetSource(const std::vector<T> &values)
+{
+  static_assert(std::is_trivially_copyable_v<T>, "sections are copied byte by byte");
+  return { values.data(), values.size() * sizeof(T) };
+}
+
+size_t AlignSection(size_t offset)
+{
+  return (offset + CheckpointSectionAlignment - 1) & ~(CheckpointSectionAlignment - 1);
+}
+
+template<typename T>
+std::vector<uint32_t> GetBucketSizes(const TimingWheel<T> &wheel)
+{
+  std::vector<uint32_t> sizes(TimingWheel<T>::BucketsCount);
+  for (size_t i = 0; i < sizes.size(); ++i)
+    sizes[i] = static_cast<uint32_t>(wheel.GetBucket(i).size());
+  return sizes;
+}
+
+template<typename T>
+void CopyBuckets(const TimingWheel<T> &wheel, uint8_t *out)
+{
+  for (size_t i = 0; i < TimingWheel<T>::BucketsCount; ++i)
+  {
+    const auto &bucket = wheel.GetBucket(i);
+    if (bucket.empty())
+      continue;
+    const size_t size = bucket.size() * sizeof(bucket[0]);
+    std::memcpy(out, bucket.data(), size);
+    out += size;
+  }
+}
+
+// Reads a section in place, the mapping is page aligned and every section is aligned within the file
+template<typename T>
+const T *GetSectionData(const MappedFile &file, const CheckpointHeader &header, CheckpointSection section)
+{
+  return reinterpret_cast<const T *>(file.GetData() + header.sections[static_cast<size_t>(section)].offset);
+}
+
+template<typename T>
+size_t GetSectionCount(const CheckpointHeader &header, CheckpointSection section)
+{
+  return header.sections[static_cast<size_t>(section)].size / sizeof(T);
+}
+
+template<typename T>
+void AssignSection(std::vector<T> &values, const MappedFile &file, const CheckpointHeader &header,
+  CheckpointSection section)
+{
+  const T *first = GetSectionData<T>(file, header, section);
+  values.assign(first, first + GetSectionCount<T>(header, section));
+}
+
+template<typename T>
+bool HasSize(const CheckpointHeader &header, CheckpointSection section, uint64_t count)
+{
+  return header.sections[static_cast<size_t>(section)].size == count * sizeof(T);
+}
+
+template<typename T>
+bool HasWholeElements(const CheckpointHeader &header, CheckpointSection section)
+{
+  return header.sections[static_cast<size_t>(section)].size % sizeof(T) == 0;
+}
+
+// Bucket sizes have to add up to the amount of entries
+template<typename T>
+bool AreBucketsValid(const MappedFile &file, const CheckpointHeader &header, CheckpointSection sizesSection,
+  CheckpointSection entriesSection)
+{
+  if (!HasSize<uint32_t>(header, sizesSection, TimingWheel<T>::BucketsCount))
+    return false;
+
+  const uint32_t *sizes = GetSectionData<uint32_t>(file, header, sizesSection);
+  uint64_t entriesCount = 0;
+  for (size_t i = 0; i < TimingWheel<T>::BucketsCount; ++i)
+    entriesCount += sizes[i];
+  return HasSize<typename TimingWheel<T>::Entry>(header, entriesSection, entriesCount);
+}
+
+// Chunk indices and the cells within the chunks index arrays sized from the header, they are checked like sizes.
+// Walls which weren't streamed have no chunk.
+bool AreChunkEntriesValid(const MappedFile &file, const CheckpointHeader &header)
+{
+  const uint64_t cellsCount = uint64_t{ header.streamedWallsRatio } * header.streamedWallsRatio;
+  auto isValid = [&](const WallOrigin &origin, bool allowNoChunk) {
+    if (allowNoChunk && origin.chunk == InvalidChunk)
+      return true;
+    return origin.chunk < header.chunksCount && origin.index < cellsCount;
+  };
+
+  const uint32_t *loaded = GetSectionData<uint32_t>(file, header, CheckpointSection::LoadedChunks);
+  for (size_t i = 0; i < GetSectionCount<uint32_t>(header, CheckpointSection::LoadedChunks); ++i)
+  {
+    if (loaded[i] >= header.chunksCount)
+      return false;
+  }
+
+  const WallOrigin *destroyed = GetSectionData<WallOrigin>(file, header, CheckpointSection::DestroyedWalls);
+  for (size_t i = 0; i < GetSectionCount<WallOrigin>(header, CheckpointSection::DestroyedWalls); ++i)
+  {
+    if (!isValid(destroyed[i], false))
+      return false;
+  }
+
+  const WallOrigin *origins = GetSectionData<WallOrigin>(file, header, CheckpointSection::WallOrigins);
+  for (size_t i = 0; i < GetSectionCount<WallOrigin>(header, CheckpointSection::WallOrigins); ++i)
+  {
+    if (!isValid(origins[i], true))
+      return false;
+  }
+  return true;
+}
+
+template<typename T>
+void RestoreWheel(TimingWheel<T> &wheel, uint32_t nextTick, const MappedFile &file, const CheckpointHeader &header,
+  CheckpointSection sizesSection, CheckpointSection entriesSection)
+{
+  wheel.Restore(nextTick,
+    GetSectionData<uint32_t>(file, header, sizesSection),
+    GetSectionData<typename TimingWheel<T>::Entry>(file, header, entriesSection));
+}
+}// namespace
+
+bool BulletManager::SaveCheckpoint(const std::string &path) const
+{
+  WB_PROFILE_SCOPE("SaveCheckpoint");
+
+  // Walls are compacted at the end of every step, dead ones exist only in the middle of a step
+  if (m_deadWallsCount > 0)
+    return false;
+
+  std::ostringstream randomState;
+  randomState << m_randomGenerator;
+  const std::string randomText = randomState.str();
+
+  std::vector<WallOrigin> destroyedWalls;
+  m_chunks.ForEachDestroyed(
+    [&destroyedWalls](uint32_t chunk, uint32_t index) { destroyedWalls.push_back({ chunk, index }); });
+  // Chunks are configured only once streaming starts
+  const bool streaming = m_streamedWallsRatio != 0;
+
+  const std::vector<uint32_t> expiryBucketSizes = GetBucketSizes(m_expiryWheel);
+  const std::vector<uint32_t> stagedBucketSizes = GetBucketSizes(m_stagedSpawns);
+
+  SectionSource sources[CheckpointSectionsCount]{};
+  auto setSource = [&sources](CheckpointSection section, SectionSource source) {
+    sources[static_cast<size_t>(section)] = source;
+  };
+  setSource(CheckpointSection::PositionX, GetSource(m_bullets.positionX));
+  setSource(CheckpointSection::PositionY, GetSource(m_bullets.positionY));
+  setSource(CheckpointSection::VelocityX, GetSource(m_bullets.velocityX));
+  setSource(CheckpointSection::VelocityY, GetSource(m_bullets.velocityY));
+  setSource(CheckpointSection::Radius, GetSource(m_bullets.radius));
+  setSource(CheckpointSection::Mass, GetSource(m_bullets.mass));
+  setSource(CheckpointSection::PreviousPositionX, GetSource(m_bullets.previousPositionX));
+  setSource(CheckpointSection::PreviousPositionY, GetSource(m_bullets.previousPositionY));
+  setSource(CheckpointSection::SpawnTick, GetSource(m_bullets.spawnTick));
+  setSource(CheckpointSection::DeathTick, GetSource(m_bullets.deathTick));
+  setSource(CheckpointSection::HandleSlot, GetSource(m_bullets.handleSlot));
+  setSource(CheckpointSection::RestingSteps, GetSource(m_bullets.restingSteps));
+  setSource(CheckpointSection::BulletColors, GetSource(m_bulletColors));
+  setSource(CheckpointSection::HandleSlots, GetSource(m_bullets.handleSlots));
+  setSource(CheckpointSection::FreeHandleSlots, GetSource(m_bullets.freeHandleSlots));
+  setSource(CheckpointSection::ExpiryBucketSizes, GetSource(expiryBucketSizes));
+  // Entries of the wheels are gathered from their buckets below
+  setSource(CheckpointSection::ExpiryEntries,
+    { nullptr, m_expiryWheel.Size() * sizeof(TimingWheel<BulletHandle>::Entry) });
+  setSource(CheckpointSection::StagedBucketSizes, GetSource(stagedBucketSizes));
+  setSource(CheckpointSection::StagedEntries,
+    { nullptr, m_stagedSpawns.Size() * sizeof(TimingWheel<SpawnRequest>::Entry) });
+  setSource(CheckpointSection::Walls, GetSource(m_walls));
+  setSource(CheckpointSection::WallColors, GetSource(m_wallColors));
+  setSource(CheckpointSection::WallIds, GetSource(m_wallIds));
+  setSource(CheckpointSection::WallOrigins, GetSource(m_wallOrigins));
+  if (streaming)
+  {
+    setSource(CheckpointSection::ChunkTouchTicks, GetSource(m_chunks.GetTouchTicks()));
+    setSource(CheckpointSection::LoadedChunks, GetSource(m_chunks.GetLoadedChunks()));
+    setSource(CheckpointSection::DestroyedWalls, GetSource(destroyedWalls));
+  }
+  setSource(CheckpointSection::RandomState, { randomText.data(), randomText.size() });
+
+  CheckpointHeader header{};
+  std::memcpy(header.magic, CheckpointMagic, sizeof(header.magic));
+  header.version = CheckpointVersion;
+  header.byteOrderMark = CheckpointByteOrderMark;
+  header.headerSize = sizeof(CheckpointHeader);
+  header.viewportWidth = m_viewportWidth;
+  header.viewportHeight = m_viewportHeight;
+  header.fixedDeltaTime = m_fixedDeltaTime;
+  header.substeps = m_substeps;
+  header.tick = m_tick;
+  header.processBulletsCollision = m_processBulletsCollision;
+  header.sleeping = m_sleepingEnabled;
+  header.wallStreaming = m_wallStreaming;
+  header.bulletsCount = m_bullets.Size();
+  header.awakeCount = m_awakeCount;
+  header.wallsCount = m_walls.size();
+  header.wallIdsCount = m_wallSlots.size();
+  header.expiryNextTick = m_expiryWheel.GetNextTick();
+  header.stagedNextTick = m_stagedSpawns.GetNextTick();
+  header.streamedWallsRatio = m_streamedWallsRatio;
+  header.streamedWallsSeed = m_streamedWallsSeed;
+  header.chunksCount = streaming ? m_chunks.GetNumberOfChunks() : 0;
+
+  size_t offset = AlignSection(sizeof(CheckpointHeader));
+  for (size_t i = 0; i < CheckpointSectionsCount; ++i)
+  {
+    header.sections[i] = { offset, sources[i].size };
+    offset = AlignSection(offset + sources[i].size);
+  }
+  header.fileSize = offset;
+
+  // The file is allocated up front and every array is copied straight into the mapping
+  MappedFile file;
+  if (!file.Create(path, offset))
+    return false;
+
+  uint8_t *data = file.GetData();
+  std::memcpy(data, &header, sizeof(header));
+  for (size_t i = 0; i < CheckpointSectionsCount; ++i)
+  {
+    if (sources[i].size > 0 && sources[i].data)
+      std::memcpy(data + header.sections[i].offset, sources[i].data, sources[i].size);
+  }
+  CopyBuckets(m_expiryWheel, data + header.sections[static_cast<size_t>(CheckpointSection::ExpiryEntries)].offset);
+  CopyBuckets(m_stagedSpawns, data + header.sections[static_cast<size_t>(CheckpointSection::StagedEntries)].offset);
+
+  // Errors of the writeback show up only here
+  return file.Flush();
+}
+
+bool BulletManager::LoadCheckpoint(const std::string &path)
+{
+  WB_PROFILE_SCOPE("LoadCheckpoint");
+
+  MappedFile file;
+  if (!file.OpenRead(path) || file.GetSize() < sizeof(CheckpointHeader))
+    return false;
+
+  CheckpointHeader header;
+  std::memcpy(&header, file.GetData(), sizeof(header));
+  if (std::memcmp(header.magic, CheckpointMagic, sizeof(header.magic)) != 0 || header.version != CheckpointVersion
+      || header.byteOrderMark != CheckpointByteOrderMark || header.headerSize != sizeof(CheckpointHeader)
+      || header.fileSize != file.GetSize() || header.awakeCount > header.bulletsCount
+      || header.wallsCount > header.wallIdsCount)
+    return false;
+
+  for (const CheckpointSectionRange &range : header.sections)
+  {
+    if (range.offset % CheckpointSectionAlignment != 0 || range.offset > header.fileSize
+        || range.size > header.fileSize - range.offset)
+      return false;
+  }
+
+  // The structure is checked, and so are the indices used to address chunk arrays. Other contents are trusted like
+  // the ones of a replay log.
+  using Section = CheckpointSection;
+  const uint64_t bulletsCount = header.bulletsCount;
+  const uint64_t wallsCount = header.wallsCount;
+  const bool sizesValid = HasSize<float>(header, Section::PositionX, bulletsCount)
+                          && HasSize<float>(header, Section::PositionY, bulletsCount)
+                          && HasSize<float>(header, Section::VelocityX, bulletsCount)
+                          && HasSize<float>(header, Section::VelocityY, bulletsCount)
+                          && HasSize<float>(header, Section::Radius, bulletsCount)
+                          && HasSize<float>(header, Section::Mass, bulletsCount)
+                          && HasSize<float>(header, Section::PreviousPositionX, bulletsCount)
+                          && HasSize<float>(header, Section::PreviousPositionY, bulletsCount)
+                          && HasSize<uint32_t>(header, Section::SpawnTick, bulletsCount)
+                          && HasSize<uint32_t>(header, Section::DeathTick, bulletsCount)
+                          && HasSize<uint32_t>(header, Section::HandleSlot, bulletsCount)
+                          && HasSize<uint8_t>(header, Section::RestingSteps, bulletsCount)
+                          && HasSize<Color>(header, Section::BulletColors, bulletsCount)
+                          && HasWholeElements<BulletStorage::HandleSlot>(header, Section::HandleSlots)
+                          && HasWholeElements<uint32_t>(header, Section::FreeHandleSlots)
+                          && AreBucketsValid<BulletHandle>(file, header, Section::ExpiryBucketSizes, Section::ExpiryEntries)
+                          && AreBucketsValid<SpawnRequest>(file, header, Section::StagedBucketSizes, Section::StagedEntries)
+                          && HasSize<Segment>(header, Section::Walls, wallsCount)
+                          && HasSize<Color>(header, Section::WallColors, wallsCount)
+                          && HasSize<WallId>(header, Section::WallIds, wallsCount)
+                          && HasSize<WallOrigin>(header, Section::WallOrigins, wallsCount)
+                          && HasSize<uint32_t>(header, Section::ChunkTouchTicks, header.chunksCount)
+                          && HasWholeElements<uint32_t>(header, Section::LoadedChunks)
+                          && HasWholeElements<WallOrigin>(header, Section::DestroyedWalls);
+  if (!sizesValid || !AreChunkEntriesValid(file, header))
+    return false;
+
+  // Chunk states are rebuilt aside, so a mismatch leaves the current state untouched
+  WorldChunks chunks;
+  if (header.streamedWallsRatio != 0)
+  {
+    chunks.Configure(DefaultChunkSize, header.viewportWidth, header.viewportHeight);
+    if (chunks.GetNumberOfChunks() != header.chunksCount)
+      return false;
+
+    chunks.Restore(GetSectionData<uint32_t>(file, header, Section::ChunkTouchTicks),
+      GetSectionData<uint32_t>(file, header, Section::LoadedChunks),
+      GetSectionCount<uint32_t>(header, Section::LoadedChunks));
+
+    const WallOrigin *destroyed = GetSectionData<WallOrigin>(file, header, Section::DestroyedWalls);
+    const size_t destroyedCount = GetSectionCount<WallOrigin>(header, Section::DestroyedWalls);
+    for (size_t i = 0; i < destroyedCount; ++i)
+      chunks.MarkDestroyed(destroyed[i].chunk, destroyed[i].index);
+  }
+
+  std::mt19937 randomGenerator;
+  {
+    const CheckpointSectionRange &range = header.sections[static_cast<size_t>(Section::RandomState)];
+    std::istringstream randomState(
+      std::string(reinterpret_cast<const char *>(file.GetData() + range.offset), range.size));
+    randomState >> randomGenerator;
+    if (!randomState)
+      return false;
+  }
+
+  m_viewportWidth = header.viewportWidth;
+  m_viewportHeight = header.viewportHeight;
+  m_fixedDeltaTime = header.fixedDeltaTime;
+  m_substeps = header.substeps > 0 ? header.substeps : 1;
+  m_tick = header.tick;
+  m_processBulletsCollision = header.processBulletsCollision != 0;
+  m_sleepingEnabled = header.sleeping != 0;
+  m_randomGenerator = randomGenerator;
+
+  // Bullets, one bulk copy per array
+  AssignSection(m_bullets.positionX, file, header, Section::PositionX);
+  AssignSection(m_bullets.positionY, file, header, Section::PositionY);
+  AssignSection(m_bullets.velocityX, file, header, Section::VelocityX);
+  AssignSection(m_bullets.velocityY, file, header, Section::VelocityY);
+  AssignSection(m_bullets.radius, file, header, Section::Radius);
+  AssignSection(m_bullets.mass, file, header, Section::Mass);
+  AssignSection(m_bullets.previousPositionX, file, header, Section::PreviousPositionX);
+  AssignSection(m_bullets.previousPositionY, file, header, Section::PreviousPositionY);
+  AssignSection(m_bullets.spawnTick, file, header, Section::SpawnTick);
+  AssignSection(m_bullets.deathTick, file, header, Section::DeathTick);
+  AssignSection(m_bullets.handleSlot, file, header, Section::HandleSlot);
+  AssignSection(m_bullets.restingSteps, file, header, Section::RestingSteps);
+  AssignSection(m_bulletColors, file, header, Section::BulletColors);
+  AssignSection(m_bullets.handleSlots, file, header, Section::HandleSlots);
+  AssignSection(m_bullets.freeHandleSlots, file, header, Section::FreeHandleSlots);
+  m_awakeCount = header.awakeCount;
+  m_wokenBullets.clear();
+  // Boxes kept by the broad phase belong to the bullets replaced here, pairs don't depend on them
+  m_broadPhase->Reset();
+
+  RestoreWheel(m_expiryWheel, header.expiryNextTick, file, header, Section::ExpiryBucketSizes, Section::ExpiryEntries);
+  RestoreWheel(m_stagedSpawns, header.stagedNextTick, file, header, Section::StagedBucketSizes, Section::StagedEntries);
+
+  // Walls, the slots of their ids and the grid index are derived from the arrays
+  AssignSection(m_walls, file, header, Section::Walls);
+  AssignSection(m_wallColors, file, header, Section::WallColors);
+  AssignSection(m_wallIds, file, header, Section::WallIds);
+  AssignSection(m_wallOrigins, file, header, Section::WallOrigins);
+  m_wallStreaming = header.wallStreaming != 0;
+  m_streamedWallsRatio = header.streamedWallsRatio;
+  m_streamedWallsSeed = header.streamedWallsSeed;
+  m_chunks = std::move(chunks);
+  m_wallSlots.assign(header.wallIdsCount, InvalidWallSlot);
+  m_deadWalls.assign((m_walls.size() + 63) / 64, 0);
+  m_deadWallsCount = 0;
+
+  for (size_t i = 0; i < m_walls.size(); ++i)
+  {
+    if (m_wallIds[i] < m_wallSlots.size())
+      m_wallSlots[m_wallIds[i]] = i;
+  }
+  m_wallIndex.Configure(DefaultWallIndexCellSize, m_viewportWidth, m_viewportHeight);
+  m_wallIndex.Insert(0, m_walls.data(), m_walls.size(), m_threadManager);
+  ++m_wallsRevision;
+
+  return true;
+}
@@ -0,0 +1,58 @@
+#include "FrameArena.hpp"
+
+#include <algorithm>
+
+void *FrameArena::Allocate(size_t size, size_t alignment)
+{
+  if (!m_blocks.empty())
+  {
+    Block &block = m_blocks.back();
+    const auto base = reinterpret_cast<uintptr_t>(block.memory.get());
+    const size_t aligned = ((base + m_offset + alignment - 1) & ~(alignment - 1)) - base;
+    if (aligned + size <= block.size)
+    {
+      m_offset = aligned + size;
+      m_peakUsed = std::max(m_peakUsed, m_usedInFullBlocks + m_offset);
+      return block.memory.get() + aligned;
+    }
+    m_usedInFullBlocks += m_offset;
+  }
+
+  // Enough room for the request at any alignment
+  AddBlock(std::max(m_blockSize, size + alignment));
+  return Allocate(size, alignment);
+}
+
+void FrameArena::Reset()
+{
+  // The next step needs at least as much as this one did, so it gets it in a single block
+  if (m_blocks.size() > 1)
+  {
+    size_t total = 0;
+    for (const Block &block : m_blocks)
+      total += block.size;
+    m_blocks.clear();
+    AddBlock(total);
+  }
+
+  m_offset = 0;
+  m_usedInFullBlocks = 0;
+}
+
+FrameArenaStats FrameArena::GetStats() const
+{
+  FrameArenaStats stats;
+  stats.heapAllocations = m_heapAllocations;
+  for (const Block &block : m_blocks)
+    stats.capacity += block.size;
+  stats.used = m_usedInFullBlocks + m_offset;
+  stats.peakUsed = m_peakUsed;
+  return stats;
+}
+
+void FrameArena::AddBlock(size_t size)
+{
+  m_blocks.push_back({ std::make_unique<std::byte[]>(size), size });
+  m_offset = 0;
+  ++m_heapAllocations;
+}
@@ -0,0 +1,122 @@
+#include "FrameWriter.hpp"
+
+#include <cctype>
+
+#if defined(_WIN32)
+#define WB_POPEN _popen
+#define WB_PCLOSE _pclose
+#define WB_POPEN_MODE "wb"
+#else
+#define WB_POPEN popen
+#define WB_PCLOSE pclose
+// Pipes are always binary, glibc rejects the 'b' flag
+#define WB_POPEN_MODE "w"
+#endif
+
+namespace
+{
+// Accepts exactly one %d field with optional zero padding and width, the pattern is given to snprintf
+bool IsFramePattern(const std::string &target)
+{
+  const size_t field = target.find('%');
+  if (field == std::string::npos)
+    return false;
+
+  size_t i = field + 1;
+  while (i < target.size() && std::isdigit(static_cast<unsigned char>(target[i])))
+    ++i;
+  return i < target.size() && target[i] == 'd' && target.find('%', i) == std::string::npos;
+}
+}// namespace
+
+bool FrameWriter::Open(const std::string &target)
+{
+  Close();
+
+  if (target.empty())
+    return false;
+
+  if (target[0] == '|')
+  {
+    m_stream = WB_POPEN(target.c_str() + 1, WB_POPEN_MODE);
+    m_pipe = m_stream != nullptr;
+    return m_pipe;
+  }
+
+  if (target.find('%') != std::string::npos)
+  {
+    if (!IsFramePattern(target))
+      return false;
+    m_pattern = target;
+    return true;
+  }
+
+  m_stream = std::fopen(target.c_str(), "wb");
+  return m_stream != nullptr;
+}
+
+bool FrameWriter::Write(const Color *pixels, unsigned int width, unsigned int height)
+{
+  if (!m_pattern.empty())
+  {
+    if (!WritePpm(pixels, width, height))
+      return false;
+  }
+  else if (!m_stream)
+    return false;
+  else
+  {
+    // Color is laid out as RGBA bytes, the framebuffer goes out as is
+    const size_t count = static_cast<size_t>(width) * height;
+    if (std::fwrite(pixels, sizeof(Color), count, m_stream) != count)
+      return false;
+  }
+
+  ++m_frames;
+  return true;
+}
+
+bool FrameWriter::WritePpm(const Color *pixels, unsigned int width, unsigned int height)
+{
+  char path[1024];
+  const int length = std::snprintf(path, sizeof(path), m_pattern.c_str(), static_cast<int>(m_frames));
+  if (length < 0 || static_cast<size_t>(length) >= sizeof(path))
+    return false;
+
+  std::FILE *file = std::fopen(path, "wb");
+  if (!file)
+    return false;
+
+  bool written = std::fprintf(file, "P6\n%u %u\n255\n", width, height) > 0;
+
+  m_row.resize(static_cast<size_t>(width) * 3);
+  for (unsigned int y = 0; y < height && written; ++y)
+  {
+    const Color *source = pixels + static_cast<size_t>(y) * width;
+    for (unsigned int x = 0; x < width; ++x)
+    {
+      m_row[x * 3 + 0] = source[x].r;
+      m_row[x * 3 + 1] = source[x].g;
+      m_row[x * 3 + 2] = source[x].b;
+    }
+    written = std::fwrite(m_row.data(), 1, m_row.size(), file) == m_row.size();
+  }
+
+  return std::fclose(file) == 0 && written;
+}
+
+void FrameWriter::Close()
+{
+  if (m_stream)
+  {
+    if (m_pipe)
+      WB_PCLOSE(m_stream);
+    else
+      std::fclose(m_stream);
+  }
+
+  m_stream = nullptr;
+  m_pipe = false;
+  m_pattern.clear();
+  m_frames = 0;
+}
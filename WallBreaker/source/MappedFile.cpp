@@ -0,0 +1,164 @@
+#include "MappedFile.hpp"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+namespace
+{
+bool MapView(HANDLE file, size_t size, bool writable, void *&mapping, uint8_t *&data)
+{
+  const auto size64 = static_cast<uint64_t>(size);
+  mapping = CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+    static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64), nullptr);
+  if (!mapping)
+    return false;
+
+  data = static_cast<uint8_t *>(MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size));
+  return data != nullptr;
+}
+}// namespace
+
+bool MappedFile::OpenRead(const std::string &path)
+{
+  Close();
+
+  m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+    FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  LARGE_INTEGER size{};
+  if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size) || size.QuadPart == 0
+      || !MapView(m_file, static_cast<size_t>(size.QuadPart), false, m_mapping, m_data))
+  {
+    Close();
+    return false;
+  }
+
+  m_size = static_cast<size_t>(size.QuadPart);
+  return true;
+}
+
+bool MappedFile::Create(const std::string &path, size_t size)
+{
+  Close();
+
+  m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+    FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (m_file == INVALID_HANDLE_VALUE || size == 0 || !MapView(m_file, size, true, m_mapping, m_data))
+  {
+    Close();
+    return false;
+  }
+
+  m_size = size;
+  return true;
+}
+
+bool MappedFile::Flush()
+{
+  return m_data && FlushViewOfFile(m_data, m_size) && FlushFileBuffers(m_file);
+}
+
+void MappedFile::Close()
+{
+  if (m_data)
+    UnmapViewOfFile(m_data);
+  if (m_mapping)
+    CloseHandle(m_mapping);
+  if (m_file && m_file != INVALID_HANDLE_VALUE)
+    CloseHandle(m_file);
+
+  m_data = nullptr;
+  m_mapping = nullptr;
+  m_file = nullptr;
+  m_size = 0;
+}
+
+#else
+
+bool MappedFile::OpenRead(const std::string &path)
+{
+  Close();
+
+  const int file = open(path.c_str(), O_RDONLY);
+  if (file < 0)
+    return false;
+
+  struct stat info{};
+  if (fstat(file, &info) != 0 || info.st_size <= 0)
+  {
+    close(file);
+    return false;
+  }
+
+  // The mapping keeps the file alive on its own
+  void *data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+  if (data == MAP_FAILED)
+    return false;
+
+  // Everything is read once front to back
+  madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+  madvise(data, static_cast<size_t>(info.st_size), MADV_WILLNEED);
+
+  m_data = static_cast<uint8_t *>(data);
+  m_size = static_cast<size_t>(info.st_size);
+  return true;
+}
+
+bool MappedFile::Create(const std::string &path, size_t size)
+{
+  Close();
+
+  if (size == 0)
+    return false;
+
+  const int file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (file < 0)
+    return false;
+
+  // A sparse file would get its blocks on the first store to every page, and a full disk would raise SIGBUS there
+#if defined(__APPLE__)
+  fstore_t store{ F_ALLOCATEALL, F_PEOFPOSMODE, 0, static_cast<off_t>(size), 0 };
+  const bool reserved = fcntl(file, F_PREALLOCATE, &store) != -1 && ftruncate(file, static_cast<off_t>(size)) == 0;
+#else
+  const bool reserved = posix_fallocate(file, 0, static_cast<off_t>(size)) == 0;
+#endif
+  if (!reserved)
+  {
+    close(file);
+    return false;
+  }
+
+  void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  close(file);
+  if (data == MAP_FAILED)
+    return false;
+
+  m_data = static_cast<uint8_t *>(data);
+  m_size = size;
+  return true;
+}
+
+bool MappedFile::Flush()
+{
+  return m_data && msync(m_data, m_size, MS_SYNC) == 0;
+}
+
+void MappedFile::Close()
+{
+  if (m_data)
+    munmap(m_data, m_size);
+
+  m_data = nullptr;
+  m_size = 0;
+}
+
+#endif
@@ -0,0 +1,340 @@
+#include "Profiler.hpp"
+
+namespace Profiler
+{
+const char *GetCounterName(Counter counter)
+{
+  switch (counter)
+  {
+  case Counter::PairsTested:
+    return "pairs_tested";
+  case Counter::Contacts:
+    return "contacts";
+  case Counter::WallsDestroyed:
+    return "walls_destroyed";
+  case Counter::BulletsSpawned:
+    return "bullets_spawned";
+  case Counter::ChunksLoaded:
+    return "chunks_loaded";
+  default:
+    return "unknown";
+  }
+}
+}// namespace Profiler
+
+#if defined(WB_ENABLE_PROFILER)
+#include "ThreadManager.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+// Scopes kept per thread, the oldest ones are overwritten
+constexpr size_t RingCapacity = 1 << 16;
+constexpr size_t CounterSamplesCapacity = 1 << 14;
+// Distinct scope names aggregated per thread for the summary
+constexpr size_t MaxScopeNames = 64;
+constexpr size_t CountersCount = static_cast<size_t>(Profiler::Counter::Count);
+
+struct ScopeEvent
+{
+  const char *name;
+  uint64_t begin;
+  uint64_t end;
+};
+
+// Totals don't depend on the ring capacity, long sessions are summarised completely
+struct ScopeStats
+{
+  const char *name = nullptr;
+  uint64_t calls = 0;
+  uint64_t totalNs = 0;
+  uint64_t maxNs = 0;
+};
+
+struct CounterSample
+{
+  uint64_t time;
+  uint64_t values[CountersCount];
+};
+
+// Written only by its own thread, so recording takes no locks
+struct ThreadBuffer
+{
+  uint32_t id = 0;
+  std::string name;
+  std::vector<ScopeEvent> events;
+  uint64_t written = 0;
+  std::array<ScopeStats, MaxScopeNames> scopes{};
+  // Read by SampleCounters from the stepping thread while workers sleep between tasks
+  std::array<std::atomic<uint64_t>, CountersCount> counters{};
+};
+
+struct Registry
+{
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+  std::vector<CounterSample> samples;
+  uint64_t samplesWritten = 0;
+};
+
+Registry &GetRegistry()
+{
+  static Registry registry;
+  return registry;
+}
+
+const std::chrono::steady_clock::time_point &GetEpoch()
+{
+  static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+  return epoch;
+}
+
+ThreadBuffer &GetThreadBuffer()
+{
+  // Buffers are never released, threads may end before the trace is written
+  thread_local ThreadBuffer *threadBuffer = nullptr;
+  if (threadBuffer)
+    return *threadBuffer;
+
+  auto buffer = std::make_unique<ThreadBuffer>();
+  buffer->events.resize(RingCapacity);
+
+  Registry &registry = GetRegistry();
+  std::lock_guard lock(registry.mutex);
+  buffer->id = static_cast<uint32_t>(registry.buffers.size());
+  const size_t poolIndex = ThreadManager::GetThreadIndex();
+  buffer->name = poolIndex > 0 ? "worker " + std::to_string(poolIndex) : "thread " + std::to_string(buffer->id);
+  threadBuffer = buffer.get();
+  registry.buffers.push_back(std::move(buffer));
+  return *threadBuffer;
+}
+
+double ToMicroseconds(uint64_t ns)
+{
+  return static_cast<double>(ns) * 1e-3;
+}
+}// namespace
+
+namespace Profiler
+{
+uint64_t Now()
+{
+  const auto elapsed = std::chrono::steady_clock::now() - GetEpoch();
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+void RecordScope(const char *name, uint64_t begin, uint64_t end)
+{
+  ThreadBuffer &buffer = GetThreadBuffer();
+  buffer.events[buffer.written % RingCapacity] = { name, begin, end };
+  ++buffer.written;
+
+  // A handful of names per thread, a linear search over pointers is the cheapest lookup
+  const uint64_t duration = end - begin;
+  for (ScopeStats &stats : buffer.scopes)
+  {
+    if (stats.name != name && stats.name != nullptr)
+      continue;
+    stats.name = name;
+    ++stats.calls;
+    stats.totalNs += duration;
+    stats.maxNs = std::max(stats.maxNs, duration);
+    return;
+  }
+}
+
+void AddCount(Counter counter, uint64_t value)
+{
+  std::atomic<uint64_t> &total = GetThreadBuffer().counters[static_cast<size_t>(counter)];
+  // Single writer, no read-modify-write needed
+  total.store(total.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+uint64_t GetCount(Counter counter)
+{
+  Registry &registry = GetRegistry();
+  std::lock_guard lock(registry.mutex);
+
+  uint64_t total = 0;
+  for (const auto &buffer : registry.buffers)
+    total += buffer->counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+  return total;
+}
+
+void SampleCounters()
+{
+  CounterSample sample{};
+  sample.time = Now();
+
+  Registry &registry = GetRegistry();
+  std::lock_guard lock(registry.mutex);
+  for (const auto &buffer : registry.buffers)
+  {
+    for (size_t i = 0; i < CountersCount; ++i)
+      sample.values[i] += buffer->counters[i].load(std::memory_order_relaxed);
+  }
+
+  if (registry.samples.size() < CounterSamplesCapacity)
+    registry.samples.push_back(sample);
+  else
+    registry.samples[registry.samplesWritten % CounterSamplesCapacity] = sample;
+  ++registry.samplesWritten;
+}
+
+void Reset()
+{
+  Registry &registry = GetRegistry();
+  std::lock_guard lock(registry.mutex);
+  for (const auto &buffer : registry.buffers)
+  {
+    buffer->written = 0;
+    buffer->scopes.fill({});
+    for (auto &counter : buffer->counters)
+      counter.store(0, std::memory_order_relaxed);
+  }
+  registry.samples.clear();
+  registry.samplesWritten = 0;
+}
+
+bool WriteChromeTrace(const std::string &path)
+{
+  std::FILE *file = std::fopen(path.c_str(), "w");
+  if (!file)
+    return false;
+
+  Registry &registry = GetRegistry();
+  std::lock_guard lock(registry.mutex);
+
+  std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  const char *separator = "";
+
+  for (const auto &buffer : registry.buffers)
+  {
+    std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+      separator, buffer->id, buffer->name.c_str());
+    separator = ",\n";
+
+    // Only the last RingCapacity scopes survive, in recording order
+    const uint64_t first = buffer->written > RingCapacity ? buffer->written - RingCapacity : 0;
+    for (uint64_t i = first; i < buffer->written; ++i)
+    {
+      const ScopeEvent &event = buffer->events[i % RingCapacity];
+      std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", separator,
+        event.name, buffer->id, ToMicroseconds(event.begin), ToMicroseconds(event.end - event.begin));
+    }
+  }
+
+  const uint64_t firstSample =
+    registry.samplesWritten > CounterSamplesCapacity ? registry.samplesWritten - CounterSamplesCapacity : 0;
+  for (uint64_t i = firstSample; i < registry.samplesWritten; ++i)
+  {
+    const CounterSample &sample = registry.samples[i % CounterSamplesCapacity];
+    std::fprintf(file, "%s{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{", separator,
+      ToMicroseconds(sample.time));
+    for (size_t c = 0; c < CountersCount; ++c)
+    {
+      std::fprintf(file, "%s\"%s\":%llu", c > 0 ? "," : "", GetCounterName(static_cast<Counter>(c)),
+        static_cast<unsigned long long>(sample.values[c]));
+    }
+    std::fprintf(file, "}}");
+    separator = ",\n";
+  }
+
+  std::fprintf(file, "\n]}\n");
+  return std::fclose(file) == 0;
+}
+
+bool WriteSummaryCsv(const std::string &path)
+{
+  std::FILE *file = std::fopen(path.c_str(), "w");
+  if (!file)
+    return false;
+
+  Registry &registry = GetRegistry();
+  std::lock_guard lock(registry.mutex);
+
+  // Phases of all threads are merged by name, in the order they were first seen
+  std::vector<ScopeStats> phases;
+  for (const auto &buffer : registry.buffers)
+  {
+    for (const ScopeStats &stats : buffer->scopes)
+    {
+      if (!stats.name)
+        break;
+
+      auto phase = std::find_if(phases.begin(), phases.end(),
+        [&](const ScopeStats &other) { return std::strcmp(other.name, stats.name) == 0; });
+      if (phase == phases.end())
+      {
+        phases.push_back(stats);
+        continue;
+      }
+      phase->calls += stats.calls;
+      phase->totalNs += stats.totalNs;
+      phase->maxNs = std::max(phase->maxNs, stats.maxNs);
+    }
+  }
+
+  // Times are inclusive of nested phases
+  std::fprintf(file, "kind,name,calls,total_ms,mean_us,max_us\n");
+  for (const ScopeStats &phase : phases)
+  {
+    std::fprintf(file, "phase,%s,%llu,%.3f,%.3f,%.3f\n", phase.name, static_cast<unsigned long long>(phase.calls),
+      static_cast<double>(phase.totalNs) * 1e-6, ToMicroseconds(phase.totalNs) / phase.calls,
+      ToMicroseconds(phase.maxNs));
+  }
+
+  for (size_t c = 0; c < CountersCount; ++c)
+  {
+    uint64_t total = 0;
+    for (const auto &buffer : registry.buffers)
+      total += buffer->counters[c].load(std::memory_order_relaxed);
+    std::fprintf(file, "counter,%s,%llu,,,\n", GetCounterName(static_cast<Counter>(c)),
+      static_cast<unsigned long long>(total));
+  }
+
+  return std::fclose(file) == 0;
+}
+}// namespace Profiler
+#else
+// Built without the profiler: nothing is recorded and nothing can be written
+namespace Profiler
+{
+uint64_t Now()
+{
+  return 0;
+}
+
+void RecordScope(const char *, uint64_t, uint64_t) {}
+
+void AddCount(Counter, uint64_t) {}
+
+uint64_t GetCount(Counter)
+{
+  return 0;
+}
+
+void SampleCounters() {}
+
+void Reset() {}
+
+bool WriteChromeTrace(const std::string &)
+{
+  return false;
+}
+
+bool WriteSummaryCsv(const std::string &)
+{
+  return false;
+}
+}// namespace Profiler
+#endif
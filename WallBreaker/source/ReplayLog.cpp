@@ -0,0 +1,246 @@
+#include "ReplayLog.hpp"
+
+#include <cstring>
+
+namespace
+{
+// Events are written in blocks of this size
+constexpr size_t RecorderBufferSize = 1 << 16;
+}// namespace
+
+ReplayRecorder::~ReplayRecorder()
+{
+  if (m_file)
+  {
+    Flush();
+    std::fclose(m_file);
+  }
+}
+
+bool ReplayRecorder::Open(const std::string &path, const ReplayHeader &header)
+{
+  if (m_file)
+    return false;
+
+  m_file = std::fopen(path.c_str(), "wb");
+  if (!m_file)
+    return false;
+
+  m_buffer.reserve(RecorderBufferSize);
+  m_lastTick = 0;
+
+  // Plain native layout, logs are meant to be replayed on the same kind of machine they were recorded on
+  Write(ReplayLogMagic, sizeof(ReplayLogMagic));
+  Write(&ReplayLogVersion, sizeof(ReplayLogVersion));
+  Write(&header.worldWidth, sizeof(header.worldWidth));
+  Write(&header.worldHeight, sizeof(header.worldHeight));
+  Write(&header.fixedDeltaTime, sizeof(header.fixedDeltaTime));
+  Write(&header.substeps, sizeof(header.substeps));
+  Write(&header.processBulletsCollision, sizeof(header.processBulletsCollision));
+  Write(&header.sleeping, sizeof(header.sleeping));
+  Write(&header.wallStreaming, sizeof(header.wallStreaming));
+  return true;
+}
+
+void ReplayRecorder::Record(const ReplayEvent &event)
+{
+  if (!m_file)
+    return;
+
+  const auto type = static_cast<uint8_t>(event.type);
+  Write(&type, sizeof(type));
+  WriteVarint(event.tick - m_lastTick);
+  m_lastTick = event.tick;
+
+  switch (event.type)
+  {
+  case ReplayEventType::Spawn:
+    Write(&event.spawn.position.x, sizeof(float));
+    Write(&event.spawn.position.y, sizeof(float));
+    Write(&event.spawn.velocity.x, sizeof(float));
+    Write(&event.spawn.velocity.y, sizeof(float));
+    Write(&event.spawn.lifetime, sizeof(float));
+    Write(&event.spawn.radius, sizeof(float));
+    break;
+  case ReplayEventType::GenerateWalls:
+    WriteVarint(event.wallsRatio);
+    Write(&event.wallsSeed, sizeof(event.wallsSeed));
+    break;
+  default:
+    break;
+  }
+
+  if (m_buffer.size() >= RecorderBufferSize)
+    Flush();
+}
+
+void ReplayRecorder::Close(uint32_t endTick)
+{
+  if (!m_file)
+    return;
+
+  ReplayEvent end;
+  end.tick = endTick;
+  end.type = ReplayEventType::End;
+  Record(end);
+
+  Flush();
+  std::fclose(m_file);
+  m_file = nullptr;
+}
+
+void ReplayRecorder::Write(const void *data, size_t size)
+{
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+}
+
+void ReplayRecorder::WriteVarint(uint32_t value)
+{
+  while (value >= 0x80)
+  {
+    m_buffer.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  m_buffer.push_back(static_cast<uint8_t>(value));
+}
+
+void ReplayRecorder::Flush()
+{
+  if (!m_buffer.empty())
+    std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+  m_buffer.clear();
+}
+
+ReplayReader::~ReplayReader()
+{
+  if (m_file)
+    std::fclose(m_file);
+}
+
+bool ReplayReader::Open(const std::string &path)
+{
+  if (m_file)
+    return false;
+
+  m_file = std::fopen(path.c_str(), "rb");
+  if (!m_file)
+    return false;
+
+  char magic[sizeof(ReplayLogMagic)];
+  const bool headerRead = Read(magic, sizeof(magic)) && Read(&m_version, sizeof(m_version))
+                          && Read(&m_header.worldWidth, sizeof(m_header.worldWidth))
+                          && Read(&m_header.worldHeight, sizeof(m_header.worldHeight))
+                          && Read(&m_header.fixedDeltaTime, sizeof(m_header.fixedDeltaTime))
+                          && Read(&m_header.substeps, sizeof(m_header.substeps))
+                          && Read(&m_header.processBulletsCollision, sizeof(m_header.processBulletsCollision))
+                          && Read(&m_header.sleeping, sizeof(m_header.sleeping))
+                          && Read(&m_header.wallStreaming, sizeof(m_header.wallStreaming));
+
+  if (!headerRead || std::memcmp(magic, ReplayLogMagic, sizeof(magic)) != 0 || m_version < ReplayLogMinVersion
+      || m_version > ReplayLogVersion)
+  {
+    std::fclose(m_file);
+    m_file = nullptr;
+    return false;
+  }
+
+  m_lastTick = 0;
+  m_hasPending = false;
+  return true;
+}
+
+void ReplayReader::Configure(BulletManager &bulletManager) const
+{
+  bulletManager.SetViewportWidth(m_header.worldWidth);
+  bulletManager.SetViewportHeight(m_header.worldHeight);
+  bulletManager.SetFixedDeltaTime(m_header.fixedDeltaTime);
+  bulletManager.SetSubsteps(m_header.substeps);
+  if (bulletManager.IsProcessingBulletsCollision() != (m_header.processBulletsCollision != 0))
+    bulletManager.ToggleProcessBulletsCollision();
+  bulletManager.SetSleepingEnabled(m_header.sleeping != 0);
+  bulletManager.SetWallStreaming(m_header.wallStreaming != 0);
+}
+
+bool ReplayReader::ApplyEvents(BulletManager &bulletManager)
+{
+  const uint32_t tick = bulletManager.GetTick();
+  for (;;)
+  {
+    // A log cut short (the recording process died) simply ends at its last event
+    if (!m_hasPending && !ReadEvent(m_pending))
+      return false;
+    m_hasPending = true;
+
+    if (m_pending.tick > tick)
+      return true;
+
+    switch (m_pending.type)
+    {
+    case ReplayEventType::Spawn:
+      bulletManager.Spawn(m_pending.spawn);
+      break;
+    case ReplayEventType::GenerateWalls:
+      bulletManager.GenerateNewWalls(m_pending.wallsRatio, m_pending.wallsSeed);
+      break;
+    case ReplayEventType::RemoveAllWalls:
+      bulletManager.RemoveAllWalls();
+      break;
+    case ReplayEventType::ToggleBulletsCollision:
+      bulletManager.ToggleProcessBulletsCollision();
+      break;
+    case ReplayEventType::End:
+      return false;
+    }
+    m_hasPending = false;
+  }
+}
+
+bool ReplayReader::ReadEvent(ReplayEvent &event)
+{
+  uint8_t type = 0;
+  uint32_t tickDelta = 0;
+  if (!m_file || !Read(&type, sizeof(type)) || !ReadVarint(tickDelta))
+    return false;
+
+  event.type = static_cast<ReplayEventType>(type);
+  event.tick = m_lastTick + tickDelta;
+  m_lastTick = event.tick;
+
+  switch (event.type)
+  {
+  case ReplayEventType::Spawn:
+    return Read(&event.spawn.position.x, sizeof(float)) && Read(&event.spawn.position.y, sizeof(float))
+           && Read(&event.spawn.velocity.x, sizeof(float)) && Read(&event.spawn.velocity.y, sizeof(float))
+           && Read(&event.spawn.lifetime, sizeof(float)) && Read(&event.spawn.radius, sizeof(float));
+  case ReplayEventType::GenerateWalls:
+    return ReadVarint(event.wallsRatio) && Read(&event.wallsSeed, sizeof(event.wallsSeed));
+  case ReplayEventType::RemoveAllWalls:
+  case ReplayEventType::ToggleBulletsCollision:
+  case ReplayEventType::End:
+    return true;
+  }
+
+  // Unknown event type, the rest of the log can't be parsed
+  return false;
+}
+
+bool ReplayReader::Read(void *data, size_t size)
+{
+  return std::fread(data, 1, size, m_file) == size;
+}
+
+bool ReplayReader::ReadVarint(uint32_t &value)
+{
+  value = 0;
+  for (uint32_t shift = 0; shift < 35; shift += 7)
+  {
+    uint8_t byte = 0;
+    if (!Read(&byte, sizeof(byte)))
+      return false;
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
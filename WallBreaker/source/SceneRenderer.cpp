@@ -0,0 +1,141 @@
+#include "SceneRenderer.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Amount of bullets written by a single parallel task
+constexpr size_t VerticesGrain = 8192;
+}// namespace
+
+void SceneRenderer::CreateResources()
+{
+  m_resourcesCreated = true;
+  m_useWallsBuffer = sf::VertexBuffer::isAvailable();
+
+  sf::Image image;
+  image.create(BulletTextureSize, BulletTextureSize, sf::Color::Transparent);
+
+  const float center = BulletTextureSize * 0.5f;
+  for (unsigned int y = 0; y < BulletTextureSize; ++y)
+  {
+    for (unsigned int x = 0; x < BulletTextureSize; ++x)
+    {
+      const float dx = x + 0.5f - center;
+      const float dy = y + 0.5f - center;
+      // One texel wide antialiased edge
+      const float coverage = std::clamp(center - std::sqrt(dx * dx + dy * dy), 0.0f, 1.0f);
+      image.setPixel(x, y, sf::Color(255, 255, 255, static_cast<sf::Uint8>(coverage * 255.0f)));
+    }
+  }
+
+  m_bulletTexture.loadFromImage(image);
+  m_bulletTexture.setSmooth(true);
+}
+
+void SceneRenderer::DrawBullets(const RenderSnapshot &snapshot, float alpha)
+{
+  WB_PROFILE_SCOPE("DrawBullets");
+
+  if (!m_target)
+    return;
+  if (!m_resourcesCreated)
+    CreateResources();
+
+  const size_t count = snapshot.GetNumberOfBullets();
+  m_bulletVertices.resize(count * 4);
+  if (count == 0)
+    return;
+
+  const float *posX = snapshot.positionX.data();
+  const float *posY = snapshot.positionY.data();
+  const float *prevX = snapshot.previousPositionX.data();
+  const float *prevY = snapshot.previousPositionY.data();
+  const float *radius = snapshot.radius.data();
+  const Color *colors = snapshot.bulletColors.data();
+  sf::Vertex *vertices = &m_bulletVertices[0];
+
+  const auto textureSize = static_cast<float>(BulletTextureSize);
+  ParallelFor(m_threadManager, 0, count, VerticesGrain, [&](size_t begin, size_t end, size_t) {
+    for (size_t i = begin; i < end; ++i)
+    {
+      const float x = InterpolateCoordinate(prevX[i], posX[i], alpha);
+      const float y = InterpolateCoordinate(prevY[i], posY[i], alpha);
+
+      const float minX = x - radius[i];
+      const float minY = y - radius[i];
+      const float maxX = x + radius[i];
+      const float maxY = y + radius[i];
+
+      const sf::Color color = ToSfColor(colors[i]);
+      sf::Vertex *quad = vertices + i * 4;
+      quad[0] = sf::Vertex({ minX, minY }, color, { 0.0f, 0.0f });
+      quad[1] = sf::Vertex({ maxX, minY }, color, { textureSize, 0.0f });
+      quad[2] = sf::Vertex({ maxX, maxY }, color, { textureSize, textureSize });
+      quad[3] = sf::Vertex({ minX, maxY }, color, { 0.0f, textureSize });
+    }
+  });
+
+  m_target->draw(m_bulletVertices, sf::RenderStates(&m_bulletTexture));
+}
+
+void SceneRenderer::DrawWalls(const RenderSnapshot &snapshot)
+{
+  WB_PROFILE_SCOPE("DrawWalls");
+
+  if (!m_target)
+    return;
+  if (!m_resourcesCreated)
+    CreateResources();
+
+  const std::vector<Segment> &walls = snapshot.walls;
+  if (snapshot.wallsRevision != m_wallsRevision)
+  {
+    RebuildWalls(walls, snapshot.wallColors);
+    m_wallsRevision = snapshot.wallsRevision;
+  }
+
+  if (walls.empty())
+    return;
+
+  // The buffer could be larger than needed after walls were destroyed
+  if (m_useWallsBuffer)
+    m_target->draw(m_wallsBuffer, 0, walls.size() * SegmentVerticesNumber);
+  else
+    m_target->draw(m_wallsVertices);
+}
+
+void SceneRenderer::RebuildWalls(const std::vector<Segment> &walls, const std::vector<Color> &colors)
+{
+  // A million walls take four million vertices, quads are built in parallel
+  m_wallsScratch.resize(walls.size() * SegmentVerticesNumber);
+  ParallelFor(m_threadManager, 0, walls.size(), VerticesGrain, [&](size_t begin, size_t end, size_t) {
+    for (size_t i = begin; i < end; ++i)
+    {
+      const Segment &wall = walls[i];
+      BuildSegmentQuad({ wall.p0.x, wall.p0.y },
+        { wall.p1.x, wall.p1.y },
+        ToSfColor(colors[i]),
+        wall.thickness,
+        &m_wallsScratch[i * SegmentVerticesNumber]);
+    }
+  });
+
+  if (m_useWallsBuffer)
+  {
+    // Buffer is recreated only when it's too small, otherwise just updated in place
+    if (m_wallsBuffer.getVertexCount() < m_wallsScratch.size())
+      m_wallsBuffer.create(m_wallsScratch.size());
+    if (!m_wallsScratch.empty())
+      m_wallsBuffer.update(m_wallsScratch.data(), m_wallsScratch.size(), 0);
+    return;
+  }
+
+  m_wallsVertices.resize(m_wallsScratch.size());
+  ParallelFor(m_threadManager, 0, m_wallsScratch.size(), VerticesGrain, [&](size_t begin, size_t end, size_t) {
+    for (size_t i = begin; i < end; ++i)
+      m_wallsVertices[i] = m_wallsScratch[i];
+  });
+}
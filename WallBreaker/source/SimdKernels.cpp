@@ -0,0 +1,262 @@
+#include "SimdKernels.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(WB_SIMD_SSE2)
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace
+{
+bool CpuSupportsAvx2()
+{
+#if !defined(WB_SIMD_AVX2)
+  return false;
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+
+  // The OS has to save YMM registers on context switches
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+    return false;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+Simd::InstructionSet DetectInstructionSet()
+{
+  if (CpuSupportsAvx2())
+    return Simd::InstructionSet::Avx2;
+#if defined(WB_SIMD_SSE2)
+  return Simd::InstructionSet::Sse2;
+#else
+  return Simd::InstructionSet::Scalar;
+#endif
+}
+
+std::atomic<Simd::InstructionSet> &CurrentInstructionSet()
+{
+  static std::atomic<Simd::InstructionSet> instructionSet{ Simd::GetBestInstructionSet() };
+  return instructionSet;
+}
+}// namespace
+
+namespace Simd
+{
+InstructionSet GetBestInstructionSet()
+{
+  static const InstructionSet best = DetectInstructionSet();
+  return best;
+}
+
+InstructionSet GetInstructionSet()
+{
+  return CurrentInstructionSet().load(std::memory_order_relaxed);
+}
+
+void SetInstructionSet(InstructionSet instructionSet)
+{
+  CurrentInstructionSet().store(
+    IsSupported(instructionSet) ? instructionSet : GetBestInstructionSet(), std::memory_order_relaxed);
+}
+
+bool IsSupported(InstructionSet instructionSet)
+{
+  return static_cast<int>(instructionSet) <= static_cast<int>(GetBestInstructionSet());
+}
+
+const char *GetInstructionSetName(InstructionSet instructionSet)
+{
+  switch (instructionSet)
+  {
+  case InstructionSet::Sse2:
+    return "sse2";
+  case InstructionSet::Avx2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+void IntegrateAndWrap(float *posX, float *posY, float *velX, float *velY, size_t count, float deltaTime,
+  float width, float height)
+{
+  switch (GetInstructionSet())
+  {
+#if defined(WB_SIMD_AVX2)
+  case InstructionSet::Avx2:
+    Avx2::IntegrateAndWrap(posX, posY, velX, velY, count, deltaTime, width, height);
+    return;
+#endif
+#if defined(WB_SIMD_SSE2)
+  case InstructionSet::Sse2:
+    Sse2::IntegrateAndWrap(posX, posY, velX, velY, count, deltaTime, width, height);
+    return;
+#endif
+  default:
+    Scalar::IntegrateAndWrap(posX, posY, velX, velY, count, deltaTime, width, height);
+    return;
+  }
+}
+
+uint32_t SegmentsVsCircle(const SegmentsBlock &block, float x, float y, float radius)
+{
+  switch (GetInstructionSet())
+  {
+#if defined(WB_SIMD_AVX2)
+  case InstructionSet::Avx2:
+    return Avx2::SegmentsVsCircle(block, x, y, radius);
+#endif
+#if defined(WB_SIMD_SSE2)
+  case InstructionSet::Sse2:
+    return Sse2::SegmentsVsCircle(block, x, y, radius);
+#endif
+  default:
+    return Scalar::SegmentsVsCircle(block, x, y, radius);
+  }
+}
+
+namespace Scalar
+{
+void IntegrateAndWrap(float *posX, float *posY, float *velX, float *velY, size_t count, float deltaTime,
+  float width, float height)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    posX[i] += velX[i] * deltaTime;
+    posY[i] += velY[i] * deltaTime;
+
+    // Wrap bullets around the screen
+    if (posX[i] < 0)
+      posX[i] += width;
+    if (posX[i] >= width)
+      posX[i] -= width;
+    if (posY[i] < 0)
+      posY[i] += height;
+    if (posY[i] >= height)
+      posY[i] -= height;
+
+    // Clamp velocity near zero
+    if (velX[i] * velX[i] + velY[i] * velY[i] < 0.01f)
+    {
+      velX[i] = 0.0f;
+      velY[i] = 0.0f;
+    }
+  }
+}
+
+uint32_t SegmentsVsCircle(const SegmentsBlock &block, float x, float y, float radius)
+{
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < block.count; ++i)
+  {
+    const float dx = block.p1x[i] - block.p0x[i];
+    const float dy = block.p1y[i] - block.p0y[i];
+    const float len = dx * dx + dy * dy;
+    // Clamping distance between 0 and 1 to handle only segment collision, not the infinite line
+    const float t = std::max(0.0f, std::min(len, dx * (x - block.p0x[i]) + dy * (y - block.p0y[i]))) / len;
+    const float nx = x - (block.p0x[i] + dx * t);
+    const float ny = y - (block.p0y[i] + dy * t);
+    if (std::sqrt(nx * nx + ny * ny) <= radius + block.thickness[i])
+      mask |= 1u << i;
+  }
+  return mask;
+}
+}// namespace Scalar
+
+#if defined(WB_SIMD_SSE2)
+namespace Sse2
+{
+namespace
+{
+// Adding a masked zero instead would turn -0 into +0
+inline __m128 Select(__m128 mask, __m128 ifTrue, __m128 ifFalse)
+{
+  return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+}
+}// namespace
+
+void IntegrateAndWrap(float *posX, float *posY, float *velX, float *velY, size_t count, float deltaTime,
+  float width, float height)
+{
+  const __m128 dt = _mm_set1_ps(deltaTime);
+  const __m128 w = _mm_set1_ps(width);
+  const __m128 h = _mm_set1_ps(height);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 minSpeedSq = _mm_set1_ps(0.01f);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    const __m128 vx = _mm_loadu_ps(velX + i);
+    const __m128 vy = _mm_loadu_ps(velY + i);
+    __m128 px = _mm_add_ps(_mm_loadu_ps(posX + i), _mm_mul_ps(vx, dt));
+    __m128 py = _mm_add_ps(_mm_loadu_ps(posY + i), _mm_mul_ps(vy, dt));
+
+    // Same two sequential corrections as the scalar wrap, selected by masks
+    px = Select(_mm_cmplt_ps(px, zero), _mm_add_ps(px, w), px);
+    px = Select(_mm_cmpge_ps(px, w), _mm_sub_ps(px, w), px);
+    py = Select(_mm_cmplt_ps(py, zero), _mm_add_ps(py, h), py);
+    py = Select(_mm_cmpge_ps(py, h), _mm_sub_ps(py, h), py);
+
+    // Not less, so NaN velocities are kept like in the scalar code
+    const __m128 speedSq = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy));
+    const __m128 moving = _mm_cmpnlt_ps(speedSq, minSpeedSq);
+
+    _mm_storeu_ps(posX + i, px);
+    _mm_storeu_ps(posY + i, py);
+    _mm_storeu_ps(velX + i, _mm_and_ps(vx, moving));
+    _mm_storeu_ps(velY + i, _mm_and_ps(vy, moving));
+  }
+
+  Scalar::IntegrateAndWrap(posX + i, posY + i, velX + i, velY + i, count - i, deltaTime, width, height);
+}
+
+uint32_t SegmentsVsCircle(const SegmentsBlock &block, float x, float y, float radius)
+{
+  const __m128 cx = _mm_set1_ps(x);
+  const __m128 cy = _mm_set1_ps(y);
+  const __m128 r = _mm_set1_ps(radius);
+  const __m128 zero = _mm_setzero_ps();
+
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < block.count; i += 4)
+  {
+    const __m128 p0x = _mm_load_ps(block.p0x + i);
+    const __m128 p0y = _mm_load_ps(block.p0y + i);
+    const __m128 dx = _mm_sub_ps(_mm_load_ps(block.p1x + i), p0x);
+    const __m128 dy = _mm_sub_ps(_mm_load_ps(block.p1y + i), p0y);
+
+    const __m128 len = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+    const __m128 projection = _mm_add_ps(_mm_mul_ps(dx, _mm_sub_ps(cx, p0x)), _mm_mul_ps(dy, _mm_sub_ps(cy, p0y)));
+    // Operand order keeps the NaN behaviour of std::max(0, std::min(len, projection))
+    const __m128 t = _mm_div_ps(_mm_max_ps(_mm_min_ps(projection, len), zero), len);
+
+    const __m128 nx = _mm_sub_ps(cx, _mm_add_ps(p0x, _mm_mul_ps(dx, t)));
+    const __m128 ny = _mm_sub_ps(cy, _mm_add_ps(p0y, _mm_mul_ps(dy, t)));
+    const __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)));
+    const __m128 hit = _mm_cmple_ps(distance, _mm_add_ps(r, _mm_load_ps(block.thickness + i)));
+
+    mask |= static_cast<uint32_t>(_mm_movemask_ps(hit)) << i;
+  }
+
+  // Lanes past the end hold whatever was left in the block
+  return mask & ((1u << block.count) - 1);
+}
+}// namespace Sse2
+#endif
+}// namespace Simd
@@ -0,0 +1,72 @@
+#include "SimdKernels.hpp"
+
+// Built with AVX2 code generation, nothing from here runs unless the dispatcher found AVX2 on the CPU
+#if defined(WB_SIMD_AVX2)
+#include <immintrin.h>
+
+namespace Simd
+{
+namespace Avx2
+{
+void IntegrateAndWrap(float *posX, float *posY, float *velX, float *velY, size_t count, float deltaTime,
+  float width, float height)
+{
+  const __m256 dt = _mm256_set1_ps(deltaTime);
+  const __m256 w = _mm256_set1_ps(width);
+  const __m256 h = _mm256_set1_ps(height);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 minSpeedSq = _mm256_set1_ps(0.01f);
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    const __m256 vx = _mm256_loadu_ps(velX + i);
+    const __m256 vy = _mm256_loadu_ps(velY + i);
+    // Separate multiply and add, a fused one would round differently from the scalar code
+    __m256 px = _mm256_add_ps(_mm256_loadu_ps(posX + i), _mm256_mul_ps(vx, dt));
+    __m256 py = _mm256_add_ps(_mm256_loadu_ps(posY + i), _mm256_mul_ps(vy, dt));
+
+    px = _mm256_blendv_ps(px, _mm256_add_ps(px, w), _mm256_cmp_ps(px, zero, _CMP_LT_OQ));
+    px = _mm256_blendv_ps(px, _mm256_sub_ps(px, w), _mm256_cmp_ps(px, w, _CMP_GE_OQ));
+    py = _mm256_blendv_ps(py, _mm256_add_ps(py, h), _mm256_cmp_ps(py, zero, _CMP_LT_OQ));
+    py = _mm256_blendv_ps(py, _mm256_sub_ps(py, h), _mm256_cmp_ps(py, h, _CMP_GE_OQ));
+
+    const __m256 speedSq = _mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy));
+    const __m256 moving = _mm256_cmp_ps(speedSq, minSpeedSq, _CMP_NLT_UQ);
+
+    _mm256_storeu_ps(posX + i, px);
+    _mm256_storeu_ps(posY + i, py);
+    _mm256_storeu_ps(velX + i, _mm256_and_ps(vx, moving));
+    _mm256_storeu_ps(velY + i, _mm256_and_ps(vy, moving));
+  }
+
+  // Leftovers go through the 4 wide kernel and its scalar tail
+  Sse2::IntegrateAndWrap(posX + i, posY + i, velX + i, velY + i, count - i, deltaTime, width, height);
+}
+
+uint32_t SegmentsVsCircle(const SegmentsBlock &block, float x, float y, float radius)
+{
+  const __m256 cx = _mm256_set1_ps(x);
+  const __m256 cy = _mm256_set1_ps(y);
+
+  const __m256 p0x = _mm256_load_ps(block.p0x);
+  const __m256 p0y = _mm256_load_ps(block.p0y);
+  const __m256 dx = _mm256_sub_ps(_mm256_load_ps(block.p1x), p0x);
+  const __m256 dy = _mm256_sub_ps(_mm256_load_ps(block.p1y), p0y);
+
+  const __m256 len = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+  const __m256 projection =
+    _mm256_add_ps(_mm256_mul_ps(dx, _mm256_sub_ps(cx, p0x)), _mm256_mul_ps(dy, _mm256_sub_ps(cy, p0y)));
+  const __m256 t = _mm256_div_ps(_mm256_max_ps(_mm256_min_ps(projection, len), _mm256_setzero_ps()), len);
+
+  const __m256 nx = _mm256_sub_ps(cx, _mm256_add_ps(p0x, _mm256_mul_ps(dx, t)));
+  const __m256 ny = _mm256_sub_ps(cy, _mm256_add_ps(p0y, _mm256_mul_ps(dy, t)));
+  const __m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)));
+  const __m256 reach = _mm256_add_ps(_mm256_set1_ps(radius), _mm256_load_ps(block.thickness));
+  const __m256 hit = _mm256_cmp_ps(distance, reach, _CMP_LE_OQ);
+
+  return static_cast<uint32_t>(_mm256_movemask_ps(hit)) & ((1u << block.count) - 1);
+}
+}// namespace Avx2
+}// namespace Simd
+#endif
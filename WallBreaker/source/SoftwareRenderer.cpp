@@ -0,0 +1,313 @@
+#include "SoftwareRenderer.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Amount of bullets transformed by a single parallel task
+constexpr size_t CirclesGrain = 8192;
+// Binning runs over at most this many chunks of primitives, every chunk keeps a counter per tile
+constexpr size_t MaxBinChunks = 64;
+constexpr size_t MinBinGrain = 4096;
+
+inline float Cross(glm::vec2 a, glm::vec2 b)
+{
+  return a.x * b.y - a.y * b.x;
+}
+
+// Source over blending of the color, scaled by the covered fraction of the pixel
+inline void Blend(Color &destination, Color source, float coverage)
+{
+  const auto alpha = static_cast<uint32_t>(source.a * coverage + 0.5f);
+  if (alpha == 0)
+    return;
+  if (alpha == 255)
+  {
+    destination = source;
+    return;
+  }
+
+  const uint32_t inverse = 255 - alpha;
+  destination.r = static_cast<uint8_t>((source.r * alpha + destination.r * inverse + 127) / 255);
+  destination.g = static_cast<uint8_t>((source.g * alpha + destination.g * inverse + 127) / 255);
+  destination.b = static_cast<uint8_t>((source.b * alpha + destination.b * inverse + 127) / 255);
+  destination.a = static_cast<uint8_t>(alpha + (destination.a * inverse + 127) / 255);
+}
+
+// Pixels whose centre may lie within [min, max], clipped to [begin, end)
+inline void GetPixelRange(float min, float max, uint32_t begin, uint32_t end, uint32_t &first, uint32_t &last)
+{
+  first = static_cast<uint32_t>(std::max(std::floor(min), static_cast<float>(begin)));
+  last = static_cast<uint32_t>(std::clamp(std::ceil(max), static_cast<float>(begin), static_cast<float>(end)));
+}
+}// namespace
+
+SoftwareRenderer::SoftwareRenderer(unsigned int width, unsigned int height)
+  : m_width(width),
+    m_height(height),
+    m_tilesX((width + RasterTileSize - 1) / RasterTileSize),
+    m_tilesY((height + RasterTileSize - 1) / RasterTileSize),
+    m_pixels(static_cast<size_t>(width) * height)
+{
+}
+
+void SoftwareRenderer::SetView(glm::vec2 origin, float scale)
+{
+  m_origin = origin;
+  m_scale = scale;
+  m_quadsRevision = UINT64_MAX;
+}
+
+void SoftwareRenderer::Render(const RenderSnapshot &snapshot, float alpha)
+{
+  WB_PROFILE_SCOPE("RenderSoftware");
+
+  BuildCircles(snapshot, alpha);
+  if (snapshot.wallsRevision != m_quadsRevision)
+  {
+    BuildQuads(snapshot);
+    m_quadsRevision = snapshot.wallsRevision;
+  }
+
+  BinPrimitives();
+
+  WB_PROFILE_SCOPE("RasterizeTiles");
+  ParallelFor(m_threadManager, 0, static_cast<size_t>(m_tilesX) * m_tilesY, 1, [&](size_t begin, size_t end, size_t) {
+    for (size_t tile = begin; tile < end; ++tile)
+      RasterizeTile(static_cast<uint32_t>(tile));
+  });
+}
+
+void SoftwareRenderer::BuildCircles(const RenderSnapshot &snapshot, float alpha)
+{
+  const size_t count = snapshot.GetNumberOfBullets();
+  m_circles.resize(count);
+
+  ParallelFor(m_threadManager, 0, count, CirclesGrain, [&](size_t begin, size_t end, size_t) {
+    for (size_t i = begin; i < end; ++i)
+    {
+      const glm::vec2 position(InterpolateCoordinate(snapshot.previousPositionX[i], snapshot.positionX[i], alpha),
+        InterpolateCoordinate(snapshot.previousPositionY[i], snapshot.positionY[i], alpha));
+
+      Circle &circle = m_circles[i];
+      circle.center = (position - m_origin) * m_scale;
+      circle.radius = snapshot.radius[i] * m_scale;
+      circle.color = snapshot.bulletColors[i];
+    }
+  });
+}
+
+void SoftwareRenderer::BuildQuads(const RenderSnapshot &snapshot)
+{
+  m_quads.clear();
+  m_quads.reserve(snapshot.walls.size());
+
+  for (size_t i = 0; i < snapshot.walls.size(); ++i)
+  {
+    const Segment &wall = snapshot.walls[i];
+    const glm::vec2 p0 = (wall.p0 - m_origin) * m_scale;
+    const glm::vec2 p1 = (wall.p1 - m_origin) * m_scale;
+
+    // Same quad as BuildSegmentQuad, walls without any length cover nothing
+    const float length = glm::length(p1 - p0);
+    if (length <= 0.0f)
+      continue;
+    const glm::vec2 direction = (p1 - p0) / length;
+    const glm::vec2 offset = glm::vec2(-direction.y, direction.x) * (wall.thickness * m_scale * 0.5f);
+
+    Quad quad;
+    quad.corners[0] = p0 + offset;
+    quad.corners[1] = p1 + offset;
+    quad.corners[2] = p1 - offset;
+    quad.corners[3] = p0 - offset;
+    if (Cross(quad.corners[1] - quad.corners[0], quad.corners[2] - quad.corners[0]) < 0.0f)
+      std::swap(quad.corners[1], quad.corners[3]);
+
+    quad.min = quad.max = quad.corners[0];
+    for (int k = 1; k < 4; ++k)
+    {
+      quad.min.x = std::min(quad.min.x, quad.corners[k].x);
+      quad.min.y = std::min(quad.min.y, quad.corners[k].y);
+      quad.max.x = std::max(quad.max.x, quad.corners[k].x);
+      quad.max.y = std::max(quad.max.y, quad.corners[k].y);
+    }
+    quad.color = snapshot.wallColors[i];
+    m_quads.push_back(quad);
+  }
+}
+
+bool SoftwareRenderer::GetTileRange(size_t primitive, uint32_t &minX, uint32_t &minY, uint32_t &maxX,
+  uint32_t &maxY) const
+{
+  glm::vec2 min;
+  glm::vec2 max;
+  if (primitive < m_circles.size())
+  {
+    // Antialiased edges reach half a pixel further
+    const Circle &circle = m_circles[primitive];
+    const glm::vec2 reach(circle.radius + 0.5f);
+    min = circle.center - reach;
+    max = circle.center + reach;
+  }
+  else
+  {
+    const Quad &quad = m_quads[primitive - m_circles.size()];
+    min = quad.min;
+    max = quad.max;
+  }
+
+  // Written so that NaN positions are out of the frame as well
+  if (!(max.x >= 0.0f && max.y >= 0.0f && min.x < m_width && min.y < m_height))
+    return false;
+
+  minX = static_cast<uint32_t>(std::max(min.x, 0.0f)) / RasterTileSize;
+  minY = static_cast<uint32_t>(std::max(min.y, 0.0f)) / RasterTileSize;
+  maxX = static_cast<uint32_t>(std::min(max.x, m_width - 1.0f)) / RasterTileSize;
+  maxY = static_cast<uint32_t>(std::min(max.y, m_height - 1.0f)) / RasterTileSize;
+  return true;
+}
+
+void SoftwareRenderer::BinPrimitives()
+{
+  WB_PROFILE_SCOPE("BinPrimitives");
+
+  const size_t count = m_circles.size() + m_quads.size();
+  const size_t tilesCount = static_cast<size_t>(m_tilesX) * m_tilesY;
+  m_binGrain = std::max(MinBinGrain, (count + MaxBinChunks - 1) / MaxBinChunks);
+  m_binChunks = (count + m_binGrain - 1) / m_binGrain;
+  m_chunkTileOffsets.assign(m_binChunks * tilesCount, 0);
+
+  // Counts the primitives of every chunk in every tile
+  ParallelFor(m_threadManager, 0, count, m_binGrain, [&](size_t begin, size_t end, size_t chunk) {
+    uint32_t *counts = &m_chunkTileOffsets[chunk * tilesCount];
+    uint32_t minX, minY, maxX, maxY;
+    for (size_t i = begin; i < end; ++i)
+    {
+      if (!GetTileRange(i, minX, minY, maxX, maxY))
+        continue;
+      for (uint32_t y = minY; y <= maxY; ++y)
+        for (uint32_t x = minX; x <= maxX; ++x)
+          ++counts[y * m_tilesX + x];
+    }
+  });
+
+  // Turns counts into offsets: bins one after another, chunks in order within every bin
+  m_tileBegin.resize(tilesCount + 1);
+  uint32_t total = 0;
+  for (size_t tile = 0; tile < tilesCount; ++tile)
+  {
+    m_tileBegin[tile] = total;
+    for (size_t chunk = 0; chunk < m_binChunks; ++chunk)
+    {
+      uint32_t &offset = m_chunkTileOffsets[chunk * tilesCount + tile];
+      const uint32_t chunkCount = offset;
+      offset = total;
+      total += chunkCount;
+    }
+  }
+  m_tileBegin[tilesCount] = total;
+  m_binnedPrimitives.resize(total);
+
+  ParallelFor(m_threadManager, 0, count, m_binGrain, [&](size_t begin, size_t end, size_t chunk) {
+    uint32_t *offsets = &m_chunkTileOffsets[chunk * tilesCount];
+    uint32_t minX, minY, maxX, maxY;
+    for (size_t i = begin; i < end; ++i)
+    {
+      if (!GetTileRange(i, minX, minY, maxX, maxY))
+        continue;
+      for (uint32_t y = minY; y <= maxY; ++y)
+        for (uint32_t x = minX; x <= maxX; ++x)
+          m_binnedPrimitives[offsets[y * m_tilesX + x]++] = static_cast<uint32_t>(i);
+    }
+  });
+}
+
+void SoftwareRenderer::RasterizeTile(uint32_t tile)
+{
+  const uint32_t x0 = (tile % m_tilesX) * RasterTileSize;
+  const uint32_t y0 = (tile / m_tilesX) * RasterTileSize;
+  const uint32_t x1 = std::min(x0 + RasterTileSize, m_width);
+  const uint32_t y1 = std::min(y0 + RasterTileSize, m_height);
+
+  for (uint32_t y = y0; y < y1; ++y)
+    std::fill_n(&m_pixels[static_cast<size_t>(y) * m_width + x0], x1 - x0, m_clearColor);
+
+  for (uint32_t i = m_tileBegin[tile]; i < m_tileBegin[tile + 1]; ++i)
+  {
+    const uint32_t primitive = m_binnedPrimitives[i];
+    if (primitive < m_circles.size())
+      DrawCircle(m_circles[primitive], x0, y0, x1, y1);
+    else
+      DrawQuad(m_quads[primitive - m_circles.size()], x0, y0, x1, y1);
+  }
+}
+
+void SoftwareRenderer::DrawCircle(const Circle &circle, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+{
+  // One pixel wide antialiased edge, like the bullet texture of SceneRenderer
+  const float reach = circle.radius + 0.5f;
+  const float outerSquared = reach * reach;
+  const float inner = circle.radius - 0.5f;
+  const float innerSquared = inner > 0.0f ? inner * inner : -1.0f;
+  // Copied to locals, stores into the framebuffer would otherwise reload them at every pixel
+  const glm::vec2 center = circle.center;
+  const Color color = circle.color;
+
+  uint32_t firstX, lastX, firstY, lastY;
+  GetPixelRange(center.x - reach, center.x + reach, x0, x1, firstX, lastX);
+  GetPixelRange(center.y - reach, center.y + reach, y0, y1, firstY, lastY);
+
+  for (uint32_t y = firstY; y < lastY; ++y)
+  {
+    Color *row = &m_pixels[static_cast<size_t>(y) * m_width];
+    const float dy = y + 0.5f - center.y;
+    for (uint32_t x = firstX; x < lastX; ++x)
+    {
+      const float dx = x + 0.5f - center.x;
+      const float distanceSquared = dx * dx + dy * dy;
+      if (distanceSquared >= outerSquared)
+        continue;
+
+      // The square root is only needed across the edge
+      float coverage = 1.0f;
+      if (distanceSquared > innerSquared)
+        coverage = std::min(reach - std::sqrt(distanceSquared), 1.0f);
+      Blend(row[x], color, coverage);
+    }
+  }
+}
+
+void SoftwareRenderer::DrawQuad(const Quad &quad, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+{
+  uint32_t firstX, lastX, firstY, lastY;
+  GetPixelRange(quad.min.x, quad.max.x, x0, x1, firstX, lastX);
+  GetPixelRange(quad.min.y, quad.max.y, y0, y1, firstY, lastY);
+  if (firstX >= lastX || firstY >= lastY)
+    return;
+  const Color color = quad.color;
+
+  // Edge functions at the centre of the first pixel of a row, stepped along x. Walls are drawn without
+  // antialiasing, like the SFML quads.
+  glm::vec2 edges[4];
+  for (int k = 0; k < 4; ++k)
+    edges[k] = quad.corners[(k + 1) & 3] - quad.corners[k];
+
+  for (uint32_t y = firstY; y < lastY; ++y)
+  {
+    Color *row = &m_pixels[static_cast<size_t>(y) * m_width];
+    const glm::vec2 start(firstX + 0.5f, y + 0.5f);
+    float values[4];
+    for (int k = 0; k < 4; ++k)
+      values[k] = Cross(edges[k], start - quad.corners[k]);
+
+    for (uint32_t x = firstX; x < lastX; ++x)
+    {
+      if (values[0] >= 0.0f && values[1] >= 0.0f && values[2] >= 0.0f && values[3] >= 0.0f)
+        Blend(row[x], color, 1.0f);
+      for (int k = 0; k < 4; ++k)
+        values[k] -= edges[k].y;
+    }
+  }
+}
@@ -0,0 +1,89 @@
+#include "SpatialHash.hpp"
+
+#include <cmath>
+
+namespace
+{
+inline uint32_t NextPowerOfTwo(uint32_t v)
+{
+  uint32_t p = 1;
+  while (p < v)
+    p <<= 1;
+  return p;
+}
+}// namespace
+
+void SpatialHash::Configure(float cellSize, float worldWidth, float worldHeight)
+{
+  // Cells have to tile the world exactly, otherwise neighbours across the wrap edge would be lost,
+  // so the requested size is only a lower bound
+  m_cellsX = std::max(1u, static_cast<uint32_t>(worldWidth / cellSize));
+  m_cellsY = std::max(1u, static_cast<uint32_t>(worldHeight / cellSize));
+  m_cellWidth = worldWidth / m_cellsX;
+  m_cellHeight = worldHeight / m_cellsY;
+}
+
+uint32_t SpatialHash::ComputeCell(glm::vec2 position) const
+{
+  // Positions could be slightly outside of the world after collision displacement, wrap them as well
+  auto x = static_cast<int64_t>(std::floor(position.x / m_cellWidth)) % static_cast<int64_t>(m_cellsX);
+  auto y = static_cast<int64_t>(std::floor(position.y / m_cellHeight)) % static_cast<int64_t>(m_cellsY);
+  if (x < 0)
+    x += m_cellsX;
+  if (y < 0)
+    y += m_cellsY;
+
+  return static_cast<uint32_t>(y) * m_cellsX + static_cast<uint32_t>(x);
+}
+
+uint32_t SpatialHash::GatherNeighbourCells(uint32_t cell, uint32_t (&neighbours)[9]) const
+{
+  const uint32_t cx = cell % m_cellsX;
+  const uint32_t cy = cell / m_cellsX;
+
+  uint32_t count = 0;
+  for (int dy = -1; dy <= 1; ++dy)
+  {
+    const uint32_t y = (cy + m_cellsY + dy) % m_cellsY;
+    for (int dx = -1; dx <= 1; ++dx)
+    {
+      const uint32_t x = (cx + m_cellsX + dx) % m_cellsX;
+      const uint32_t neighbour = y * m_cellsX + x;
+
+      if (std::find(neighbours, neighbours + count, neighbour) == neighbours + count)
+        neighbours[count++] = neighbour;
+    }
+  }
+  return count;
+}
+
+void SpatialHash::Sort()
+{
+  const auto count = static_cast<uint32_t>(m_entryCells.size());
+
+  // Twice as many buckets as entries keeps the amount of shared buckets low
+  m_bucketsCount = NextPowerOfTwo(std::max(64u, count * 2));
+  m_bucketStart.assign(m_bucketsCount + 1, 0);
+
+  for (uint32_t i = 0; i < count; ++i)
+    ++m_bucketStart[BucketOf(m_entryCells[i]) + 1];
+
+  for (uint32_t b = 0; b < m_bucketsCount; ++b)
+    m_bucketStart[b + 1] += m_bucketStart[b];
+
+  m_sortedEntries.resize(count);
+  m_sortedCells.resize(count);
+
+  // Bucket starts are used as scatter cursors and shifted back afterwards
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    const uint32_t cell = m_entryCells[i];
+    const uint32_t slot = m_bucketStart[BucketOf(cell)]++;
+    m_sortedEntries[slot] = i;
+    m_sortedCells[slot] = cell;
+  }
+
+  for (uint32_t b = m_bucketsCount; b > 0; --b)
+    m_bucketStart[b] = m_bucketStart[b - 1];
+  m_bucketStart[0] = 0;
+}
@@ -0,0 +1,49 @@
+#include "SpawnPatterns.hpp"
+
+#include <cmath>
+
+namespace
+{
+// Appends count spawns with headings firstAngle + i * step, positions are pushed offset along the heading
+void AppendFan(std::vector<BulletSpawn> &out, size_t count, glm::vec2 origin, float offset, float firstAngle,
+  float step, const BulletSpawn &prototype)
+{
+  const size_t first = out.size();
+  out.resize(first + count, prototype);
+
+  // Every angle is computed from its index rather than by repeated rotation, so large fans don't drift
+  BulletSpawn *spawns = out.data() + first;
+  for (size_t i = 0; i < count; ++i)
+  {
+    const float angle = firstAngle + step * static_cast<float>(i);
+    const glm::vec2 direction(std::cos(angle), std::sin(angle));
+    spawns[i].direction = direction;
+    spawns[i].position = origin + direction * offset;
+  }
+}
+}// namespace
+
+namespace SpawnPatterns
+{
+void Radial(std::vector<BulletSpawn> &out, size_t count, glm::vec2 centre, float offset, float startAngle,
+  const BulletSpawn &prototype)
+{
+  if (count == 0)
+    return;
+
+  constexpr float fullCircle = 6.2831853f;
+  AppendFan(out, count, centre, offset, startAngle, fullCircle / static_cast<float>(count), prototype);
+}
+
+void Cone(std::vector<BulletSpawn> &out, size_t count, glm::vec2 origin, float offset, float angle, float spread,
+  const BulletSpawn &prototype)
+{
+  if (count == 0)
+    return;
+
+  // A single bullet goes straight along the heading, otherwise both edges of the arc are covered
+  const float step = count > 1 ? spread / static_cast<float>(count - 1) : 0.0f;
+  const float firstAngle = count > 1 ? angle - spread * 0.5f : angle;
+  AppendFan(out, count, origin, offset, firstAngle, step, prototype);
+}
+}// namespace SpawnPatterns
@@ -0,0 +1,119 @@
+#include "Spawner.hpp"
+#include "Philox.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Amount of bullets generated by a single parallel task
+constexpr size_t SpawnsGrain = 4096;
+
+constexpr double FullCircle = 6.283185307179586;
+}// namespace
+
+size_t Spawner::AddEmitter(const EmitterConfig &config)
+{
+  Emitter emitter;
+  emitter.config = config;
+  emitter.rateTime = m_time;
+  m_emitters.push_back(emitter);
+  return m_emitters.size() - 1;
+}
+
+void Spawner::SetRate(size_t emitter, double rate)
+{
+  Emitter &target = m_emitters[emitter];
+  target.config.rate = rate;
+  target.rateTime = m_time;
+  target.rateBase = target.firedAtRate;
+}
+
+size_t Spawner::Update(double deltaTime, BulletManager &bulletManager)
+{
+  const std::vector<BulletSpawn> &batch = Advance(deltaTime);
+  if (!batch.empty())
+    bulletManager.FireBatch(batch);
+  return batch.size();
+}
+
+const std::vector<BulletSpawn> &Spawner::Advance(double deltaTime)
+{
+  WB_PROFILE_SCOPE("Spawner");
+
+  m_time += deltaTime;
+
+  // Counted from the time the rate was set rather than added up per update, so rounding never accumulates
+  m_batchBegin.resize(m_emitters.size() + 1);
+  size_t total = 0;
+  for (size_t e = 0; e < m_emitters.size(); ++e)
+  {
+    Emitter &emitter = m_emitters[e];
+    m_batchBegin[e] = total;
+
+    uint64_t due = emitter.rateBase;
+    if (emitter.config.rate > 0.0)
+      due += static_cast<uint64_t>(std::floor(emitter.config.rate * (m_time - emitter.rateTime)));
+    const uint64_t count = due - emitter.firedAtRate + emitter.burstsPending;
+    emitter.firedAtRate = due;
+    emitter.burstsPending = 0;
+    total += static_cast<size_t>(count);
+  }
+  m_batchBegin.back() = total;
+
+  m_batch.resize(total);
+  ParallelFor(m_threadManager, 0, total, SpawnsGrain, [this](size_t chunkBegin, size_t chunkEnd, size_t) {
+    // A chunk can span several emitters, every one of them continues its own stream
+    size_t e = std::upper_bound(m_batchBegin.begin(), m_batchBegin.end(), chunkBegin) - m_batchBegin.begin() - 1;
+    for (size_t i = chunkBegin; i < chunkEnd; ++e)
+    {
+      const size_t end = std::min(chunkEnd, m_batchBegin[e + 1]);
+      const uint64_t first = m_emitters[e].fired + (i - m_batchBegin[e]);
+      Generate(static_cast<uint32_t>(e), first, end - i, m_batch.data() + i);
+      i = end;
+    }
+  });
+
+  for (size_t e = 0; e < m_emitters.size(); ++e)
+    m_emitters[e].fired += m_batchBegin[e + 1] - m_batchBegin[e];
+  m_fired += total;
+  return m_batch;
+}
+
+void Spawner::Generate(uint32_t emitter, uint64_t first, size_t count, BulletSpawn *out) const
+{
+  const EmitterConfig &config = m_emitters[emitter].config;
+  // Walls are generated with the key {seed, 0}, emitters never share their streams with them
+  const PhiloxKey key = { m_seed, emitter + 1 };
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    const uint64_t n = first + i;
+    const PhiloxCounter random = Philox4x32({ static_cast<uint32_t>(n), static_cast<uint32_t>(n >> 32), 0, 0 }, key);
+
+    // The spiral turns a whole number of times every so often, the remainder keeps the angle precise
+    float angle = config.angle;
+    if (config.pattern == EmitterPattern::Spiral)
+      angle += static_cast<float>(std::fmod(static_cast<double>(n) * config.spread, FullCircle));
+    else
+      angle += UniformFloat(random[0], -0.5f, 0.5f) * config.spread;
+    const glm::vec2 direction(std::cos(angle), std::sin(angle));
+
+    BulletSpawn &spawn = out[i];
+    spawn.direction = direction;
+    if (config.pattern == EmitterPattern::Scatter)
+    {
+      spawn.position = glm::vec2(UniformFloat(random[1], config.areaMin.x, config.areaMax.x),
+        UniformFloat(random[2], config.areaMin.y, config.areaMax.y));
+    }
+    else
+      spawn.position = config.origin + direction * config.offset;
+
+    // Both take a half of the last number, 16 bits are plenty for them
+    spawn.lifetime = UniformFloat(random[3] & 0xFFFF0000u, config.minLifetime, config.maxLifetime);
+    spawn.speed = UniformFloat(random[3] << 16, config.minSpeed, config.maxSpeed);
+    spawn.radius = config.radius;
+    spawn.delay = 0.0f;
+  }
+}
@@ -0,0 +1,430 @@
+#include "SweepAndPrune.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Smallest pair table, a power of two
+constexpr size_t MinPairSetCapacity = 64;
+}// namespace
+
+bool SweepAndPrune::PairSet::Contains(uint64_t key) const
+{
+  if (m_keys.empty())
+    return false;
+
+  const size_t mask = m_keys.size() - 1;
+  for (size_t i = Home(key);; i = (i + 1) & mask)
+  {
+    if (m_keys[i] == key)
+      return true;
+    if (m_keys[i] == EmptyKey)
+      return false;
+  }
+}
+
+void SweepAndPrune::PairSet::Insert(uint64_t key)
+{
+  // Kept at most half full, so probe sequences stay short
+  if ((m_size + 1) * 2 > m_keys.size())
+    Grow();
+
+  const size_t mask = m_keys.size() - 1;
+  for (size_t i = Home(key);; i = (i + 1) & mask)
+  {
+    if (m_keys[i] == key)
+      return;
+    if (m_keys[i] == EmptyKey)
+    {
+      m_keys[i] = key;
+      ++m_size;
+      return;
+    }
+  }
+}
+
+void SweepAndPrune::PairSet::Erase(uint64_t key)
+{
+  if (m_keys.empty())
+    return;
+
+  const size_t mask = m_keys.size() - 1;
+  size_t hole = Home(key);
+  while (m_keys[hole] != key)
+  {
+    if (m_keys[hole] == EmptyKey)
+      return;
+    hole = (hole + 1) & mask;
+  }
+
+  // Later keys of the probe sequence are shifted back into the hole, unless that would put them before their home
+  for (size_t i = (hole + 1) & mask; m_keys[i] != EmptyKey; i = (i + 1) & mask)
+  {
+    if (((i - Home(m_keys[i])) & mask) >= ((i - hole) & mask))
+    {
+      m_keys[hole] = m_keys[i];
+      hole = i;
+    }
+  }
+  m_keys[hole] = EmptyKey;
+  --m_size;
+}
+
+void SweepAndPrune::PairSet::Clear()
+{
+  std::fill(m_keys.begin(), m_keys.end(), EmptyKey);
+  m_size = 0;
+}
+
+void SweepAndPrune::PairSet::Grow()
+{
+  std::vector<uint64_t> keys(std::max(MinPairSetCapacity, m_keys.size() * 2), EmptyKey);
+  keys.swap(m_keys);
+
+  m_shift = 64;
+  for (size_t capacity = m_keys.size(); capacity > 1; capacity >>= 1)
+    --m_shift;
+
+  m_size = 0;
+  for (const uint64_t key : keys)
+  {
+    if (key != EmptyKey)
+      Insert(key);
+  }
+}
+
+void SweepAndPrune::Update(const BroadPhaseInput &input, ThreadManager *)
+{
+  m_input = input;
+  if (m_stamp == UINT32_MAX)
+    Reset();
+  ++m_stamp;
+
+  if (m_boxes.size() < input.slotsCount)
+  {
+    m_boxes.resize(input.slotsCount);
+    m_nextBoxes.resize(input.slotsCount);
+    m_lastSeen.resize(input.slotsCount, 0);
+    m_bulletIndices.resize(input.slotsCount);
+    m_reinserted.resize(input.slotsCount, 0);
+    // Every bullet may come and go within a substep, lists are sized for all of them at once
+    m_endpoints[0].reserve(2 * input.slotsCount);
+    m_endpoints[1].reserve(2 * input.slotsCount);
+    m_insertedEndpoints.reserve(2 * input.slotsCount);
+    m_mergeScratch.reserve(2 * input.slotsCount);
+    m_removedSlots.reserve(input.slotsCount);
+    m_insertedSlots.reserve(input.slotsCount);
+  }
+
+  // Boxes around the paths, in world coordinates before the wrap
+  m_insertedSlots.clear();
+  for (size_t i = 0; i < input.count; ++i)
+  {
+    const SweptBody &body = input.bodies[i];
+    const glm::vec2 to = body.from + body.motion;
+    const float reach = body.radius + BroadPhaseMargin;
+    Box box;
+    box.min[0] = std::min(body.from.x, to.x) - reach;
+    box.min[1] = std::min(body.from.y, to.y) - reach;
+    box.max[0] = std::max(body.from.x, to.x) + reach;
+    box.max[1] = std::max(body.from.y, to.y) + reach;
+
+    const uint32_t slot = input.slots[i];
+    m_nextBoxes[slot] = box;
+    m_bulletIndices[slot] = static_cast<uint32_t>(i);
+    if (m_lastSeen[slot] == 0)
+    {
+      m_insertedSlots.push_back(slot);
+    }
+    else if (std::abs(box.min[0] - m_boxes[slot].min[0]) > 0.5f * input.worldWidth
+             || std::abs(box.min[1] - m_boxes[slot].min[1]) > 0.5f * input.worldHeight)
+    {
+      // Wrapped around the world, sorting would carry its bounds across the whole lists
+      m_reinserted[slot] = 1;
+      m_insertedSlots.push_back(slot);
+    }
+    m_lastSeen[slot] = m_stamp;
+  }
+
+  RemoveBoxes();
+
+  // Lists are sorted along both axes, queries go along the one the boxes are the most spread on
+  double sum[2] = {};
+  double sumSq[2] = {};
+  m_maxExtent[0] = 0.0f;
+  m_maxExtent[1] = 0.0f;
+  for (size_t i = 0; i < input.count; ++i)
+  {
+    const uint32_t slot = input.slots[i];
+    const Box &box = m_nextBoxes[slot];
+    for (int axis = 0; axis < 2; ++axis)
+    {
+      const double center = 0.5 * (static_cast<double>(box.min[axis]) + box.max[axis]);
+      sum[axis] += center;
+      sumSq[axis] += center * center;
+      m_maxExtent[axis] = std::max(m_maxExtent[axis], box.max[axis] - box.min[axis]);
+    }
+  }
+  // Both variances are scaled by the amount of boxes, which doesn't change the comparison
+  const double count = static_cast<double>(std::max<size_t>(input.count, 1));
+  m_queryAxis = sumSq[1] - sum[1] * sum[1] / count > sumSq[0] - sum[0] * sum[0] / count ? 1 : 0;
+
+  for (int axis = 0; axis < 2; ++axis)
+  {
+    const int otherAxis = 1 - axis;
+    for (Endpoint &endpoint : m_endpoints[axis])
+    {
+      const Box &box = m_nextBoxes[endpoint.Slot()];
+      endpoint.value = endpoint.IsUpper() ? box.max[axis] : box.min[axis];
+      endpoint.otherMin = std::min(endpoint.otherMin, box.min[otherAxis]);
+      endpoint.otherMax = std::max(endpoint.otherMax, box.max[otherAxis]);
+    }
+  }
+  for (size_t i = 0; i < input.count; ++i)
+  {
+    const uint32_t slot = input.slots[i];
+    m_boxes[slot] = m_nextBoxes[slot];
+  }
+  SortAxis(0);
+  SortAxis(1);
+  // Only the new bounds along the other axis are left for the queries
+  for (int axis = 0; axis < 2; ++axis)
+  {
+    const int otherAxis = 1 - axis;
+    for (Endpoint &endpoint : m_endpoints[axis])
+    {
+      const Box &box = m_boxes[endpoint.Slot()];
+      endpoint.otherMin = box.min[otherAxis];
+      endpoint.otherMax = box.max[otherAxis];
+    }
+  }
+
+  InsertBoxes();
+  FindPairsAcrossEdges();
+  BuildPairLists();
+}
+
+void SweepAndPrune::RemoveBoxes()
+{
+  auto isRemoved = [this](uint32_t slot) { return m_lastSeen[slot] != m_stamp || m_reinserted[slot]; };
+
+  m_removedSlots.clear();
+  for (const Endpoint &endpoint : m_endpoints[0])
+  {
+    if (!endpoint.IsUpper() && isRemoved(endpoint.Slot()))
+      m_removedSlots.push_back(endpoint.Slot());
+  }
+  if (m_removedSlots.empty())
+    return;
+
+  // Pairs are found with the bounds the lists are still sorted by
+  for (const uint32_t slot : m_removedSlots)
+  {
+    QueryBox(m_boxes[slot], [&](uint32_t other) {
+      if (other != slot)
+        m_pairs.Erase(PairKey(slot, other));
+    });
+  }
+
+  for (std::vector<Endpoint> &endpoints : m_endpoints)
+  {
+    endpoints.erase(std::remove_if(endpoints.begin(), endpoints.end(),
+                      [&](const Endpoint &endpoint) { return isRemoved(endpoint.Slot()); }),
+      endpoints.end());
+  }
+
+  for (const uint32_t slot : m_removedSlots)
+  {
+    if (m_lastSeen[slot] != m_stamp)
+      m_lastSeen[slot] = 0;
+  }
+}
+
+void SweepAndPrune::SortAxis(int axis)
+{
+  // Every swap exchanges two bounds whose order changed, each such couple is swapped exactly once. A lower bound
+  // moving before an upper one may start an overlap, the opposite ends one whatever the other axis says. Pairs are
+  // cached only if their old or new boxes overlap, so boxes apart on the other axis before and after are skipped.
+  std::vector<Endpoint> &endpoints = m_endpoints[axis];
+  for (size_t i = 1; i < endpoints.size(); ++i)
+  {
+    const Endpoint moving = endpoints[i];
+    size_t j = i;
+    for (; j > 0 && moving < endpoints[j - 1]; --j)
+    {
+      const Endpoint passed = endpoints[j - 1];
+      endpoints[j] = passed;
+      // Evaluated without branching, bounds of different kinds from boxes overlapping on the other axis are rare
+      const bool event = ((moving.data ^ passed.data) & 1) & (moving.otherMin <= passed.otherMax)
+                         & (passed.otherMin <= moving.otherMax);
+      if (!event)
+        continue;
+
+      if (moving.IsUpper())
+        m_pairs.Erase(PairKey(moving.Slot(), passed.Slot()));
+      else if (Overlap(m_boxes[moving.Slot()], m_boxes[passed.Slot()]))
+        m_pairs.Insert(PairKey(moving.Slot(), passed.Slot()));
+    }
+    endpoints[j] = moving;
+  }
+}
+
+void SweepAndPrune::InsertBoxes()
+{
+  if (m_insertedSlots.empty())
+    return;
+
+  // Sorted apart and merged, a single pass over the lists whatever the amount of new boxes
+  for (int axis = 0; axis < 2; ++axis)
+  {
+    m_insertedEndpoints.clear();
+    for (const uint32_t slot : m_insertedSlots)
+    {
+      const Box &box = m_boxes[slot];
+      m_insertedEndpoints.push_back({ box.min[axis], slot << 1, box.min[1 - axis], box.max[1 - axis] });
+      m_insertedEndpoints.push_back({ box.max[axis], (slot << 1) | 1, box.min[1 - axis], box.max[1 - axis] });
+    }
+    std::sort(m_insertedEndpoints.begin(), m_insertedEndpoints.end());
+
+    std::vector<Endpoint> &endpoints = m_endpoints[axis];
+    m_mergeScratch.resize(endpoints.size() + m_insertedEndpoints.size());
+    std::merge(endpoints.begin(), endpoints.end(), m_insertedEndpoints.begin(), m_insertedEndpoints.end(),
+      m_mergeScratch.begin());
+    endpoints.swap(m_mergeScratch);
+  }
+
+  // Pairs between two inserted boxes are found twice, the set keeps one
+  for (const uint32_t slot : m_insertedSlots)
+  {
+    QueryBox(m_boxes[slot], [&](uint32_t other) {
+      if (other != slot)
+        m_pairs.Insert(PairKey(slot, other));
+    });
+    m_reinserted[slot] = 0;
+  }
+}
+
+template<typename SlotFn>
+void SweepAndPrune::QueryBox(const Box &box, SlotFn &&slotFn) const
+{
+  // Lower bounds of the boxes overlapping this one are at most the largest extent before it, the margin covers rounding
+  const int axis = m_queryAxis;
+  const std::vector<Endpoint> &endpoints = m_endpoints[axis];
+  const Endpoint first{ box.min[axis] - m_maxExtent[axis] - BroadPhaseMargin, 0, 0.0f, 0.0f };
+  const Endpoint query{ 0.0f, 0, box.min[1 - axis], box.max[1 - axis] };
+  for (auto it = std::lower_bound(endpoints.begin(), endpoints.end(), first);
+       it != endpoints.end() && it->value <= box.max[axis]; ++it)
+  {
+    if (!it->IsUpper() && OverlapOnOtherAxis(*it, query) && Overlap(m_boxes[it->Slot()], box))
+      slotFn(it->Slot());
+  }
+}
+
+void SweepAndPrune::FindPairsAcrossEdges()
+{
+  // A box overlaps the image of another one across an edge only if it is within the largest extent of the edge
+  // the image comes from, so that box queries the image of itself and finds the pair. Paths start up to a radius
+  // outside of the world when overlapping bullets were pushed apart.
+  m_edgePairs.clear();
+  const float size[2] = { m_input.worldWidth, m_input.worldHeight };
+  for (size_t i = 0; i < m_input.count; ++i)
+  {
+    const uint32_t slot = m_input.slots[i];
+    const Box &box = m_boxes[slot];
+
+    float shifts[2][3];
+    int shiftsCount[2];
+    for (int axis = 0; axis < 2; ++axis)
+    {
+      const float reach = m_maxExtent[axis] + m_input.maxRadius + BroadPhaseMargin;
+      shiftsCount[axis] = 0;
+      shifts[axis][shiftsCount[axis]++] = 0.0f;
+      if (box.min[axis] <= reach)
+        shifts[axis][shiftsCount[axis]++] = size[axis];
+      if (box.max[axis] >= size[axis] - reach)
+        shifts[axis][shiftsCount[axis]++] = -size[axis];
+    }
+
+    for (int x = 0; x < shiftsCount[0]; ++x)
+    {
+      for (int y = 0; y < shiftsCount[1]; ++y)
+      {
+        if (x == 0 && y == 0)
+          continue;
+
+        const Box image{ { box.min[0] + shifts[0][x], box.min[1] + shifts[1][y] },
+          { box.max[0] + shifts[0][x], box.max[1] + shifts[1][y] } };
+        QueryBox(image, [&](uint32_t other) {
+          const uint64_t key = PairKey(slot, other);
+          if (other != slot && !m_pairs.Contains(key))
+            m_edgePairs.push_back(key);
+        });
+      }
+    }
+  }
+
+  std::sort(m_edgePairs.begin(), m_edgePairs.end());
+  m_edgePairs.erase(std::unique(m_edgePairs.begin(), m_edgePairs.end()), m_edgePairs.end());
+}
+
+void SweepAndPrune::BuildPairLists()
+{
+  // Counted at lower + 2, so after the prefix sum lower + 1 is where the partners of lower are written
+  const size_t awakeCount = m_input.awakeCount;
+  m_pairsBegin.assign(awakeCount + 2, 0);
+  auto forEachPair = [this](auto &&pairFn) {
+    m_pairs.ForEach([&](uint64_t key) {
+      const uint32_t i = m_bulletIndices[key >> 32];
+      const uint32_t j = m_bulletIndices[key & UINT32_MAX];
+      pairFn(std::min(i, j), std::max(i, j));
+    });
+    for (const uint64_t key : m_edgePairs)
+    {
+      const uint32_t i = m_bulletIndices[key >> 32];
+      const uint32_t j = m_bulletIndices[key & UINT32_MAX];
+      pairFn(std::min(i, j), std::max(i, j));
+    }
+  };
+
+  // Lower bullets sleeping means both are
+  forEachPair([&](uint32_t lower, uint32_t) {
+    if (lower < awakeCount)
+      ++m_pairsBegin[lower + 2];
+  });
+  for (size_t i = 2; i < m_pairsBegin.size(); ++i)
+    m_pairsBegin[i] += m_pairsBegin[i - 1];
+
+  m_partners.resize(m_pairsBegin.back());
+  forEachPair([&](uint32_t lower, uint32_t higher) {
+    if (lower < awakeCount)
+      m_partners[m_pairsBegin[lower + 1]++] = higher;
+  });
+}
+
+void SweepAndPrune::FindPairs(size_t begin, size_t end, ArenaVector<BulletPair> &pairs) const
+{
+  for (size_t i = begin; i < end; ++i)
+  {
+    for (uint32_t k = m_pairsBegin[i]; k < m_pairsBegin[i + 1]; ++k)
+      pairs.PushBack({ static_cast<uint32_t>(i), m_partners[k] });
+  }
+}
+
+void SweepAndPrune::Reset()
+{
+  m_stamp = 0;
+  m_boxes.clear();
+  m_nextBoxes.clear();
+  m_lastSeen.clear();
+  m_bulletIndices.clear();
+  m_reinserted.clear();
+  m_endpoints[0].clear();
+  m_endpoints[1].clear();
+  m_maxExtent[0] = 0.0f;
+  m_maxExtent[1] = 0.0f;
+  m_pairs.Clear();
+  m_edgePairs.clear();
+  m_pairsBegin.clear();
+  m_partners.clear();
+}
@@ -0,0 +1,198 @@
+#include "ThreadManager.hpp"
+
+namespace
+{
+thread_local size_t CurrentThreadIndex = 0;
+}// namespace
+
+ThreadManager::ThreadManager(size_t workersCount)
+{
+  m_threadsRunning = true;
+
+  m_queues.reserve(workersCount + 1);
+  for (size_t i = 0; i <= workersCount; ++i)
+    m_queues.emplace_back(std::make_unique<WorkQueue>());
+
+  m_threads.reserve(workersCount);
+  for (size_t i = 1; i <= workersCount; ++i)
+    m_threads.emplace_back(&ThreadManager::WorkerLoop, this, i);
+}
+
+ThreadManager::~ThreadManager()
+{
+  {
+    std::lock_guard lock(m_sleepMutex);
+    m_threadsRunning = false;
+  }
+  m_wakeCondition.notify_all();
+
+  for (auto &thread : m_threads)
+    thread.join();
+}
+
+size_t ThreadManager::DefaultWorkersCount()
+{
+  // The calling thread takes part in parallel work as well
+  const size_t hardwareThreads = std::thread::hardware_concurrency();
+  return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+size_t ThreadManager::GetThreadIndex()
+{
+  return CurrentThreadIndex;
+}
+
+void ThreadManager::Submit(Task task)
+{
+  // Nobody would ever pick the task up
+  if (m_threads.empty())
+  {
+    task();
+    return;
+  }
+
+  // Counted before publishing, so the counter never goes below the amount of tasks in the queues
+  {
+    std::lock_guard lock(m_sleepMutex);
+    m_queuedTasks.fetch_add(1, std::memory_order_release);
+  }
+
+  // Workers keep their own tasks local, everybody else goes through the injection queue
+  WorkQueue &queue = *m_queues[CurrentThreadIndex < m_queues.size() ? CurrentThreadIndex : 0];
+  {
+    std::lock_guard lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  m_wakeCondition.notify_one();
+}
+
+bool ThreadManager::TryPopTask(size_t queueIndex, Task &task)
+{
+  WorkQueue &queue = *m_queues[queueIndex];
+  std::lock_guard lock(queue.mutex);
+  if (queue.tasks.empty())
+    return false;
+
+  // Newest task first, its data is most likely still in cache
+  task = std::move(queue.tasks.back());
+  queue.tasks.pop_back();
+  return true;
+}
+
+bool ThreadManager::TryStealTask(size_t queueIndex, Task &task)
+{
+  WorkQueue &queue = *m_queues[queueIndex];
+  std::unique_lock lock(queue.mutex, std::try_to_lock);
+  if (!lock.owns_lock() || queue.tasks.empty())
+    return false;
+
+  // Oldest task, usually the biggest piece of work left
+  task = std::move(queue.tasks.front());
+  queue.tasks.pop_front();
+  return true;
+}
+
+bool ThreadManager::TryGetTask(size_t thiefIndex, Task &task)
+{
+  const size_t queuesCount = m_queues.size();
+  if (thiefIndex != 0 && TryPopTask(thiefIndex, task))
+    return true;
+
+  // Start with the neighbour to spread stealing over all queues
+  for (size_t i = 1; i <= queuesCount; ++i)
+  {
+    const size_t victim = (thiefIndex + i) % queuesCount;
+    if (TryStealTask(victim, task))
+      return true;
+  }
+  return false;
+}
+
+bool ThreadManager::TryRunOneTask()
+{
+  Task task;
+  if (!TryGetTask(CurrentThreadIndex < m_queues.size() ? CurrentThreadIndex : 0, task))
+    return false;
+
+  m_queuedTasks.fetch_sub(1, std::memory_order_acq_rel);
+  task();
+  return true;
+}
+
+void ThreadManager::WaitFor(const std::atomic<size_t> &counter)
+{
+  while (counter.load(std::memory_order_acquire) != 0)
+  {
+    if (!TryRunOneTask())
+      std::this_thread::yield();
+  }
+}
+
+void ThreadManager::WorkerLoop(size_t index)
+{
+  CurrentThreadIndex = index;
+
+  while (m_threadsRunning)
+  {
+    if (TryRunOneTask())
+      continue;
+
+    std::unique_lock lock(m_sleepMutex);
+    m_wakeCondition.wait(lock, [this]() {
+      return !m_threadsRunning || m_queuedTasks.load(std::memory_order_acquire) != 0;
+    });
+  }
+}
+
+TaskGraph::TaskId TaskGraph::Add(ThreadManager::Task task)
+{
+  m_nodes.push_back({ std::move(task), {}, 0 });
+  return m_nodes.size() - 1;
+}
+
+void TaskGraph::Precede(TaskId before, TaskId after)
+{
+  m_nodes[before].successors.push_back(after);
+  ++m_nodes[after].predecessorsCount;
+}
+
+void TaskGraph::Run(ThreadManager *threadManager)
+{
+  const size_t nodesCount = m_nodes.size();
+  m_pendingPredecessors = std::make_unique<std::atomic<size_t>[]>(nodesCount);
+  for (size_t i = 0; i < nodesCount; ++i)
+    m_pendingPredecessors[i] = m_nodes[i].predecessorsCount;
+  m_remainingTasks = nodesCount;
+
+  for (size_t i = 0; i < nodesCount; ++i)
+  {
+    if (m_nodes[i].predecessorsCount != 0)
+      continue;
+
+    if (threadManager)
+      threadManager->Submit([this, threadManager, i]() { RunNode(threadManager, i); });
+    else
+      RunNode(nullptr, i);
+  }
+
+  if (threadManager)
+    threadManager->WaitFor(m_remainingTasks);
+}
+
+void TaskGraph::RunNode(ThreadManager *threadManager, TaskId id)
+{
+  m_nodes[id].task();
+
+  for (const TaskId successor : m_nodes[id].successors)
+  {
+    if (m_pendingPredecessors[successor].fetch_sub(1, std::memory_order_acq_rel) != 1)
+      continue;
+
+    if (threadManager)
+      threadManager->Submit([this, threadManager, successor]() { RunNode(threadManager, successor); });
+    else
+      RunNode(nullptr, successor);
+  }
+
+  m_remainingTasks.fetch_sub(1, std::memory_order_acq_rel);
+}
@@ -1,57 +1,94 @@
 #include "WallBreaker.hpp"
 #include "Math.hpp"
+#include "Profiler.hpp"
+#include "SpawnPatterns.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <chrono>
+#include <cmath>
 #include <map>
-#include <random>
+
+namespace
+{
+size_t GetRenderWorkersCount()
+{
+  return ThreadManager::DefaultWorkersCount() / RenderWorkersDivisor;
+}
+}// namespace
 
 WallBreaker::WallBreaker(uint16_t width, uint16_t height, std::string title)
   : m_width{ width }, m_height{ height }, m_windowTitle(title), m_window(sf::VideoMode(width, height), title),
-    m_bulletManager(&m_window, width, height)
+    m_bulletManager(width, height), m_renderer(&m_window),
+    m_threadManager(ThreadManager::DefaultWorkersCount() - GetRenderWorkersCount()),
+    m_renderThreadManager(GetRenderWorkersCount())
 {
+  m_bulletManager.SetThreadManager(&m_threadManager);
+  m_renderer.SetThreadManager(&m_renderThreadManager);
+  m_spawner.SetThreadManager(&m_threadManager);
+
+  // Continuous fire over the lower half of the scene, bursts are fired from the same area and live longer
+  EmitterConfig emitter;
+  emitter.pattern = EmitterPattern::Scatter;
+  emitter.areaMin = glm::vec2(0.0f, height / 2);
+  emitter.areaMax = glm::vec2(width, height);
+  emitter.rate = DefaultFireRate;
+  emitter.minLifetime = 1.0f;
+  emitter.maxLifetime = 6.0f;
+  m_streamEmitter = m_spawner.AddEmitter(emitter);
+
+  emitter.rate = 0.0;
+  emitter.minLifetime = 3.0f;
+  emitter.maxLifetime = 9.0f;
+  m_burstEmitter = m_spawner.AddEmitter(emitter);
 }
 
-void WallBreaker::Run()
+void WallBreaker::SetRandomSeed(uint32_t seed)
+{
+  m_bulletManager.SetRandomSeed(seed);
+  m_spawner.SetRandomSeed(seed);
+}
+
+bool WallBreaker::StartRecording(const std::string &path)
+{
+  if (m_resumed)
+    return false;
+
+  ReplayHeader header;
+  header.worldWidth = m_width;
+  header.worldHeight = m_height;
+  header.fixedDeltaTime = m_bulletManager.GetFixedDeltaTime();
+  header.substeps = m_bulletManager.GetSubsteps();
+  header.processBulletsCollision = m_bulletManager.IsProcessingBulletsCollision();
+  header.sleeping = m_bulletManager.IsSleepingEnabled();
+  header.wallStreaming = m_bulletManager.IsStreamingWalls();
+
+  if (!m_recorder.Open(path, header))
+    return false;
+
+  m_bulletManager.SetRecorder(&m_recorder);
+  return true;
+}
+
+bool WallBreaker::ResumeFromCheckpoint(const std::string &path)
 {
-  m_workThreadsRunning = true;
+  if (m_recorder.IsOpen() || !m_bulletManager.LoadCheckpoint(path))
+    return false;
 
-  std::random_device os_seed;
-  const auto seed = os_seed();
-  std::mt19937 randGenerator(seed);
-  std::uniform_int_distribution distributeX(0, (int)m_width);
-  std::uniform_int_distribution distributeY(m_height / 2, (int)m_height);
+  m_checkpointPath = path;
+  m_resumed = true;
+  return true;
+}
 
+void WallBreaker::Run()
+{
   // Initial test state with 1024 walls on a scene
-  m_bulletManager.GenerateNewWalls(32);
-
-  // Initial test proc for firing bullets each 20 milliseconds concurrently
-  auto fireProcWithInterval =
-    [&randGenerator, &distributeX, &distributeY, &bulletManager = m_bulletManager, &clock = m_clock]() {
-      constexpr float bulletFireInterval = 0.02f;
-      std::chrono::duration<float> msToSleep{ bulletFireInterval };
-      std::this_thread::sleep_for(msToSleep);
-
-      const auto randX = distributeX(randGenerator);
-      const auto randY = distributeY(randGenerator);
-      const glm::vec2 pos = glm::vec2(randX, randY);
-
-      int id = std::hash<std::thread::id>{}(std::this_thread::get_id());
-      int x = randX % 2 == 0 ? -id : id;
-      int y = randY % 3 == 0 ? id : -id;
-      const glm::vec2 dir = glm::vec2(pos.x * x, pos.y * y);
-
-      bulletManager.Fire(
-        pos, Math::normalize(dir), DefaultBulletSpeed, clock.getElapsedTime().asSeconds(), rand() % 6 + 1);
-    };
+  if (!m_resumed)
+    m_bulletManager.GenerateNewWalls(32);
 
-  const size_t threadsCount = std::thread::hardware_concurrency() - 1;
-  m_workThreads.reserve(threadsCount);
-  for (size_t i = 0; i < threadsCount; ++i)
-    m_workThreads.emplace_back([&threadRunning = m_workThreadsRunning, &fireProcWithInterval]() {
-      while (threadRunning)
-        fireProcWithInterval();
-    });
+  // Physics runs on its own thread at the fixed rate, whatever the display rate is
+  m_simulationRunning = true;
+  m_simulationThread = std::thread(&WallBreaker::SimulationLoop, this);
 
   constexpr float showDebugInfoTimeRatio = 0.1f;
   float showDebugInfoTime{};
@@ -60,30 +97,170 @@ void WallBreaker::Run()
 
   while (IsRunning())
   {
+    WB_PROFILE_SCOPE("Frame");
+
     const float currentTime = m_clock.getElapsedTime().asSeconds();
     const float deltaTime = currentTime - prevTimeStamp;
     prevTimeStamp = currentTime;
     showDebugInfoTime += deltaTime;
 
-    m_window.clear();
-    ProcessInput();
-    m_bulletManager.Update(currentTime);
-    m_window.display();
+    {
+      WB_PROFILE_SCOPE("ProcessInput");
+      ProcessInput();
+    }
+
+    // The latest tick is shown one tick late, interpolated from the previous one over the tick duration
+    m_snapshots.Acquire();
+    const RenderSnapshot &snapshot = m_snapshots.GetReadBuffer();
+    float alpha = 1.0f;
+    if (snapshot.fixedDeltaTime > 0.0f)
+    {
+      const std::chrono::duration<float> sincePublish = std::chrono::steady_clock::now() - snapshot.publishTime;
+      alpha = std::clamp(sincePublish.count() / snapshot.fixedDeltaTime, 0.0f, 1.0f);
+    }
+
+    {
+      WB_PROFILE_SCOPE("Draw");
+      m_window.clear();
+      Draw(snapshot, alpha);
+    }
+    {
+      // Waits for the GPU and the vertical sync, the simulation keeps running meanwhile
+      WB_PROFILE_SCOPE("Display");
+      m_window.display();
+    }
 
     if (showDebugInfoTime >= showDebugInfoTimeRatio)
     {
       const auto fpsStr = "FPS: " + std::to_string(static_cast<uint16_t>(1.0 / deltaTime));
-      const auto bulletsNumStr = "Number of bullets: " + std::to_string(m_bulletManager.GetNumberOfBullets());
-      const auto wallsNumStr = "Number of walls: " + std::to_string(m_bulletManager.GetNumberOfWalls());
-      m_window.setTitle(m_windowTitle + " - " + fpsStr + " - " + bulletsNumStr + " - " + wallsNumStr);
+      const auto bulletsNumStr = "Number of bullets: " + std::to_string(snapshot.GetNumberOfBullets());
+      const auto wallsNumStr = "Number of walls: " + std::to_string(snapshot.walls.size());
+      const auto spawnQueueStats = m_bulletManager.GetSpawnQueueStats();
+      const auto spawnQueueStr = "Spawn queue peak/dropped: " + std::to_string(spawnQueueStats.peakDepth) + "/" +
+                                 std::to_string(spawnQueueStats.dropped);
+      m_window.setTitle(
+        m_windowTitle + " - " + fpsStr + " - " + bulletsNumStr + " - " + wallsNumStr + " - " + spawnQueueStr);
       showDebugInfoTime = 0;
     }
   }
 
-  m_workThreadsRunning = false;
+  m_simulationRunning = false;
+  m_simulationThread.join();
+
+  StopRecording();
+}
+
+void WallBreaker::SimulationLoop()
+{
+  using Clock = std::chrono::steady_clock;
+  const auto tickDuration =
+    std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(m_bulletManager.GetFixedDeltaTime()));
+  const auto maxLag = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(MaxFrameTime));
+
+  auto nextTick = Clock::now();
+  while (m_simulationRunning)
+  {
+    ApplyCommands();
+
+    {
+      WB_PROFILE_SCOPE("Simulate");
+      // Fired bullets are picked up by the step right away, the fire rate follows the simulated time
+      m_spawner.Update(m_bulletManager.GetFixedDeltaTime(), m_bulletManager);
+      m_bulletManager.Step();
+    }
+
+    {
+      WB_PROFILE_SCOPE("PublishSnapshot");
+      RenderSnapshot &snapshot = m_snapshots.GetWriteBuffer();
+      m_bulletManager.WriteRenderSnapshot(snapshot);
+      snapshot.publishTime = Clock::now();
+      m_snapshots.Publish();
+    }
 
-  for (auto &thread : m_workThreads)
-    thread.join();
+    // Ticks missed by more than the lag limit are dropped, the simulation slows down instead
+    nextTick += tickDuration;
+    const auto now = Clock::now();
+    if (now - nextTick > maxLag)
+      nextTick = now;
+    std::this_thread::sleep_until(nextTick);
+  }
+}
+
+void WallBreaker::ApplyCommands()
+{
+  m_commands.Drain([this](const SimulationCommand &command) {
+    switch (command.type)
+    {
+    case SimulationCommandType::ToggleBulletsCollision:
+      m_bulletManager.ToggleProcessBulletsCollision();
+      break;
+    case SimulationCommandType::GenerateWalls:
+      m_bulletManager.GenerateNewWalls(command.wallsRatio);
+      break;
+    case SimulationCommandType::RemoveAllWalls:
+      m_bulletManager.RemoveAllWalls();
+      break;
+    case SimulationCommandType::SaveCheckpoint:
+      if (!m_bulletManager.SaveCheckpoint(m_checkpointPath))
+        std::cerr << "Can't save the checkpoint to " << m_checkpointPath << std::endl;
+      break;
+    case SimulationCommandType::LoadCheckpoint:
+      // The log would no longer replay, it doesn't know about the jump
+      if (m_recorder.IsOpen())
+        std::cerr << "Can't load a checkpoint while recording" << std::endl;
+      else if (!m_bulletManager.LoadCheckpoint(m_checkpointPath))
+        std::cerr << "Can't load the checkpoint from " << m_checkpointPath << std::endl;
+      break;
+    case SimulationCommandType::FireBurst:
+      m_spawner.SetRate(m_streamEmitter, 0.0);
+      m_spawner.Burst(m_burstEmitter, command.bulletsCount);
+      break;
+    case SimulationCommandType::IncreaseFireRate:
+      m_spawner.SetRate(
+        m_streamEmitter, std::clamp(m_spawner.GetRate(m_streamEmitter) * 10.0, MinFireRate, MaxFireRate));
+      break;
+    case SimulationCommandType::DecreaseFireRate:
+    {
+      // Stops below the lowest rate
+      const double rate = m_spawner.GetRate(m_streamEmitter) / 10.0;
+      m_spawner.SetRate(m_streamEmitter, rate >= MinFireRate ? rate : 0.0);
+      break;
+    }
+    }
+  });
+}
+
+void WallBreaker::PushCommand(SimulationCommandType type, unsigned int wallsRatio)
+{
+  SimulationCommand command;
+  command.type = type;
+  command.wallsRatio = wallsRatio;
+  PushCommand(command);
+}
+
+void WallBreaker::PushCommand(const SimulationCommand &command)
+{
+  // A full queue means dozens of unprocessed key presses, dropping one more is fine
+  m_commands.TryPush(command);
+}
+
+void WallBreaker::Draw(const RenderSnapshot &snapshot, float alpha)
+{
+  m_renderer.DrawBullets(snapshot, alpha);
+  m_renderer.DrawWalls(snapshot);
+}
+
+void WallBreaker::StopRecording()
+{
+  if (!m_recorder.IsOpen())
+    return;
+
+  m_bulletManager.SetRecorder(nullptr);
+  m_recorder.Close(m_bulletManager.GetTick());
+
+  // The same hash is printed by a headless replay of the log, when both runs are bit exact
+  std::cout << "Recorded " << m_bulletManager.GetTick() << " ticks, state hash " << std::hex
+            << m_bulletManager.ComputeStateHash() << std::dec << std::endl;
 }
 
 void WallBreaker::ProcessInput()
@@ -94,87 +271,87 @@ void WallBreaker::ProcessInput()
     if (event.type == sf::Event::Closed)
       m_window.close();
 
-    static std::random_device os_seed;
-    static const auto seed = os_seed();
-    static std::mt19937 randGenerator(seed);
-
-    static std::uniform_int_distribution distributeX(0, static_cast<int>(m_width));
-    static std::uniform_int_distribution distributeY(m_height / 2, static_cast<int>(m_height));
-
-    auto bulletsGenerateProc = [&bulletManager = m_bulletManager, &clock = m_clock](size_t iterationsPerThread) {
-      for (size_t i = 0; i < iterationsPerThread; ++i)
-      {
-        const auto randX = distributeX(randGenerator);
-        const auto randY = distributeY(randGenerator);
-        const glm::vec2 pos = glm::vec2(randX, randY);
-        int id = std::hash<std::thread::id>{}(std::this_thread::get_id()) * i;
-        int x = randX % 2 == 0 ? -id : id;
-        int y = randY % 3 == 0 ? id : -id;
-        const glm::vec2 dir = glm::vec2(pos.x * x, pos.y * y);
-
-        bulletManager.Fire(
-          pos, Math::normalize(dir), DefaultBulletSpeed, clock.getElapsedTime().asSeconds(), rand() % 7 + 3);
-      }
+    // Bursts stop the continuous fire, the simulation thread fires them before its next tick
+    auto fireBurst = [this](uint32_t bulletsCount) {
+      SimulationCommand command;
+      command.type = SimulationCommandType::FireBurst;
+      command.bulletsCount = bulletsCount;
+      PushCommand(command);
     };
 
     if (event.type == sf::Event::KeyPressed)
     {
       if (event.key.code == sf::Keyboard::F1)
       {
-        m_bulletManager.ToggleProcessBulletsCollision();
+        PushCommand(SimulationCommandType::ToggleBulletsCollision);
+      }
+
+      // Quick save and load of the whole simulation state
+      if (event.key.code == sf::Keyboard::F5)
+      {
+        PushCommand(SimulationCommandType::SaveCheckpoint);
+      }
+
+      if (event.key.code == sf::Keyboard::F9)
+      {
+        PushCommand(SimulationCommandType::LoadCheckpoint);
       }
 
       // Performance Stress Testing 1 - Generating 100 bullets
       if (event.key.code == sf::Keyboard::Z)
       {
-        constexpr size_t bulletsCount = 100;
-
-        m_workThreadsRunning = false;
-        for (auto &thread : m_workThreads)
-          thread.join();
-        m_workThreads.clear();
-
-        const size_t threadsCount = std::thread::hardware_concurrency() - 1;
-        m_workThreads.reserve(threadsCount);
-        const size_t iterationsPerThread = bulletsCount / threadsCount;
-        for (size_t i = 0; i < threadsCount; ++i)
-          m_workThreads.emplace_back(bulletsGenerateProc, iterationsPerThread);
+        fireBurst(100);
       }
 
       // Performance Stress Testing 1 - Generating 100 walls
       if (event.key.code == sf::Keyboard::A)
       {
-        m_bulletManager.GenerateNewWalls(10);
+        PushCommand(SimulationCommandType::GenerateWalls, 10);
       }
 
 
       // Performance Stress Testing 2 - Generating 1000 bullets
       if (event.key.code == sf::Keyboard::X)
       {
-        constexpr size_t bulletsCount = 1000;
-
-        m_workThreadsRunning = false;
-        for (auto &thread : m_workThreads)
-          thread.join();
-        m_workThreads.clear();
-
-        const size_t threadsCount = std::thread::hardware_concurrency() - 1;
-        m_workThreads.reserve(threadsCount);
-        const size_t iterationsPerThread = bulletsCount / threadsCount;
-        for (size_t i = 0; i < threadsCount; ++i)
-          m_workThreads.emplace_back(bulletsGenerateProc, iterationsPerThread);
+        fireBurst(1000);
       }
 
       // Performance Stress Testing 2 - Generating 1000 walls
       if (event.key.code == sf::Keyboard::S)
       {
         // 32 x 32 = 1024 walls
-        m_bulletManager.GenerateNewWalls(32);
+        PushCommand(SimulationCommandType::GenerateWalls, 32);
       }
 
       if (event.key.code == sf::Keyboard::D)
       {
-        m_bulletManager.RemoveAllWalls();
+        PushCommand(SimulationCommandType::RemoveAllWalls);
+      }
+
+      // Continuous fire ten times faster or slower, from 100 up to a million bullets per second
+      if (event.key.code == sf::Keyboard::PageUp)
+      {
+        PushCommand(SimulationCommandType::IncreaseFireRate);
+      }
+
+      if (event.key.code == sf::Keyboard::PageDown)
+      {
+        PushCommand(SimulationCommandType::DecreaseFireRate);
+      }
+
+      // Patterns - a ring of 120 bullets around the cursor, a cone of 30 bullets fired upwards from it.
+      // Bullets start spaced apart along the arc, so they don't overlap right after the spawn
+      if (event.key.code == sf::Keyboard::C || event.key.code == sf::Keyboard::V)
+      {
+        const sf::Vector2i mouse = sf::Mouse::getPosition(m_window);
+        const glm::vec2 origin(static_cast<float>(mouse.x), static_cast<float>(mouse.y));
+
+        std::vector<BulletSpawn> spawns;
+        if (event.key.code == sf::Keyboard::C)
+          SpawnPatterns::Radial(spawns, 120, origin, 120.0f, 0.0f);
+        else
+          SpawnPatterns::Cone(spawns, 30, origin, 300.0f, -1.5707963f, 0.6f);
+        m_bulletManager.FireBatch(spawns);
       }
     }
   }
@@ -0,0 +1,250 @@
+#include "WallIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace
+{
+// Amount of walls binned by a single parallel task, and the most tasks binning takes
+constexpr size_t InsertGrain = 16384;
+constexpr size_t MaxInsertChunks = 64;
+// Amount of blocks filled by a single parallel task
+constexpr size_t InsertBlocksGrain = 16;
+// Block keys are sorted by this many bits at a time
+constexpr uint32_t SortDigitBits = 11;
+constexpr size_t SortDigits = size_t{ 1 } << SortDigitBits;
+}// namespace
+
+void WallIndex::Configure(float cellSize, float worldWidth, float worldHeight)
+{
+  m_cellSize = cellSize;
+  m_cellsX = std::max(1u, static_cast<uint32_t>(std::ceil(worldWidth / cellSize)));
+  m_cellsY = std::max(1u, static_cast<uint32_t>(std::ceil(worldHeight / cellSize)));
+  m_blocksX = (m_cellsX + BlockMask) >> BlockBits;
+  m_blocksY = (m_cellsY + BlockMask) >> BlockBits;
+  Clear();
+}
+
+void WallIndex::Clear()
+{
+  m_blocks.clear();
+  m_wallRanges.clear();
+}
+
+WallIndex::CellRange WallIndex::ComputeRange(glm::vec2 min, glm::vec2 max) const
+{
+  // Everything outside of the grid is clamped into the border cells
+  // In double, floats can't tell cells apart past 2^24 of them
+  auto toCell = [this](float v, uint32_t cellsCount) {
+    const double cell = std::floor(static_cast<double>(v) / m_cellSize);
+    return static_cast<uint32_t>(std::clamp(cell, 0.0, static_cast<double>(cellsCount - 1)));
+  };
+
+  return { toCell(min.x, m_cellsX), toCell(min.y, m_cellsY), toCell(max.x, m_cellsX), toCell(max.y, m_cellsY) };
+}
+
+WallIndex::CellRange WallIndex::ComputeWallRange(const Segment &wall) const
+{
+  const glm::vec2 fattening(wall.thickness, wall.thickness);
+  const glm::vec2 min(std::min(wall.p0.x, wall.p1.x), std::min(wall.p0.y, wall.p1.y));
+  const glm::vec2 max(std::max(wall.p0.x, wall.p1.x), std::max(wall.p0.y, wall.p1.y));
+  return ComputeRange(min - fattening, max + fattening);
+}
+
+WallIndex::Block *WallIndex::FindBlock(uint64_t key) const
+{
+  const auto it = m_blocks.find(key);
+  return it != m_blocks.end() ? it->second.get() : nullptr;
+}
+
+template<typename Fn>
+void WallIndex::ForEachCell(const CellRange &range, Fn &&fn) const
+{
+  // One lookup per block rather than per cell
+  for (uint32_t blockY = range.minY >> BlockBits; blockY <= range.maxY >> BlockBits; ++blockY)
+  {
+    for (uint32_t blockX = range.minX >> BlockBits; blockX <= range.maxX >> BlockBits; ++blockX)
+    {
+      Block *block = FindBlock(BlockKeyOf(blockX, blockY));
+      if (!block)
+        continue;
+
+      const uint32_t minX = std::max(range.minX, blockX << BlockBits);
+      const uint32_t maxX = std::min(range.maxX, (blockX << BlockBits) + BlockMask);
+      const uint32_t minY = std::max(range.minY, blockY << BlockBits);
+      const uint32_t maxY = std::min(range.maxY, (blockY << BlockBits) + BlockMask);
+      for (uint32_t y = minY; y <= maxY; ++y)
+      {
+        for (uint32_t x = minX; x <= maxX; ++x)
+          fn(*block, x, y);
+      }
+    }
+  }
+}
+
+void WallIndex::Insert(uint32_t firstId, const Segment *walls, size_t count, ThreadManager *threadManager)
+{
+  if (count == 0)
+    return;
+
+  if (m_wallRanges.size() < firstId + count)
+    m_wallRanges.resize(firstId + count);
+
+  // Every wall is paired with each block it overlaps and pairs are sorted by block, so the work follows the batch
+  // rather than the size of the world
+  const size_t grain = std::max(InsertGrain, (count + MaxInsertChunks - 1) / MaxInsertChunks);
+  const size_t chunksCount = (count + grain - 1) / grain;
+  m_chunkPairsBegin.assign(chunksCount + 1, 0);
+
+  auto forEachBlock = [this](const CellRange &range, auto &&fn) {
+    for (uint32_t y = range.minY >> BlockBits; y <= range.maxY >> BlockBits; ++y)
+    {
+      for (uint32_t x = range.minX >> BlockBits; x <= range.maxX >> BlockBits; ++x)
+        fn(BlockKeyOf(x, y));
+    }
+  };
+
+  ParallelFor(threadManager, 0, count, grain, [&](size_t begin, size_t end, size_t chunk) {
+    size_t pairsCount = 0;
+    for (size_t i = begin; i < end; ++i)
+    {
+      const CellRange range = ComputeWallRange(walls[i]);
+      m_wallRanges[firstId + i] = range;
+      pairsCount += static_cast<size_t>((range.maxX >> BlockBits) - (range.minX >> BlockBits) + 1) *
+        ((range.maxY >> BlockBits) - (range.minY >> BlockBits) + 1);
+    }
+    m_chunkPairsBegin[chunk + 1] = pairsCount;
+  });
+
+  for (size_t chunk = 0; chunk < chunksCount; ++chunk)
+    m_chunkPairsBegin[chunk + 1] += m_chunkPairsBegin[chunk];
+  m_blockPairs.resize(m_chunkPairsBegin[chunksCount]);
+
+  ParallelFor(threadManager, 0, count, grain, [&](size_t begin, size_t end, size_t chunk) {
+    BlockPair *out = m_blockPairs.data() + m_chunkPairsBegin[chunk];
+    for (size_t i = begin; i < end; ++i)
+    {
+      const auto id = static_cast<uint32_t>(firstId + i);
+      forEachBlock(m_wallRanges[id], [&](uint64_t key) { *out++ = { key, id }; });
+    }
+  });
+
+  // Pairs are written in id order and the radix sort is stable, so ids stay in order within every block.
+  // It takes a pass per digit of the largest key, a handful even for the largest worlds.
+  const uint64_t maxKey = BlockKeyOf(m_blocksX - 1, m_blocksY - 1);
+  m_sortedPairs.resize(m_blockPairs.size());
+  for (uint32_t shift = 0; shift == 0 || (maxKey >> shift) != 0; shift += SortDigitBits)
+  {
+    std::array<size_t, SortDigits> digitBegin{};
+    for (const BlockPair &pair : m_blockPairs)
+      ++digitBegin[(pair.key >> shift) & (SortDigits - 1)];
+    size_t total = 0;
+    for (size_t &begin : digitBegin)
+      total += std::exchange(begin, total);
+    for (const BlockPair &pair : m_blockPairs)
+      m_sortedPairs[digitBegin[(pair.key >> shift) & (SortDigits - 1)]++] = pair;
+    m_blockPairs.swap(m_sortedPairs);
+  }
+
+  // Missing blocks are created up front, the tasks below don't touch the map
+  m_fillRuns.clear();
+  for (size_t k = 0; k < m_blockPairs.size(); ++k)
+  {
+    if (k != 0 && m_blockPairs[k].key == m_blockPairs[k - 1].key)
+      continue;
+    std::unique_ptr<Block> &block = m_blocks[m_blockPairs[k].key];
+    if (!block)
+      block = std::make_unique<Block>();
+    m_fillRuns.push_back({ k, block.get() });
+  }
+  m_fillRuns.push_back({ m_blockPairs.size(), nullptr });
+
+  // Every block is filled by a single task
+  ParallelFor(threadManager, 0, m_fillRuns.size() - 1, InsertBlocksGrain, [&](size_t begin, size_t end, size_t) {
+    for (size_t run = begin; run < end; ++run)
+    {
+      const size_t first = m_fillRuns[run].first;
+      const size_t last = m_fillRuns[run + 1].first;
+      Block *block = m_fillRuns[run].block;
+
+      const uint64_t key = m_blockPairs[first].key;
+      const auto blockX = static_cast<uint32_t>(key % m_blocksX) << BlockBits;
+      const auto blockY = static_cast<uint32_t>(key / m_blocksX) << BlockBits;
+      for (size_t k = first; k < last; ++k)
+      {
+        const uint32_t id = m_blockPairs[k].id;
+        const CellRange &range = m_wallRanges[id];
+        const uint32_t minX = std::max<uint32_t>(range.minX, blockX);
+        const uint32_t maxX = std::min<uint32_t>(range.maxX, blockX + BlockMask);
+        const uint32_t minY = std::max<uint32_t>(range.minY, blockY);
+        const uint32_t maxY = std::min<uint32_t>(range.maxY, blockY + BlockMask);
+        for (uint32_t y = minY; y <= maxY; ++y)
+        {
+          for (uint32_t x = minX; x <= maxX; ++x)
+            block->cells[CellIndexOf(x, y)].push_back(id);
+        }
+        block->entries += (maxX - minX + 1) * (maxY - minY + 1);
+      }
+    }
+  });
+}
+
+void WallIndex::Remove(uint32_t id)
+{
+  const CellRange range = m_wallRanges[id];
+  ForEachCell(range, [id](Block &block, uint32_t x, uint32_t y) {
+    auto &cell = block.cells[CellIndexOf(x, y)];
+    auto it = std::find(cell.begin(), cell.end(), id);
+    if (it != cell.end())
+    {
+      *it = cell.back();
+      cell.pop_back();
+      --block.entries;
+    }
+  });
+
+  // The last wall of a block gives its memory back
+  for (uint32_t blockY = range.minY >> BlockBits; blockY <= range.maxY >> BlockBits; ++blockY)
+  {
+    for (uint32_t blockX = range.minX >> BlockBits; blockX <= range.maxX >> BlockBits; ++blockX)
+    {
+      const auto it = m_blocks.find(BlockKeyOf(blockX, blockY));
+      if (it != m_blocks.end() && it->second->entries == 0)
+        m_blocks.erase(it);
+    }
+  }
+}
+
+void WallIndex::Rename(uint32_t oldId, uint32_t newId)
+{
+  const CellRange range = m_wallRanges[oldId];
+  ForEachCell(range, [oldId, newId](Block &block, uint32_t x, uint32_t y) {
+    auto &cell = block.cells[CellIndexOf(x, y)];
+    std::replace(cell.begin(), cell.end(), oldId, newId);
+  });
+
+  if (m_wallRanges.size() <= newId)
+    m_wallRanges.resize(newId + 1);
+  m_wallRanges[newId] = range;
+}
+
+void WallIndex::Query(glm::vec2 center, float radius, std::vector<uint32_t> &result) const
+{
+  // Not configured yet or without any wall
+  if (m_blocks.empty())
+    return;
+
+  const glm::vec2 extent(radius, radius);
+  const CellRange query = ComputeRange(center - extent, center + extent);
+
+  ForEachCell(query, [&](const Block &block, uint32_t x, uint32_t y) {
+    for (const uint32_t id : block.cells[CellIndexOf(x, y)])
+    {
+      // A wall spanning several cells is reported only from the first cell shared with the query
+      const CellRange &range = m_wallRanges[id];
+      if (x == std::max(range.minX, query.minX) && y == std::max(range.minY, query.minY))
+        result.push_back(id);
+    }
+  });
+}
@@ -0,0 +1,112 @@
+#include "WorldChunks.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void WorldChunks::Configure(float chunkSize, float worldWidth, float worldHeight)
+{
+  m_chunkSize = chunkSize;
+  m_worldWidth = worldWidth;
+  m_worldHeight = worldHeight;
+  m_chunksX = std::max(1u, static_cast<uint32_t>(std::ceil(worldWidth / chunkSize)));
+  m_chunksY = std::max(1u, static_cast<uint32_t>(std::ceil(worldHeight / chunkSize)));
+  Clear();
+}
+
+void WorldChunks::Clear()
+{
+  m_touchTicks.assign(GetNumberOfChunks(), 0);
+  m_centreTicks.assign(GetNumberOfChunks(), 0);
+  m_loadedChunks.clear();
+  m_destroyed.clear();
+}
+
+uint32_t WorldChunks::ChunkAt(glm::vec2 position) const
+{
+  auto x = static_cast<int64_t>(std::floor(position.x / m_chunkSize)) % static_cast<int64_t>(m_chunksX);
+  auto y = static_cast<int64_t>(std::floor(position.y / m_chunkSize)) % static_cast<int64_t>(m_chunksY);
+  if (x < 0)
+    x += m_chunksX;
+  if (y < 0)
+    y += m_chunksY;
+
+  return static_cast<uint32_t>(y) * m_chunksX + static_cast<uint32_t>(x);
+}
+
+void WorldChunks::GetBounds(uint32_t chunk, glm::vec2 &min, glm::vec2 &max) const
+{
+  const uint32_t x = chunk % m_chunksX;
+  const uint32_t y = chunk / m_chunksX;
+  min = glm::vec2(x * m_chunkSize, y * m_chunkSize);
+  max = glm::vec2(std::min((x + 1) * m_chunkSize, m_worldWidth), std::min((y + 1) * m_chunkSize, m_worldHeight));
+}
+
+void WorldChunks::Touch(uint32_t chunk, uint32_t tick, std::vector<uint32_t> &loaded)
+{
+  const uint32_t stamp = tick + 1;
+  if (m_centreTicks[chunk] == stamp)
+    return;
+  m_centreTicks[chunk] = stamp;
+
+  // Neighbours across the world edges too, bullets wrap around
+  const uint32_t cx = chunk % m_chunksX;
+  const uint32_t cy = chunk / m_chunksX;
+  for (int dy = -1; dy <= 1; ++dy)
+  {
+    const uint32_t y = (cy + m_chunksY + dy) % m_chunksY;
+    for (int dx = -1; dx <= 1; ++dx)
+    {
+      const uint32_t x = (cx + m_chunksX + dx) % m_chunksX;
+      const uint32_t neighbour = y * m_chunksX + x;
+      if (m_touchTicks[neighbour] == 0)
+      {
+        m_loadedChunks.push_back(neighbour);
+        loaded.push_back(neighbour);
+      }
+      m_touchTicks[neighbour] = stamp;
+    }
+  }
+}
+
+void WorldChunks::UnloadIdle(uint32_t tick, uint32_t keepTicks, std::vector<uint32_t> &unloaded)
+{
+  const uint32_t stamp = tick + 1;
+  auto isIdle = [this, stamp, keepTicks](uint32_t chunk) { return stamp - m_touchTicks[chunk] > keepTicks; };
+
+  const size_t firstUnloaded = unloaded.size();
+  for (const uint32_t chunk : m_loadedChunks)
+  {
+    if (isIdle(chunk))
+      unloaded.push_back(chunk);
+  }
+  if (unloaded.size() == firstUnloaded)
+    return;
+
+  m_loadedChunks.erase(std::remove_if(m_loadedChunks.begin(), m_loadedChunks.end(), isIdle), m_loadedChunks.end());
+  for (size_t i = firstUnloaded; i < unloaded.size(); ++i)
+    m_touchTicks[unloaded[i]] = 0;
+}
+
+void WorldChunks::MarkDestroyed(uint32_t chunk, uint32_t index)
+{
+  std::vector<uint64_t> &bits = m_destroyed[chunk];
+  if (bits.size() <= index / 64)
+    bits.resize(index / 64 + 1, 0);
+  bits[index / 64] |= uint64_t{ 1 } << (index % 64);
+}
+
+bool WorldChunks::IsDestroyed(uint32_t chunk, uint32_t index) const
+{
+  const auto it = m_destroyed.find(chunk);
+  if (it == m_destroyed.end() || it->second.size() <= index / 64)
+    return false;
+  return (it->second[index / 64] >> (index % 64)) & 1;
+}
+
+void WorldChunks::Restore(const uint32_t *touchTicks, const uint32_t *loadedChunks, size_t loadedCount)
+{
+  m_touchTicks.assign(touchTicks, touchTicks + GetNumberOfChunks());
+  m_centreTicks.assign(GetNumberOfChunks(), 0);
+  m_loadedChunks.assign(loadedChunks, loadedChunks + loadedCount);
+  m_destroyed.clear();
+}